@@ -0,0 +1,858 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "CpuKernels.h"
+
+// Integer form of the OutputY/OutputUV math in RgbToYuvCS.hlsl, generalized to the formats in
+// CpuConversionFormat.
+//
+// The shader works on unorm floats, e.g. y = 0.256788 * r + 0.504129 * g + 0.097906 * b, clamps to [0, 1]
+// and writes through an R8_UNORM UAV, which rounds to nearest. Scaling the coefficients by 10^6 turns every
+// term into an exact integer, so the CPU kernels can reproduce that rounding without any floating point.
+//
+// The helpers have internal linkage on purpose: every kernel translation unit is compiled with its own
+// instruction set flags, and the linker must not fold an AVX2 copy into the scalar path.
+namespace Rgb2YuvMath
+{
+namespace
+{
+	// What one instantiation of a kernel family writes. Layouts that differ only in the order of U and V
+	// share one.
+	enum class KernelStore
+	{
+		Interleaved,	// row pairs: Y rows and an interleaved chroma row (NV12, NV21)
+		Planar,			// row pairs: Y rows and separate U and V rows (I420, YV12)
+		Yuy2,			// single rows, packed Y0 U Y1 V
+		Uyvy,			// single rows, packed U Y0 V Y1
+		Interleaved422,	// single rows: a Y row and an interleaved chroma row (NV16)
+		Planar422,		// single rows: a Y row and half-width U and V rows (I422)
+		Interleaved444,	// single rows: a Y row and an interleaved chroma row of a pair per pixel (NV24)
+		Planar444,		// single rows: a Y row and full-width U and V rows (I444)
+		InterleavedWide,	// row pairs of 16-bit samples: Y rows and an interleaved chroma row (P010, P016)
+		PlanarWide,		// row pairs of 16-bit samples: Y rows and separate U and V rows (I010)
+		InterleavedAlpha,	// row pairs: Y rows, an interleaved chroma row and two alpha rows (AV12)
+		Ayuv,			// single rows, packed 4:4:4 V U Y A
+		YCoCg444,		// single rows of 16-bit words: a Y row and full-width Co and Cg rows (YCoCg-R 4:4:4)
+		YCoCg420,		// row pairs of 16-bit words: Y rows and half-width Co and Cg rows (YCoCg-R 4:2:0)
+		Grey,			// single rows: a Y row and nothing else (I400)
+	};
+
+	constexpr bool IsPackedStore(KernelStore store)
+	{
+		return store == KernelStore::Yuy2 || store == KernelStore::Uyvy;
+	}
+
+	constexpr bool IsWideStore(KernelStore store)
+	{
+		return store == KernelStore::InterleavedWide || store == KernelStore::PlanarWide;
+	}
+
+	// Stores with Row kernels rather than RowPair ones.
+	constexpr bool IsRowStore(KernelStore store)
+	{
+		return store != KernelStore::Interleaved && store != KernelStore::Planar && store != KernelStore::InterleavedAlpha && !IsWideStore(store) &&
+			store != KernelStore::YCoCg420;
+	}
+
+	// Stores of the reversible YCoCg-R transform, which has kernels of its own rather than a Color.
+	constexpr bool IsYCoCgStore(KernelStore store)
+	{
+		return store == KernelStore::YCoCg444 || store == KernelStore::YCoCg420;
+	}
+
+	constexpr bool IsPlanarStore(KernelStore store)
+	{
+		return store == KernelStore::Planar || store == KernelStore::Planar422 || store == KernelStore::Planar444 || store == KernelStore::PlanarWide;
+	}
+
+	constexpr bool IsFullChromaStore(KernelStore store)
+	{
+		return store == KernelStore::Interleaved444 || store == KernelStore::Planar444;
+	}
+
+	constexpr KernelStore GetKernelStore(CpuYuvLayout layout)
+	{
+		switch (layout)
+		{
+		case CpuYuvLayout::I420:
+		case CpuYuvLayout::Yv12: return KernelStore::Planar;
+		case CpuYuvLayout::Yuy2: return KernelStore::Yuy2;
+		case CpuYuvLayout::Uyvy: return KernelStore::Uyvy;
+		case CpuYuvLayout::Nv16: return KernelStore::Interleaved422;
+		case CpuYuvLayout::I422: return KernelStore::Planar422;
+		case CpuYuvLayout::Nv24: return KernelStore::Interleaved444;
+		case CpuYuvLayout::I444: return KernelStore::Planar444;
+		case CpuYuvLayout::P010:
+		case CpuYuvLayout::P016: return KernelStore::InterleavedWide;
+		case CpuYuvLayout::I010: return KernelStore::PlanarWide;
+		case CpuYuvLayout::Av12: return KernelStore::InterleavedAlpha;
+		case CpuYuvLayout::Ayuv: return KernelStore::Ayuv;
+		case CpuYuvLayout::YCoCgR444: return KernelStore::YCoCg444;
+		case CpuYuvLayout::YCoCgR420: return KernelStore::YCoCg420;
+		case CpuYuvLayout::I400: return KernelStore::Grey;
+		default: return KernelStore::Interleaved;
+		}
+	}
+
+	constexpr int32_t CoefficientScale = 1000000;
+
+	// Chroma works on the sum of a 2x2 quad, so its denominator carries the /4 of the box average.
+	constexpr int32_t LumaDenominator = CoefficientScale;
+	constexpr int32_t ChromaDenominator = CoefficientScale * 4;
+
+	// The coefficients don't fit the 16-bit operands of pmaddwd, so SIMD kernels split each one as
+	// c = High(c) * 2^SplitShift + Low(c) and recombine the two partial sums with a shift.
+	constexpr int SplitShift = 10;
+
+	constexpr int16_t HighPart(int32_t c)
+	{
+		return static_cast<int16_t>((c >= 0 ? c : c - ((1 << SplitShift) - 1)) / (1 << SplitShift));
+	}
+
+	constexpr int16_t LowPart(int32_t c)
+	{
+		return static_cast<int16_t>(c - HighPart(c) * (1 << SplitShift));
+	}
+
+	// For byte-wise dot products (vpdpbusd) the coefficients are written as three signed base-128 digits,
+	// c = Digit(c, 2) * 128^2 + Digit(c, 1) * 128 + Digit(c, 0), each in [-64, 63].
+	constexpr int DigitShift = 7;
+
+	constexpr int8_t Digit(int32_t c, int index)
+	{
+		for (int i = 0; i < index; ++i)
+		{
+			int32_t low = ((c % 128) + 128 + 64) % 128 - 64;
+			c = (c - low) / 128;
+		}
+		return static_cast<int8_t>(((c % 128) + 128 + 64) % 128 - 64);
+	}
+
+	// The fast tier works in Q8: coefficients small enough for the signed byte operand of pmaddubsw, with
+	// chroma averaged to 8 bits first, with rounding. The bit-exact tier is never off at all.
+	constexpr int FastShift = 8;
+
+	constexpr int32_t ToFixed(double c, double scale)
+	{
+		return static_cast<int32_t>(c >= 0 ? c * scale + 0.5 : c * scale - 0.5);
+	}
+
+	constexpr int32_t Min(int32_t a, int32_t b)
+	{
+		return a < b ? a : b;
+	}
+
+	// Kr and Kb of each matrix; Kg is what's left.
+	constexpr double LumaWeightR(CpuColorMatrix matrix)
+	{
+		return matrix == CpuColorMatrix::Bt709 ? 0.2126 : 0.299;
+	}
+
+	constexpr double LumaWeightB(CpuColorMatrix matrix)
+	{
+		return matrix == CpuColorMatrix::Bt709 ? 0.0722 : 0.114;
+	}
+
+	// Everything the kernels need to know about one (input format, matrix, range) combination, as
+	// compile-time constants, so each kernel instantiation folds them into its instructions.
+	//
+	// Coefficients are in source byte order: xB weighs byte 0 of a pixel, xG byte 1 and xR byte 2. For
+	// R8G8B8A8 sources the R and B weights trade places, which lets one kernel body read either layout.
+	template<CpuPixelFormat Input, CpuColorMatrix Matrix, CpuColorRange Range>
+	struct ColorTraits
+	{
+	private:
+		static constexpr double Kr = LumaWeightR(Matrix);
+		static constexpr double Kb = LumaWeightB(Matrix);
+		static constexpr double Kg = 1.0 - Kr - Kb;
+
+		// Limited range, and the shader, fit Y into 219 steps and chroma into 224.
+		static constexpr double LumaScale = Range == CpuColorRange::Full ? 1.0 : 219.0 / 255.0;
+		static constexpr double ChromaScale = Range == CpuColorRange::Full ? 1.0 : 224.0 / 255.0;
+
+		static constexpr double YRed = Kr * LumaScale;
+		static constexpr double YGreen = Kg * LumaScale;
+		static constexpr double YBlue = Kb * LumaScale;
+
+		static constexpr double URed = -0.5 * Kr / (1.0 - Kb) * ChromaScale;
+		static constexpr double UGreen = -0.5 * Kg / (1.0 - Kb) * ChromaScale;
+		static constexpr double UBlue = 0.5 * ChromaScale;
+
+		static constexpr double VRed = 0.5 * ChromaScale;
+		static constexpr double VGreen = -0.5 * Kg / (1.0 - Kr) * ChromaScale;
+		static constexpr double VBlue = -0.5 * Kb / (1.0 - Kr) * ChromaScale;
+
+	public:
+		// R is byte 0 of a pixel and B byte 2. Kernels that take the channels apart, like YCoCg-R, need to know.
+		static constexpr bool SwapRB = Input == CpuPixelFormat::Rgba8;
+
+		static constexpr int32_t YR = ToFixed(SwapRB ? YBlue : YRed, CoefficientScale);
+		static constexpr int32_t YG = ToFixed(YGreen, CoefficientScale);
+		static constexpr int32_t YB = ToFixed(SwapRB ? YRed : YBlue, CoefficientScale);
+
+		static constexpr int32_t UR = ToFixed(SwapRB ? UBlue : URed, CoefficientScale);
+		static constexpr int32_t UG = ToFixed(UGreen, CoefficientScale);
+		static constexpr int32_t UB = ToFixed(SwapRB ? URed : UBlue, CoefficientScale);
+
+		static constexpr int32_t VR = ToFixed(SwapRB ? VBlue : VRed, CoefficientScale);
+		static constexpr int32_t VG = ToFixed(VGreen, CoefficientScale);
+		static constexpr int32_t VB = ToFixed(SwapRB ? VRed : VBlue, CoefficientScale);
+
+		// The shader has no +16/+128 offsets, so its negative chroma clamps to zero.
+		static constexpr int32_t LumaOffset = Range == CpuColorRange::Limited ? 16 : 0;
+		static constexpr int32_t ChromaOffset = Range == CpuColorRange::Shader ? 0 : 128;
+
+		// Added to a numerator before the division: the offset plus half a step for round-to-nearest.
+		static constexpr int32_t LumaRounding = LumaOffset * LumaDenominator + LumaDenominator / 2;
+		static constexpr int32_t ChromaRounding = ChromaOffset * ChromaDenominator + ChromaDenominator / 2;
+
+		// Samples are (numerator << NumeratorShift + Rounding) / Divisor, clamped to SampleBits and shifted
+		// up by SampleShift; WideSamples changes these for 16-bit layouts.
+		static constexpr int SampleBits = 8;
+		static constexpr int SampleShift = 0;
+		static constexpr int LumaNumeratorShift = 0;
+		static constexpr int ChromaNumeratorShift = 0;
+		static constexpr int32_t LumaDivisor = LumaDenominator;
+		static constexpr int32_t ChromaDivisor = ChromaDenominator;
+
+		// OrderedDither replaces the half step of the roundings with a threshold that depends on position.
+		static constexpr bool Dither = false;
+
+		// G takes the rounding slack, so the Q8 luma weights add up to the scale exactly and grays stay gray.
+		static constexpr int32_t FastYR = ToFixed(SwapRB ? YBlue : YRed, 1 << FastShift);
+		static constexpr int32_t FastYB = ToFixed(SwapRB ? YRed : YBlue, 1 << FastShift);
+		static constexpr int32_t FastYG = ToFixed(LumaScale, 1 << FastShift) - FastYR - FastYB;
+
+		// G doesn't always fit a signed byte, so pmaddubsw kernels split it across the (R, G) and (B, G)
+		// pairs, keeping each pair's weights at or under 128 so 255 * 128 can't saturate the int16 sum.
+		static constexpr int32_t FastYGWithR = Min(FastYG, 128 - FastYR);
+		static constexpr int32_t FastYGWithB = FastYG - FastYGWithR;
+
+		static constexpr int32_t FastUR = ToFixed(SwapRB ? UBlue : URed, 1 << FastShift);
+		static constexpr int32_t FastUG = ToFixed(UGreen, 1 << FastShift);
+		static constexpr int32_t FastUB = ToFixed(SwapRB ? URed : UBlue, 1 << FastShift);
+
+		static constexpr int32_t FastVR = ToFixed(SwapRB ? VBlue : VRed, 1 << FastShift);
+		static constexpr int32_t FastVG = ToFixed(VGreen, 1 << FastShift);
+		static constexpr int32_t FastVB = ToFixed(SwapRB ? VRed : VBlue, 1 << FastShift);
+
+		static constexpr int32_t FastLumaRounding = (LumaOffset << FastShift) + (1 << (FastShift - 1));
+		static constexpr int32_t FastChromaRounding = (ChromaOffset << FastShift) + (1 << (FastShift - 1));
+
+		static_assert(FastYGWithB <= 127 && FastYB + FastYGWithB <= 128, "Fast luma weights overflow pmaddubsw");
+	};
+
+	// Color with the U and V coefficients exchanged. Kernels instantiated with it write V wherever they
+	// would write U and the other way round, which makes NV21 kernels out of the NV12 ones.
+	template<typename Color>
+	struct SwapChroma : Color
+	{
+		static constexpr int32_t UR = Color::VR;
+		static constexpr int32_t UG = Color::VG;
+		static constexpr int32_t UB = Color::VB;
+
+		static constexpr int32_t VR = Color::UR;
+		static constexpr int32_t VG = Color::UG;
+		static constexpr int32_t VB = Color::UB;
+
+		static constexpr int32_t FastUR = Color::FastVR;
+		static constexpr int32_t FastUG = Color::FastVG;
+		static constexpr int32_t FastUB = Color::FastVB;
+
+		static constexpr int32_t FastVR = Color::FastUR;
+		static constexpr int32_t FastVG = Color::FastUG;
+		static constexpr int32_t FastVB = Color::FastUB;
+	};
+
+	// Smallest shift that makes denominator * 2^shift a multiple of 2^(bits - 7): the scaled divisor of
+	// WideSamples, and half of it, are then integers.
+	constexpr int WideNumeratorShift(int32_t denominator, int bits)
+	{
+		int shift = 0;
+		while ((int64_t(denominator) << shift) % (int64_t(1) << (bits - 7)) != 0)
+			++shift;
+		return shift;
+	}
+
+	// Color for layouts with Bits-bit samples in 16-bit words, shifted up by Shift. A sample is the 8-bit
+	// code scaled by 2^(Bits - 8), the way the video standards define limited range at higher bit depths
+	// (16 becomes 64 at 10 bits, 235 becomes 940), and is rounded once from the same exact numerator rather
+	// than derived from the 8-bit result.
+	//
+	// That's floor((2^(Bits - 8) * n + offset + half a step) / denominator). Multiplying it out overflows
+	// int32 at 16 bits, so the scale goes into the divisor instead, with just enough of a numerator shift to
+	// keep the divisor and its half integral: the largest intermediate, a 16-bit full-range sample, stays
+	// under 2^31.
+	template<typename Color, int Bits, int Shift>
+	struct WideSamples : Color
+	{
+		static constexpr int SampleBits = Bits;
+		static constexpr int SampleShift = Shift;
+
+		static constexpr int LumaNumeratorShift = WideNumeratorShift(LumaDenominator, Bits);
+		static constexpr int ChromaNumeratorShift = WideNumeratorShift(ChromaDenominator, Bits);
+		static constexpr int32_t LumaDivisor = (LumaDenominator << LumaNumeratorShift) >> (Bits - 8);
+		static constexpr int32_t ChromaDivisor = (ChromaDenominator << ChromaNumeratorShift) >> (Bits - 8);
+
+		static constexpr int32_t LumaRounding = (Color::LumaOffset * LumaDenominator << LumaNumeratorShift) + LumaDivisor / 2;
+		static constexpr int32_t ChromaRounding = (Color::ChromaOffset * ChromaDenominator << ChromaNumeratorShift) + ChromaDivisor / 2;
+	};
+
+	// Color for the Dithered tier. Kernels round each sample with a threshold from a 4x4 Bayer matrix at
+	// its position (see LumaRoundingAt) instead of half a step.
+	template<typename Color>
+	struct OrderedDither : Color
+	{
+		static constexpr bool Dither = true;
+	};
+
+	// The Color that a layout's kernels run with: NV21 is NV12 with U and V exchanged, AYUV stores V before U
+	// the same way, and the 16-bit layouts scale their samples.
+	template<typename Color, CpuYuvLayout Layout>
+	using LayoutColor = std::conditional_t<Layout == CpuYuvLayout::Nv21 || Layout == CpuYuvLayout::Ayuv, SwapChroma<Color>,
+		std::conditional_t<(GetYuvSampleBits(Layout) > 8), WideSamples<Color, GetYuvSampleBits(Layout), GetYuvSampleShift(Layout)>, Color>>;
+
+	// The Color of the Dithered tier: 16-bit samples don't band, so they keep their exact kernels.
+	template<typename Color>
+	using DitheredColor = std::conditional_t<Color::SampleBits == 8, OrderedDither<Color>, Color>;
+
+	// The traits of RgbToYuvCS.hlsl itself.
+	typedef ColorTraits<CpuPixelFormat::Bgra8, CpuColorMatrix::Bt601, CpuColorRange::Shader> ShaderColor;
+
+	static_assert(
+		ShaderColor::YR == 256788 && ShaderColor::YG == 504129 && ShaderColor::YB == 97906 &&
+		ShaderColor::UR == -148223 && ShaderColor::UG == -290993 && ShaderColor::UB == 439216 &&
+		ShaderColor::VR == 439216 && ShaderColor::VG == -367788 && ShaderColor::VB == -71427,
+		"The BT.601 tables must reproduce the constants in RgbToYuvCS.hlsl");
+
+	// Ordered dither thresholds, in sixteenths of a step.
+	constexpr uint8_t c_bayer4x4[4][4] =
+	{
+		{ 0, 8, 2, 10 },
+		{ 12, 4, 14, 6 },
+		{ 3, 11, 1, 9 },
+		{ 15, 7, 13, 5 },
+	};
+
+	// The offset plus (threshold + 0.5) / 16 of a step, which averages to the half step of round-to-nearest.
+	constexpr int32_t DitherRounding(int32_t offset, int32_t denominator, uint32_t x, uint32_t y)
+	{
+		return offset * denominator + denominator / 32 * (2 * c_bayer4x4[y % 4][x % 4] + 1);
+	}
+
+	// Rounding of the luma sample at image position (x, y): Color::LumaRounding unless dithering.
+	template<typename Color>
+	constexpr int32_t LumaRoundingAt(uint32_t x, uint32_t y)
+	{
+		static_assert(!Color::Dither || Color::SampleBits == 8, "Only 8-bit samples dither");
+		return Color::Dither ? DitherRounding(Color::LumaOffset, LumaDenominator, x, y) : Color::LumaRounding;
+	}
+
+	// Rounding of the chroma sample at (x, y) of the chroma plane.
+	template<typename Color>
+	constexpr int32_t ChromaRoundingAt(uint32_t x, uint32_t y)
+	{
+		return Color::Dither ? DitherRounding(Color::ChromaOffset, ChromaDenominator, x, y) : Color::ChromaRounding;
+	}
+
+	template<typename Color>
+	constexpr int32_t MaxSample()
+	{
+		return (1 << Color::SampleBits) - 1;
+	}
+
+	inline int32_t DivideAndClamp(int32_t numerator, int32_t rounding, int32_t denominator, int32_t maximum)
+	{
+		// Anything below zero clamps to zero anyway, so truncating division is as good as floor here.
+		int32_t value = (numerator + rounding) / denominator;
+		if (value < 0)
+			return 0;
+		if (value > maximum)
+			return maximum;
+		return value;
+	}
+
+	template<typename Color>
+	int32_t Luma(uint8_t const* pixel, int32_t rounding = Color::LumaRounding)
+	{
+		int32_t n = Color::YB * pixel[0] + Color::YG * pixel[1] + Color::YR * pixel[2];
+		return DivideAndClamp(n * (1 << Color::LumaNumeratorShift), rounding, Color::LumaDivisor, MaxSample<Color>());
+	}
+
+	template<typename Color>
+	void Chroma(uint8_t const* p0, uint8_t const* p1, uint8_t const* p2, uint8_t const* p3, int32_t* u, int32_t* v, int32_t rounding = Color::ChromaRounding)
+	{
+		int32_t b = p0[0] + p1[0] + p2[0] + p3[0];
+		int32_t g = p0[1] + p1[1] + p2[1] + p3[1];
+		int32_t r = p0[2] + p1[2] + p2[2] + p3[2];
+
+		int32_t scale = 1 << Color::ChromaNumeratorShift;
+		*u = DivideAndClamp((Color::UB * b + Color::UG * g + Color::UR * r) * scale, rounding, Color::ChromaDivisor, MaxSample<Color>());
+		*v = DivideAndClamp((Color::VB * b + Color::VG * g + Color::VR * r) * scale, rounding, Color::ChromaDivisor, MaxSample<Color>());
+	}
+
+	inline int32_t ShiftAndClamp(int32_t value, int32_t rounding)
+	{
+		// Arithmetic shift, so negative values round toward minus infinity like the SIMD kernels.
+		value = (value + rounding) >> FastShift;
+		if (value < 0)
+			return 0;
+		if (value > 255)
+			return 255;
+		return value;
+	}
+
+	template<typename Color>
+	int32_t LumaFast(uint8_t const* pixel)
+	{
+		return ShiftAndClamp(Color::FastYB * pixel[0] + Color::FastYG * pixel[1] + Color::FastYR * pixel[2], Color::FastLumaRounding);
+	}
+
+	template<typename Color>
+	void ChromaFast(uint8_t const* p0, uint8_t const* p1, uint8_t const* p2, uint8_t const* p3, int32_t* u, int32_t* v)
+	{
+		int32_t b = (p0[0] + p1[0] + p2[0] + p3[0] + 2) >> 2;
+		int32_t g = (p0[1] + p1[1] + p2[1] + p3[1] + 2) >> 2;
+		int32_t r = (p0[2] + p1[2] + p2[2] + p3[2] + 2) >> 2;
+
+		*u = ShiftAndClamp(Color::FastUB * b + Color::FastUG * g + Color::FastUR * r, Color::FastChromaRounding);
+		*v = ShiftAndClamp(Color::FastVB * b + Color::FastVG * g + Color::FastVR * r, Color::FastChromaRounding);
+	}
+
+	// Luma of one pixel at image position (x, y) in either tier. The fast tier never dithers.
+	template<typename Color, bool Fast>
+	int32_t LumaAt(uint8_t const* pixel, uint32_t x, uint32_t y)
+	{
+		return Fast ? LumaFast<Color>(pixel) : Luma<Color>(pixel, LumaRoundingAt<Color>(x, y));
+	}
+
+	// Chroma of a quad for the chroma sample at (x, y) of its plane, in either tier.
+	template<typename Color, bool Fast>
+	void ChromaAt(uint8_t const* p0, uint8_t const* p1, uint8_t const* p2, uint8_t const* p3, uint32_t x, uint32_t y, int32_t* u, int32_t* v)
+	{
+		if (Fast)
+			ChromaFast<Color>(p0, p1, p2, p3, u, v);
+		else
+			Chroma<Color>(p0, p1, p2, p3, u, v, ChromaRoundingAt<Color>(x, y));
+	}
+
+	// Stores sample number index of a row: a byte, or for 16-bit layouts a little-endian word shifted into
+	// place.
+	template<typename Color>
+	void WriteSample(uint8_t* row, uint32_t index, int32_t sample)
+	{
+		if (Color::SampleBits == 8)
+		{
+			row[index] = static_cast<uint8_t>(sample);
+		}
+		else
+		{
+			uint32_t word = static_cast<uint32_t>(sample) << Color::SampleShift;
+			row[index * 2] = static_cast<uint8_t>(word);
+			row[index * 2 + 1] = static_cast<uint8_t>(word >> 8);
+		}
+	}
+
+	// Scalar versions of the row kernels over [begin, end) of the target row. SIMD kernels use these for
+	// whatever is left past their last full vector.
+	template<typename Color, bool Fast>
+	void LumaSpan(uint8_t const* src, uint32_t srcWidth, uint8_t* dstY, uint32_t begin, uint32_t end)
+	{
+		for (uint32_t x = begin; x < end; ++x)
+		{
+			// Padding column for odd widths
+			uint32_t srcX = x < srcWidth ? x : srcWidth - 1;
+			WriteSample<Color>(dstY, x, LumaAt<Color, Fast>(src + srcX * 4, x, 0));
+		}
+	}
+
+	// One I400 row: luma alone in dst.Y, dithered by image position like the luma of every other Row kernel.
+	template<typename Color, bool Fast>
+	void GreyRowSpan(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t begin, uint32_t end)
+	{
+		for (uint32_t x = begin; x < end; ++x)
+		{
+			uint32_t srcX = x < srcWidth ? x : srcWidth - 1;
+			dst.Y[x] = static_cast<uint8_t>(LumaAt<Color, Fast>(src + srcX * 4, dst.Left + x, dst.Top));
+		}
+	}
+
+	// Two luma rows and their chroma, interleaved in dst.UV or in the dst.U and dst.V planes, and with Alpha
+	// the source alpha of both rows in dst.A0 and dst.A1. begin and end are even.
+	template<typename Color, bool Fast, bool Planar, bool Alpha>
+	void RowPairSpan(uint8_t const* src0, uint8_t const* src1, uint32_t srcWidth, CpuKernels::RowPairTarget const& dst, uint32_t begin, uint32_t end)
+	{
+		uint32_t last = srcWidth - 1;
+
+		for (uint32_t x = begin; x < end; x += 2)
+		{
+			uint32_t left = x < last ? x : last;
+			uint32_t right = x + 1 < last ? x + 1 : last;
+
+			uint8_t const* topLeft = src0 + left * 4;
+			uint8_t const* topRight = src0 + right * 4;
+			uint8_t const* bottomLeft = src1 + left * 4;
+			uint8_t const* bottomRight = src1 + right * 4;
+
+			uint32_t imageX = dst.Left + x;
+			WriteSample<Color>(dst.Y0, x, LumaAt<Color, Fast>(topLeft, imageX, dst.Top));
+			WriteSample<Color>(dst.Y0, x + 1, LumaAt<Color, Fast>(topRight, imageX + 1, dst.Top));
+			WriteSample<Color>(dst.Y1, x, LumaAt<Color, Fast>(bottomLeft, imageX, dst.Top + 1));
+			WriteSample<Color>(dst.Y1, x + 1, LumaAt<Color, Fast>(bottomRight, imageX + 1, dst.Top + 1));
+
+			if (Alpha)
+			{
+				dst.A0[x] = topLeft[3];
+				dst.A0[x + 1] = topRight[3];
+				dst.A1[x] = bottomLeft[3];
+				dst.A1[x + 1] = bottomRight[3];
+			}
+
+			int32_t u;
+			int32_t v;
+			ChromaAt<Color, Fast>(topLeft, topRight, bottomLeft, bottomRight, imageX / 2, dst.Top / 2, &u, &v);
+			WriteSample<Color>(Planar ? dst.U : dst.UV, Planar ? x / 2 : x, u);
+			WriteSample<Color>(Planar ? dst.V : dst.UV, Planar ? x / 2 : x + 1, v);
+		}
+	}
+
+	// One packed 4:2:2 row: each pixel pair becomes [Y0 U Y1 V], or [U Y0 V Y1] for UYVY, in dst.Y. begin and
+	// end are even.
+	//
+	// The chroma of a pair is the 2x2 chroma of the pair stacked on itself. That's the same number: twice the
+	// pair sum over ChromaDenominator rounds exactly like the pair sum over half of it, and the fast tier's
+	// (2 * sum + 2) >> 2 is the rounded pair average. So SIMD kernels can reuse their 2x2 chroma code with
+	// one row passed as both.
+	template<typename Color, bool Fast, bool Uyvy>
+	void PackedRowSpan(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t begin, uint32_t end)
+	{
+		uint32_t last = srcWidth - 1;
+
+		for (uint32_t x = begin; x < end; x += 2)
+		{
+			uint8_t const* left = src + (x < last ? x : last) * 4;
+			uint8_t const* right = src + (x + 1 < last ? x + 1 : last) * 4;
+
+			uint8_t* pair = dst.Y + x * 2;
+			uint32_t imageX = dst.Left + x;
+			int32_t u;
+			int32_t v;
+			ChromaAt<Color, Fast>(left, right, left, right, imageX / 2, dst.Top, &u, &v);
+
+			pair[Uyvy ? 1 : 0] = static_cast<uint8_t>(LumaAt<Color, Fast>(left, imageX, dst.Top));
+			pair[Uyvy ? 0 : 1] = static_cast<uint8_t>(u);
+			pair[Uyvy ? 3 : 2] = static_cast<uint8_t>(LumaAt<Color, Fast>(right, imageX + 1, dst.Top));
+			pair[Uyvy ? 2 : 3] = static_cast<uint8_t>(v);
+		}
+	}
+
+	// One row of luma and its 4:2:2 or, with FullChroma, 4:4:4 chroma, interleaved in dst.UV or in the dst.U
+	// and dst.V planes. begin and end are even.
+	//
+	// Like a packed row, 4:2:2 chroma is the 2x2 chroma of a pixel pair stacked on itself. 4:4:4 chroma is
+	// that of four copies of one pixel, which rounds exactly like the pixel over a quarter of the denominator
+	// in both tiers, so SIMD kernels can feed a pixel to their quad code as a quad sum of four times itself.
+	template<typename Color, bool Fast, bool Planar, bool FullChroma>
+	void RowSpan(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t begin, uint32_t end)
+	{
+		uint32_t last = srcWidth - 1;
+
+		for (uint32_t x = begin; x < end; x += 2)
+		{
+			uint8_t const* left = src + (x < last ? x : last) * 4;
+			uint8_t const* right = src + (x + 1 < last ? x + 1 : last) * 4;
+
+			uint32_t imageX = dst.Left + x;
+			dst.Y[x] = static_cast<uint8_t>(LumaAt<Color, Fast>(left, imageX, dst.Top));
+			dst.Y[x + 1] = static_cast<uint8_t>(LumaAt<Color, Fast>(right, imageX + 1, dst.Top));
+
+			int32_t u[2];
+			int32_t v[2];
+			if (FullChroma)
+			{
+				ChromaAt<Color, Fast>(left, left, left, left, imageX, dst.Top, &u[0], &v[0]);
+				ChromaAt<Color, Fast>(right, right, right, right, imageX + 1, dst.Top, &u[1], &v[1]);
+			}
+			else
+			{
+				ChromaAt<Color, Fast>(left, right, left, right, imageX / 2, dst.Top, &u[0], &v[0]);
+			}
+
+			uint32_t samples = FullChroma ? 2 : 1;
+			uint32_t first = FullChroma ? x : x / 2;
+			for (uint32_t i = 0; i < samples; ++i)
+			{
+				if (Planar)
+				{
+					dst.U[first + i] = static_cast<uint8_t>(u[i]);
+					dst.V[first + i] = static_cast<uint8_t>(v[i]);
+				}
+				else
+				{
+					dst.UV[(first + i) * 2] = static_cast<uint8_t>(u[i]);
+					dst.UV[(first + i) * 2 + 1] = static_cast<uint8_t>(v[i]);
+				}
+			}
+		}
+	}
+
+	// One AYUV row: [V U Y A] per pixel in dst.Y, with 4:4:4 chroma as in RowSpan. The kernels run with
+	// SwapChroma (see LayoutColor), so the sample they compute as U is V, and goes first. begin and end are
+	// even.
+	template<typename Color, bool Fast>
+	void AyuvRowSpan(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t begin, uint32_t end)
+	{
+		for (uint32_t x = begin; x < end; ++x)
+		{
+			uint8_t const* pixel = src + (x < srcWidth ? x : srcWidth - 1) * 4;
+
+			uint32_t imageX = dst.Left + x;
+			int32_t u;
+			int32_t v;
+			ChromaAt<Color, Fast>(pixel, pixel, pixel, pixel, imageX, dst.Top, &u, &v);
+
+			uint8_t* out = dst.Y + x * 4;
+			out[0] = static_cast<uint8_t>(u);
+			out[1] = static_cast<uint8_t>(v);
+			out[2] = static_cast<uint8_t>(LumaAt<Color, Fast>(pixel, imageX, dst.Top));
+			out[3] = pixel[3];
+		}
+	}
+
+	// YCoCg-R of one pixel by the lifting steps (see CpuYuvLayout). Right shifts of negative values are
+	// arithmetic, like the SIMD kernels', so Co >> 1 rounds toward minus infinity.
+	template<bool SwapRB>
+	void YCoCg(uint8_t const* pixel, int32_t* y, int32_t* co, int32_t* cg)
+	{
+		int32_t r = pixel[SwapRB ? 0 : 2];
+		int32_t g = pixel[1];
+		int32_t b = pixel[SwapRB ? 2 : 0];
+
+		*co = r - b;
+		int32_t t = b + (*co >> 1);
+		*cg = g - t;
+		*y = t + (*cg >> 1);
+	}
+
+	// Stores a signed sample as a little-endian 16-bit word.
+	inline void WriteWord(uint8_t* row, uint32_t index, int32_t sample)
+	{
+		row[index * 2] = static_cast<uint8_t>(sample);
+		row[index * 2 + 1] = static_cast<uint8_t>(static_cast<uint32_t>(sample) >> 8);
+	}
+
+	inline int16_t ReadWord(uint8_t const* row, uint32_t index)
+	{
+		return static_cast<int16_t>(row[index * 2] | row[index * 2 + 1] << 8);
+	}
+
+	// YCoCg-R counterparts of the spans above. LumaRow writes only Y, which still needs Co and Cg.
+	template<bool SwapRB>
+	void YCoCgLumaSpan(uint8_t const* src, uint32_t srcWidth, uint8_t* dstY, uint32_t begin, uint32_t end)
+	{
+		for (uint32_t x = begin; x < end; ++x)
+		{
+			int32_t y;
+			int32_t co;
+			int32_t cg;
+			YCoCg<SwapRB>(src + (x < srcWidth ? x : srcWidth - 1) * 4, &y, &co, &cg);
+			WriteWord(dstY, x, y);
+		}
+	}
+
+	// One 4:4:4 row: Y, Co and Cg words in dst.Y, dst.U and dst.V.
+	template<bool SwapRB>
+	void YCoCgRowSpan(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t begin, uint32_t end)
+	{
+		for (uint32_t x = begin; x < end; ++x)
+		{
+			int32_t y;
+			int32_t co;
+			int32_t cg;
+			YCoCg<SwapRB>(src + (x < srcWidth ? x : srcWidth - 1) * 4, &y, &co, &cg);
+			WriteWord(dst.Y, x, y);
+			WriteWord(dst.U, x, co);
+			WriteWord(dst.V, x, cg);
+		}
+	}
+
+	// One 4:2:0 row pair: Y words in dst.Y0 and dst.Y1, and Co and Cg of each 2x2 block in dst.U and dst.V,
+	// averaged as floor((sum + 2) / 4). begin and end are even.
+	template<bool SwapRB>
+	void YCoCgRowPairSpan(uint8_t const* src0, uint8_t const* src1, uint32_t srcWidth, CpuKernels::RowPairTarget const& dst, uint32_t begin, uint32_t end)
+	{
+		uint32_t last = srcWidth - 1;
+
+		for (uint32_t x = begin; x < end; x += 2)
+		{
+			uint32_t left = x < last ? x : last;
+			uint32_t right = x + 1 < last ? x + 1 : last;
+			uint8_t const* quad[4] = { src0 + left * 4, src0 + right * 4, src1 + left * 4, src1 + right * 4 };
+			uint8_t* rows[4] = { dst.Y0, dst.Y0, dst.Y1, dst.Y1 };
+
+			int32_t coSum = 0;
+			int32_t cgSum = 0;
+			for (int i = 0; i < 4; ++i)
+			{
+				int32_t y;
+				int32_t co;
+				int32_t cg;
+				YCoCg<SwapRB>(quad[i], &y, &co, &cg);
+				WriteWord(rows[i], x + i % 2, y);
+				coSum += co;
+				cgSum += cg;
+			}
+
+			WriteWord(dst.U, x / 2, (coSum + 2) >> 2);
+			WriteWord(dst.V, x / 2, (cgSum + 2) >> 2);
+		}
+	}
+
+	// Pixels [begin, end) of one row back from YCoCg-R, with opaque alpha; Subsampled rows share each Co and
+	// Cg sample between two pixels. The steps wrap like the 16-bit lanes of the SIMD kernels and the result
+	// clamps to [0, 255], so any input decodes the same on every level. Samples from a 4:4:4 conversion
+	// never wrap or clamp.
+	template<bool SwapRB, bool Subsampled>
+	void YCoCgInverseSpan(CpuKernels::InverseRowSource const& src, uint8_t* dst, uint32_t begin, uint32_t end)
+	{
+		auto clamp = [](int16_t value)
+		{
+			return static_cast<uint8_t>(value < 0 ? 0 : value > 255 ? 255 : value);
+		};
+
+		for (uint32_t x = begin; x < end; ++x)
+		{
+			uint32_t chromaX = Subsampled ? x / 2 : x;
+			int16_t y = ReadWord(src.Y, x);
+			int16_t co = ReadWord(src.U, chromaX);
+			int16_t cg = ReadWord(src.V, chromaX);
+
+			int16_t t = static_cast<int16_t>(y - (cg >> 1));
+			int16_t g = static_cast<int16_t>(cg + t);
+			int16_t b = static_cast<int16_t>(t - (co >> 1));
+			int16_t r = static_cast<int16_t>(b + co);
+
+			uint8_t* pixel = dst + x * 4;
+			pixel[SwapRB ? 2 : 0] = clamp(b);
+			pixel[1] = clamp(g);
+			pixel[SwapRB ? 0 : 2] = clamp(r);
+			pixel[3] = 255;
+		}
+	}
+
+	// Elements [begin, end) of a tensor row, looked up in table by code; Doubled rows repeat every code.
+	// See CpuKernels::TensorKernels.
+	template<typename Element, bool Doubled>
+	void TensorSpan(uint8_t const* codes, void const* table, void* dst, uint32_t begin, uint32_t end)
+	{
+		Element const* elements = static_cast<Element const*>(table);
+		Element* row = static_cast<Element*>(dst);
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			row[i] = elements[codes[Doubled ? i / 2 : i]];
+		}
+	}
+
+	// How far ahead of the kernels the streaming variants prefetch the source, in bytes.
+	constexpr uint32_t PrefetchDistance = 1024;
+
+	// Number of leading target pixels to convert with ordinary stores before all target rows of a row pair
+	// reach the given alignment. Planar chroma rows hold half a sample per pixel; 8-bit ones are stored in
+	// half-width vectors, so they only need half the alignment. Alpha rows are like luma rows. Returns false
+	// if the rows never line up at the same pixel, or only past dstWidth.
+	inline bool GetStreamingHead(CpuKernels::RowPairTarget const& dst, bool planar, bool alpha, uintptr_t alignment, uint32_t dstWidth, uint32_t* head, uint32_t sampleSize = 1)
+	{
+		uintptr_t misalignment = reinterpret_cast<uintptr_t>(dst.Y0) % alignment;
+		if (reinterpret_cast<uintptr_t>(dst.Y1) % alignment != misalignment)
+			return false;
+		if (alpha && (reinterpret_cast<uintptr_t>(dst.A0) % alignment != misalignment || reinterpret_cast<uintptr_t>(dst.A1) % alignment != misalignment))
+			return false;
+
+		// Chroma is written in pairs, so the head has to be an even number of samples.
+		uintptr_t bytes = (alignment - misalignment) % alignment;
+		uintptr_t pixels = bytes / sampleSize;
+		if (bytes % (2 * sampleSize) != 0 || pixels > dstWidth)
+			return false;
+
+		if (planar)
+		{
+			uintptr_t chromaAlignment = alignment / 2 * sampleSize;
+			uintptr_t chromaOffset = pixels / 2 * sampleSize;
+			if (reinterpret_cast<uintptr_t>(dst.U + chromaOffset) % chromaAlignment != 0 || reinterpret_cast<uintptr_t>(dst.V + chromaOffset) % chromaAlignment != 0)
+				return false;
+		}
+		else if (reinterpret_cast<uintptr_t>(dst.UV) % alignment != misalignment)
+		{
+			return false;
+		}
+
+		*head = static_cast<uint32_t>(pixels);
+		return true;
+	}
+
+	// The same for the rows of a RowSpan. Chroma rows need the full alignment, except half-width planar ones,
+	// which are stored in half-width vectors.
+	inline bool GetRowStreamingHead(CpuKernels::RowTarget const& dst, bool planar, bool fullChroma, uintptr_t alignment, uint32_t dstWidth, uint32_t* head)
+	{
+		uintptr_t pixels = (alignment - reinterpret_cast<uintptr_t>(dst.Y) % alignment) % alignment;
+		if (pixels % 2 != 0 || pixels > dstWidth)
+			return false;
+
+		if (planar)
+		{
+			uintptr_t chromaAlignment = fullChroma ? alignment : alignment / 2;
+			uintptr_t chromaOffset = fullChroma ? pixels : pixels / 2;
+			if (reinterpret_cast<uintptr_t>(dst.U + chromaOffset) % chromaAlignment != 0 || reinterpret_cast<uintptr_t>(dst.V + chromaOffset) % chromaAlignment != 0)
+				return false;
+		}
+		else if (reinterpret_cast<uintptr_t>(dst.UV + (fullChroma ? pixels * 2 : pixels)) % alignment != 0)
+		{
+			return false;
+		}
+
+		*head = static_cast<uint32_t>(pixels);
+		return true;
+	}
+
+	// The same for the rows of YCoCg-R words: every luma row and every chroma row reaches the alignment at
+	// the same even pixel. Subsampled chroma rows advance a word per pixel pair.
+	inline bool GetYCoCgStreamingHead(uint8_t* const* lumaRows, int lumaRowCount, uint8_t* const* chromaRows, int chromaRowCount, bool subsampled,
+		uintptr_t alignment, uint32_t dstWidth, uint32_t* head)
+	{
+		for (uint32_t pixels = 0; pixels < alignment && pixels <= dstWidth; pixels += 2)
+		{
+			bool aligned = true;
+			for (int i = 0; i < lumaRowCount; ++i)
+			{
+				aligned = aligned && reinterpret_cast<uintptr_t>(lumaRows[i] + pixels * 2) % alignment == 0;
+			}
+			for (int i = 0; i < chromaRowCount; ++i)
+			{
+				aligned = aligned && reinterpret_cast<uintptr_t>(chromaRows[i] + (subsampled ? pixels : pixels * 2)) % alignment == 0;
+			}
+
+			if (aligned)
+			{
+				*head = pixels;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// The same for a packed row, at pixelSize bytes per pixel and whole pixel pairs. I400 rows are packed
+	// rows of a byte per pixel.
+	inline bool GetPackedStreamingHead(uint8_t const* dst, uintptr_t alignment, uint32_t dstWidth, uint32_t* head, uint32_t pixelSize = 2)
+	{
+		uintptr_t bytes = (alignment - reinterpret_cast<uintptr_t>(dst) % alignment) % alignment;
+		if (bytes % (pixelSize * 2) != 0 || bytes / pixelSize > dstWidth)
+			return false;
+
+		*head = static_cast<uint32_t>(bytes / pixelSize);
+		return true;
+	}
+}
+}
@@ -0,0 +1,1097 @@
+// CpuConverter.cpp: Drives the row kernels over a whole image.
+
+#include "CpuConverter.h"
+
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace
+{
+	uint32_t RoundUpToEven(uint32_t i)
+	{
+		return (i % 2 != 0) ? i + 1 : i;
+	}
+
+	size_t RoundUp(size_t size, size_t granularity)
+	{
+		return (size + granularity - 1) / granularity * granularity;
+	}
+
+	// Tiled targets are converted a block at a time into linear rows of this much scratch, then copied out
+	// tile by tile. Small enough to stay in L2 with the source rows of the block, large enough that the
+	// kernels read long runs of each source row.
+	size_t const TileStagingSize = 64 * 1024;
+
+	void ValidateTiling(CpuYuvLayout layout, CpuYuvTiling const& tiling)
+	{
+		if (IsTiledYuvLayout(layout) && (tiling.Width == 0 || tiling.Height == 0 || tiling.Width % 2 != 0 || tiling.Height % 2 != 0))
+			throw std::invalid_argument("Tile sizes must be even and non-zero.");
+	}
+
+	// Row pitch of a plane: a tiled plane's rows are whole tiles.
+	size_t GetTiledPitch(CpuYuvLayout layout, size_t pitch, CpuYuvTiling const& tiling)
+	{
+		return IsTiledYuvLayout(layout) ? RoundUp(pitch, tiling.Width) : pitch;
+	}
+
+	// Rows a plane takes in memory: a tiled plane's are whole rows of tiles.
+	uint32_t GetTiledRowCount(CpuYuvLayout layout, uint32_t rowCount, CpuYuvTiling const& tiling)
+	{
+		return IsTiledYuvLayout(layout) ? static_cast<uint32_t>(RoundUp(rowCount, tiling.Height)) : rowCount;
+	}
+
+	// Rows of the target: even for layouts that subsample chroma vertically, like width always is.
+	uint32_t GetYuvHeight(CpuYuvLayout layout, uint32_t height)
+	{
+		return HasVerticalChromaSubsampling(layout) ? RoundUpToEven(height) : height;
+	}
+
+	// Bytes per row of the Y plane, or of the single plane of a packed layout, without padding. The alpha
+	// plane has the same rows as Y.
+	size_t GetLumaRowSize(CpuYuvLayout layout, uint32_t width)
+	{
+		return IsPackedYuvLayout(layout) ? size_t(width) * GetPackedPixelSize(layout) : size_t(width) * GetYuvSampleSize(layout);
+	}
+
+	// Bytes per chroma row of the layout, without padding; 0 for layouts without chroma planes.
+	size_t GetChromaRowSize(CpuYuvLayout layout, uint32_t width)
+	{
+		if (!HasChromaPlanes(layout))
+			return 0;
+
+		size_t samples = HasHorizontalChromaSubsampling(layout) ? width / 2 : width;
+		return (IsPlanarYuvLayout(layout) ? samples : samples * 2) * GetYuvSampleSize(layout);
+	}
+
+	uint32_t GetChromaHeight(CpuYuvLayout layout, uint32_t height)
+	{
+		return HasVerticalChromaSubsampling(layout) ? height / 2 : height;
+	}
+
+	void ValidateImages(CpuRgbImage const& rgb, CpuYuvImage const& yuv, CpuYuvLayout layout)
+	{
+		if (!rgb.Data || rgb.Width == 0 || rgb.Height == 0 || rgb.RowPitch < rgb.Width * 4ull)
+			throw std::invalid_argument("Invalid source image.");
+
+		// Chroma subsampling needs multiple-of-two sizes.
+		if (yuv.Width != RoundUpToEven(rgb.Width) || yuv.Height != GetYuvHeight(layout, rgb.Height))
+			throw std::invalid_argument("Target must be the source size rounded up to even.");
+
+		if (IsTiledYuvLayout(layout))
+		{
+			ValidateTiling(layout, yuv.Tiling);
+			if (yuv.YRowPitch % yuv.Tiling.Width != 0 || yuv.UVRowPitch % yuv.Tiling.Width != 0)
+				throw std::invalid_argument("Tiled row pitches must be whole tiles.");
+		}
+
+		size_t chromaRowSize = GetChromaRowSize(layout, yuv.Width);
+		bool chromaValid = !HasChromaPlanes(layout) ? true
+			: IsPlanarYuvLayout(layout) ? yuv.U && yuv.V && yuv.URowPitch >= chromaRowSize && yuv.VRowPitch >= chromaRowSize
+			: yuv.UV && yuv.UVRowPitch >= chromaRowSize;
+		bool alphaValid = !HasAlphaPlane(layout) || (yuv.A && yuv.ARowPitch >= yuv.Width);
+		if (!yuv.Y || yuv.YRowPitch < GetLumaRowSize(layout, yuv.Width) || !chromaValid || !alphaValid)
+			throw std::invalid_argument("Invalid target image.");
+	}
+
+	// Size of the target with the given row pitches, planes back to back. Planar layouts have two chroma
+	// planes of chromaPitch each; packed layouts and I400 have none. An alpha plane takes lumaPitch. Tiled planes
+	// take whole rows of tiles.
+	size_t GetYuvImageSize(CpuYuvLayout layout, uint32_t height, size_t lumaPitch, size_t chromaPitch, CpuYuvTiling const& tiling)
+	{
+		size_t lumaSize = lumaPitch * GetTiledRowCount(layout, height, tiling);
+		size_t chromaSize = chromaPitch * GetTiledRowCount(layout, GetChromaHeight(layout, height), tiling);
+		size_t alphaSize = HasAlphaPlane(layout) ? lumaPitch * height : 0;
+		return lumaSize + (!HasChromaPlanes(layout) ? 0 : IsPlanarYuvLayout(layout) ? chromaSize * 2 : chromaSize) + alphaSize;
+	}
+
+	// Points image at planes back to back from data, in the order of the layout: Y, then UV, U and V for
+	// the planar layouts, or V and U for YV12, then A if the layout has it. Packed layouts and I400 only have Y.
+	void PlaceYuvPlanes(uint8_t* data, CpuYuvLayout layout, size_t lumaPitch, size_t chromaPitch, CpuYuvTiling const& tiling, CpuYuvImage* image)
+	{
+		uint8_t* chroma = !HasChromaPlanes(layout) ? nullptr : data + lumaPitch * GetTiledRowCount(layout, image->Height, tiling);
+		uint8_t* secondChroma = IsPlanarYuvLayout(layout) ? chroma + chromaPitch * GetChromaHeight(layout, image->Height) : nullptr;
+		bool planar = IsPlanarYuvLayout(layout);
+
+		image->Y = data;
+		image->YRowPitch = lumaPitch;
+		image->UV = planar ? nullptr : chroma;
+		image->UVRowPitch = chroma && !planar ? chromaPitch : 0;
+		image->U = planar ? (layout == CpuYuvLayout::Yv12 ? secondChroma : chroma) : nullptr;
+		image->URowPitch = planar ? chromaPitch : 0;
+		image->V = planar ? (layout == CpuYuvLayout::Yv12 ? chroma : secondChroma) : nullptr;
+		image->VRowPitch = planar ? chromaPitch : 0;
+		image->A = HasAlphaPlane(layout) ? chroma + chromaPitch * GetChromaHeight(layout, image->Height) : nullptr;
+		image->ARowPitch = HasAlphaPlane(layout) ? lumaPitch : 0;
+		image->Tiling = IsTiledYuvLayout(layout) ? tiling : CpuYuvTiling();
+	}
+
+	// A plane of a footprint that the layout uses, with the bytes of each row and the rows it needs.
+	struct FootprintPlane
+	{
+		CpuYuvPlaneFootprint CpuYuvFootprint::* Plane;
+		size_t RowSize;
+		uint32_t RowCount;
+	};
+
+	// The planes the layout uses, in the order of CpuYuvBuffer; returns how many.
+	uint32_t GetFootprintPlanes(CpuYuvLayout layout, uint32_t width, uint32_t height, FootprintPlane* planes)
+	{
+		size_t chromaRowSize = GetChromaRowSize(layout, width);
+		uint32_t chromaHeight = GetChromaHeight(layout, height);
+		bool yv12 = layout == CpuYuvLayout::Yv12;
+
+		uint32_t count = 0;
+		planes[count++] = { &CpuYuvFootprint::Y, GetLumaRowSize(layout, width), height };
+		if (IsPlanarYuvLayout(layout))
+		{
+			planes[count++] = { yv12 ? &CpuYuvFootprint::V : &CpuYuvFootprint::U, chromaRowSize, chromaHeight };
+			planes[count++] = { yv12 ? &CpuYuvFootprint::U : &CpuYuvFootprint::V, chromaRowSize, chromaHeight };
+		}
+		else if (HasChromaPlanes(layout))
+		{
+			planes[count++] = { &CpuYuvFootprint::UV, chromaRowSize, chromaHeight };
+		}
+		if (HasAlphaPlane(layout))
+			planes[count++] = { &CpuYuvFootprint::A, width, height };
+		return count;
+	}
+
+	// One past the last byte of a plane: the last row isn't padded to the pitch.
+	uint64_t GetFootprintPlaneEnd(CpuYuvPlaneFootprint const& plane, FootprintPlane const& size)
+	{
+		return plane.Offset + uint64_t(plane.RowPitch) * (size.RowCount - 1) + size.RowSize;
+	}
+
+	uint8_t* GetRow(uint8_t* plane, size_t rowPitch, uint32_t row, uint32_t x)
+	{
+		return plane ? plane + row * rowPitch + x : nullptr;
+	}
+
+	// Target rows of the row pair starting at row y, from pixel x on.
+	CpuKernels::RowPairTarget GetRowPairTarget(CpuYuvImage const& yuv, CpuYuvLayout layout, uint32_t y, uint32_t x)
+	{
+		uint32_t sampleSize = GetYuvSampleSize(layout);
+		return
+		{
+			GetRow(yuv.Y, yuv.YRowPitch, y, x * sampleSize),
+			GetRow(yuv.Y, yuv.YRowPitch, y + 1, x * sampleSize),
+			GetRow(yuv.UV, yuv.UVRowPitch, y / 2, x * sampleSize),
+			GetRow(yuv.U, yuv.URowPitch, y / 2, x / 2 * sampleSize),
+			GetRow(yuv.V, yuv.VRowPitch, y / 2, x / 2 * sampleSize),
+			GetRow(yuv.A, yuv.ARowPitch, y, x),
+			GetRow(yuv.A, yuv.ARowPitch, y + 1, x),
+			x,
+			y,
+		};
+	}
+
+	// Byte x of row y of a tiled plane.
+	uint8_t* GetTiledRow(uint8_t* plane, size_t rowPitch, CpuYuvTiling const& tiling, uint32_t y, uint32_t x)
+	{
+		return plane + size_t(y / tiling.Height) * rowPitch * tiling.Height + size_t(x / tiling.Width) * tiling.Width * tiling.Height +
+			(y % tiling.Height) * tiling.Width + x % tiling.Width;
+	}
+
+	// Copies rowCount rows of size bytes. The sizes of whole rows of common tiles get fixed-size copies,
+	// which compile to plain moves instead of calls.
+	template<size_t Size>
+	void CopyRows(uint8_t* dst, size_t dstPitch, uint8_t const* src, size_t srcPitch, uint32_t rowCount)
+	{
+		for (uint32_t row = 0; row < rowCount; ++row)
+		{
+			std::memcpy(dst + row * dstPitch, src + row * srcPitch, Size);
+		}
+	}
+
+	void CopyRows(uint8_t* dst, size_t dstPitch, uint8_t const* src, size_t srcPitch, size_t size, uint32_t rowCount)
+	{
+		switch (size)
+		{
+		case 4: CopyRows<4>(dst, dstPitch, src, srcPitch, rowCount); return;
+		case 8: CopyRows<8>(dst, dstPitch, src, srcPitch, rowCount); return;
+		case 16: CopyRows<16>(dst, dstPitch, src, srcPitch, rowCount); return;
+		case 32: CopyRows<32>(dst, dstPitch, src, srcPitch, rowCount); return;
+		case 64: CopyRows<64>(dst, dstPitch, src, srcPitch, rowCount); return;
+		case 128: CopyRows<128>(dst, dstPitch, src, srcPitch, rowCount); return;
+		}
+
+		for (uint32_t row = 0; row < rowCount; ++row)
+		{
+			std::memcpy(dst + row * dstPitch, src + row * srcPitch, size);
+		}
+	}
+
+	// Copies rows [beginY, endY) x bytes [beginX, endX) of a tiled plane from linear rows, which start at
+	// (beginX, beginY). Goes tile by tile, so each row of tiles gets written front to back.
+	void CopyRowsToTiles(uint8_t const* rows, size_t rowPitch, uint8_t* plane, size_t planePitch, CpuYuvTiling const& tiling,
+		uint32_t beginX, uint32_t endX, uint32_t beginY, uint32_t endY)
+	{
+		size_t tileSize = size_t(tiling.Width) * tiling.Height;
+		for (uint32_t bandY = beginY; bandY < endY; )
+		{
+			uint32_t bandEndY = (bandY / tiling.Height + 1) * tiling.Height;
+			bandEndY = bandEndY < endY ? bandEndY : endY;
+
+			// The tiles of a row of tiles follow each other; only the first may start inside a tile.
+			uint8_t* tile = GetTiledRow(plane, planePitch, tiling, bandY, beginX);
+			uint8_t const* src = rows + (bandY - beginY) * rowPitch;
+			for (uint32_t x = beginX; x < endX; )
+			{
+				uint32_t tileEndX = (x / tiling.Width + 1) * tiling.Width;
+				tileEndX = tileEndX < endX ? tileEndX : endX;
+
+				CopyRows(tile, tiling.Width, src + (x - beginX), rowPitch, tileEndX - x, bandEndY - bandY);
+				tile += tileSize - x % tiling.Width;
+				x = tileEndX;
+			}
+			bandY = bandEndY;
+		}
+	}
+
+	// Target of the single row y, from pixel x on, for layouts without vertical subsampling.
+	CpuKernels::RowTarget GetRowTarget(CpuYuvImage const& yuv, CpuYuvLayout layout, uint32_t y, uint32_t x)
+	{
+		uint32_t sampleSize = GetYuvSampleSize(layout);
+		uint32_t chromaX = HasHorizontalChromaSubsampling(layout) ? x / 2 : x;
+		return
+		{
+			GetRow(yuv.Y, yuv.YRowPitch, y, IsPackedYuvLayout(layout) ? x * GetPackedPixelSize(layout) : x * sampleSize),
+			GetRow(yuv.UV, yuv.UVRowPitch, y, chromaX * 2 * sampleSize),
+			GetRow(yuv.U, yuv.URowPitch, y, chromaX * sampleSize),
+			GetRow(yuv.V, yuv.VRowPitch, y, chromaX * sampleSize),
+			x,
+			y,
+		};
+	}
+
+	// Rows of the target that share chroma rows: a whole number of these never splits a chroma sample.
+	uint32_t GetRowGroupHeight(CpuYuvLayout layout)
+	{
+		return HasVerticalChromaSubsampling(layout) ? 2 : 1;
+	}
+
+	// ConvertRect for tiled NV12. Blocks of whole tile columns, up to two rows of luma tiles high, are
+	// converted into linear rows in scratch and then copied out tile by tile: every tile gets written front
+	// to back, and the kernels still read long runs of each source row. Stores straight from the kernels
+	// would scatter each row pair over all the tiles it crosses, a cache line or less per tile, which
+	// measured about half the speed of linear NV12.
+	void ConvertTiledRect(CpuKernels::RowKernels const& kernels, CpuRgbImage const& rgb, CpuYuvImage const& yuv,
+		uint32_t beginX, uint32_t endX, uint32_t beginY, uint32_t endY)
+	{
+		CpuYuvTiling const& tiling = yuv.Tiling;
+
+		// Staging rows are read back right away, so they're never streamed. Blocks are as wide as the
+		// scratch allows, in whole tiles unless a single tile column doesn't fit. Taller tiles are done 64
+		// rows at a time, which keeps blocks hundreds of pixels wide.
+		CpuKernels::RowPairFn rowPair = kernels.GetRowPair(CpuStoreMode::Cached);
+		uint32_t blockHeight = tiling.Height * 2 < 64 ? tiling.Height * 2 : 64;
+		blockHeight = endY - beginY < blockHeight ? endY - beginY : blockHeight;
+		uint32_t blockWidth = static_cast<uint32_t>(TileStagingSize / (blockHeight / 2 * 3));
+		blockWidth = blockWidth >= tiling.Width ? blockWidth / tiling.Width * tiling.Width : blockWidth / 2 * 2;
+
+		alignas(64) uint8_t staging[TileStagingSize];
+		uint8_t* lumaRows = staging;
+		uint8_t* chromaRows = staging + size_t(blockWidth) * blockHeight;
+
+		for (uint32_t blockY = beginY; blockY < endY; )
+		{
+			uint32_t blockEndY = (blockY / blockHeight + 1) * blockHeight;
+			blockEndY = blockEndY < endY ? blockEndY : endY;
+
+			for (uint32_t blockX = beginX; blockX < endX; )
+			{
+				uint32_t blockEndX = (blockX / blockWidth + 1) * blockWidth;
+				blockEndX = blockEndX < endX ? blockEndX : endX;
+				uint32_t srcWidth = (blockEndX < rgb.Width ? blockEndX : rgb.Width) - blockX;
+
+				for (uint32_t y = blockY; y < blockEndY; y += 2)
+				{
+					// The padding row for odd heights replicates the last source row.
+					uint32_t srcY1 = y + 1 < rgb.Height ? y + 1 : rgb.Height - 1;
+					uint8_t* luma = lumaRows + size_t(y - blockY) * blockWidth;
+					CpuKernels::RowPairTarget dst = { luma, luma + blockWidth, chromaRows + size_t(y - blockY) / 2 * blockWidth, nullptr, nullptr, nullptr, nullptr, blockX, y };
+					rowPair(rgb.Data + y * rgb.RowPitch + blockX * 4, rgb.Data + srcY1 * rgb.RowPitch + blockX * 4, srcWidth, dst, blockEndX - blockX);
+				}
+
+				CopyRowsToTiles(lumaRows, blockWidth, yuv.Y, yuv.YRowPitch, tiling, blockX, blockEndX, blockY, blockEndY);
+				CopyRowsToTiles(chromaRows, blockWidth, yuv.UV, yuv.UVRowPitch, tiling, blockX, blockEndX, blockY / 2, blockEndY / 2);
+				blockX = blockEndX;
+			}
+			blockY = blockEndY;
+		}
+	}
+
+	// Converts the target rectangle [beginX, endX) x [beginY, endY). beginX, endX and beginY are even, and
+	// so is endY unless it's the bottom of a target without vertical subsampling.
+	void ConvertRect(CpuKernels::RowKernels const& kernels, CpuStoreMode storeMode, CpuYuvLayout layout, CpuRgbImage const& rgb, CpuYuvImage const& yuv,
+		uint32_t beginX, uint32_t endX, uint32_t beginY, uint32_t endY)
+	{
+		if (IsTiledYuvLayout(layout))
+		{
+			ConvertTiledRect(kernels, rgb, yuv, beginX, endX, beginY, endY);
+			return;
+		}
+
+		// The kernels replicate the last source pixel they're given, which is only right at the image edge;
+		// interior rectangles are handed exactly as many source pixels as they produce.
+		uint32_t srcWidth = (endX < rgb.Width ? endX : rgb.Width) - beginX;
+
+		if (!HasVerticalChromaSubsampling(layout))
+		{
+			CpuKernels::RowFn row = kernels.GetRow(storeMode);
+			for (uint32_t y = beginY; y < endY; ++y)
+			{
+				row(rgb.Data + y * rgb.RowPitch + beginX * 4, srcWidth, GetRowTarget(yuv, layout, y, beginX), endX - beginX);
+			}
+			return;
+		}
+
+		// One pass over pairs of rows: both luma rows and the chroma row come from a single read of the source.
+		CpuKernels::RowPairFn rowPair = kernels.GetRowPair(storeMode);
+		for (uint32_t y = beginY; y < endY; y += 2)
+		{
+			// The padding row for odd heights replicates the last source row.
+			uint32_t srcY1 = y + 1 < rgb.Height ? y + 1 : rgb.Height - 1;
+			rowPair(
+				rgb.Data + y * rgb.RowPitch + beginX * 4,
+				rgb.Data + srcY1 * rgb.RowPitch + beginX * 4,
+				srcWidth,
+				GetRowPairTarget(yuv, layout, y, beginX),
+				endX - beginX);
+		}
+	}
+
+	uint32_t DivideRoundingUp(uint32_t n, uint32_t d)
+	{
+		return (n + d - 1) / d;
+	}
+
+	// In-place output waiting in scratch memory for the source under its target to be read.
+	struct DeferredWrite
+	{
+		size_t Offset;			// target, from the start of the buffer
+		size_t Size;
+		size_t ScratchOffset;
+	};
+
+	uint32_t GetTensorChromaWidth(CpuYuvTensor const& tensor)
+	{
+		return tensor.UpsampleChroma ? tensor.Width : (tensor.Width + 1) / 2;
+	}
+
+	uint32_t GetTensorChromaHeight(CpuYuvTensor const& tensor)
+	{
+		return tensor.UpsampleChroma ? tensor.Height : (tensor.Height + 1) / 2;
+	}
+
+	void ValidateTensor(CpuYuvTensor const& tensor)
+	{
+		if (!tensor.Data || tensor.BatchSize == 0 || tensor.Width == 0 || tensor.Height == 0)
+			throw std::invalid_argument("Invalid tensor.");
+
+		for (int c = 0; c < 3; ++c)
+		{
+			if (!std::isfinite(tensor.Mean[c]))
+				throw std::invalid_argument("Tensor means must be finite numbers.");
+			if (!std::isfinite(tensor.Std[c]) || tensor.Std[c] == 0)
+				throw std::invalid_argument("Tensor stds must be finite and non-zero.");
+		}
+	}
+
+	// IEEE binary16 bits of value, rounded to nearest even. Values too large for half precision become
+	// infinity, and tiny ones subnormals or zero.
+	uint16_t ToHalf(double value)
+	{
+		uint16_t sign = std::signbit(value) ? 0x8000 : 0;
+		double magnitude = std::fabs(value);
+		if (std::isnan(value))
+			return 0x7E00;
+		if (magnitude == 0)
+			return sign;
+
+		// Halfway between the largest half, 65504, and the next power of two: rounds up to infinity.
+		if (magnitude >= 65520.0)
+			return static_cast<uint16_t>(sign | 0x7C00);
+
+		// The exponent of a normal half, or -14 for a subnormal one, whose significand then lacks the
+		// leading 1. A rounding carry out of the 10 fraction bits moves into the exponent, as it should.
+		int exponent;
+		std::frexp(magnitude, &exponent);
+		exponent = exponent - 1 < -14 ? -14 : exponent - 1;
+		uint32_t significand = static_cast<uint32_t>(std::nearbyint(std::ldexp(magnitude, 10 - exponent)));
+		return static_cast<uint16_t>(sign | (((exponent + 15) << 10) + significand - 1024));
+	}
+
+	template<typename Element>
+	Element ToTensorElement(double value);
+
+	template<>
+	float ToTensorElement<float>(double value)
+	{
+		return static_cast<float>(value);
+	}
+
+	template<>
+	uint16_t ToTensorElement<uint16_t>(double value)
+	{
+		return ToHalf(value);
+	}
+
+	// The tensor element of each code of each channel, rounded once from double precision, and the kernels
+	// of the level that expand codes through them. Writing the tensor is then a lookup per element, so
+	// every level writes the same bits.
+	template<typename Element>
+	struct TensorTables
+	{
+		Element Channels[3][256 + CpuKernels::TensorTablePadding / sizeof(Element)] = {};
+		CpuKernels::TensorRowFn Row;
+		CpuKernels::TensorRowFn Doubled;
+
+		TensorTables(CpuKernels::TensorKernels const& kernels, CpuYuvTensor const& tensor)
+			: Row(std::is_same<Element, float>::value ? kernels.Float32 : kernels.Float16)
+			, Doubled(std::is_same<Element, float>::value ? kernels.Float32Doubled : kernels.Float16Doubled)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				for (int code = 0; code < 256; ++code)
+				{
+					Channels[c][code] = ToTensorElement<Element>((code / 255.0 - tensor.Mean[c]) / tensor.Std[c]);
+				}
+			}
+		}
+	};
+
+	// The planes of one image of a tensor.
+	template<typename Element>
+	struct TensorImage
+	{
+		Element* Y;
+		Element* U;
+		Element* V;
+	};
+
+	template<typename Element>
+	TensorImage<Element> GetTensorImage(CpuYuvTensor const& tensor, uint32_t index)
+	{
+		Element* y = reinterpret_cast<Element*>(static_cast<uint8_t*>(tensor.Data) + GetYuvTensorImageSize(tensor) * index);
+		size_t lumaSize = size_t(tensor.Width) * tensor.Height;
+		size_t chromaSize = size_t(GetTensorChromaWidth(tensor)) * GetTensorChromaHeight(tensor);
+		return { y, y + lumaSize, y + lumaSize + chromaSize };
+	}
+
+	// Writes tensor rows y and y + 1 of one image, and their chroma, from I420 rows: luma0 and luma1 and the
+	// chroma rows u and v, all starting at pixel x, which is even. count pixels, up to the image's right
+	// edge; the row below the image of an odd height is left out.
+	template<typename Element>
+	void WriteTensorRowPair(TensorTables<Element> const& tables, CpuYuvTensor const& tensor, TensorImage<Element> const& image,
+		uint8_t const* luma0, uint8_t const* luma1, uint8_t const* u, uint8_t const* v, uint32_t x, uint32_t y, uint32_t count)
+	{
+		uint8_t const* luma[2] = { luma0, luma1 };
+		uint32_t rowCount = y + 1 < tensor.Height ? 2 : 1;
+		for (uint32_t row = 0; row < rowCount; ++row)
+		{
+			tables.Row(luma[row], tables.Channels[0], image.Y + size_t(y + row) * tensor.Width + x, count);
+		}
+
+		uint8_t const* chroma[2] = { u, v };
+		Element* planes[2] = { image.U, image.V };
+		for (int c = 0; c < 2; ++c)
+		{
+			Element const* table = tables.Channels[c + 1];
+			if (tensor.UpsampleChroma)
+			{
+				// Both rows of the block are the same.
+				Element* dst = planes[c] + size_t(y) * tensor.Width + x;
+				tables.Doubled(chroma[c], table, dst, count);
+				if (rowCount == 2)
+					std::memcpy(dst + tensor.Width, dst, count * sizeof(Element));
+			}
+			else
+			{
+				tables.Row(chroma[c], table, planes[c] + size_t(y / 2) * GetTensorChromaWidth(tensor) + x / 2, (count + 1) / 2);
+			}
+		}
+	}
+
+	// ConvertRgbToTensor for one element type. Work items are bands of bandHeight rows (even) of one image.
+	// Each row pair goes through scratch as I420, up to TileStagingSize / 3 pixels at a time: two luma rows
+	// and two chroma rows of half their width.
+	template<typename Element>
+	void ConvertToTensor(CpuThreadPool& threadPool, uint32_t bandHeight, CpuKernels::RowPairFn rowPair, CpuKernels::TensorKernels const& kernels,
+		CpuRgbImage const* images, CpuYuvTensor const& tensor)
+	{
+		TensorTables<Element> tables(kernels, tensor);
+		uint32_t bandCount = DivideRoundingUp(tensor.Height, bandHeight);
+		uint32_t chunkWidth = static_cast<uint32_t>(TileStagingSize / 3) / 2 * 2;
+
+		threadPool.RunStealing(tensor.BatchSize * bandCount, [&](uint32_t item)
+		{
+			CpuRgbImage const& rgb = images[item / bandCount];
+			TensorImage<Element> image = GetTensorImage<Element>(tensor, item / bandCount);
+			uint32_t beginY = item % bandCount * bandHeight;
+			uint32_t endY = tensor.Height - beginY > bandHeight ? beginY + bandHeight : tensor.Height;
+
+			// Staging rows are read back right away, so they're never streamed.
+			alignas(64) uint8_t staging[TileStagingSize];
+			for (uint32_t y = beginY; y < endY; y += 2)
+			{
+				// The padding row for odd heights replicates the last source row.
+				uint32_t srcY1 = y + 1 < rgb.Height ? y + 1 : rgb.Height - 1;
+				for (uint32_t x = 0; x < rgb.Width; x += chunkWidth)
+				{
+					// Chunks end at the image edge, where the kernels replicate the last pixel to an even width.
+					uint32_t count = rgb.Width - x < chunkWidth ? rgb.Width - x : chunkWidth;
+					uint32_t paddedCount = RoundUpToEven(count);
+					uint8_t* luma = staging;
+					uint8_t* chroma = staging + size_t(paddedCount) * 2;
+					CpuKernels::RowPairTarget dst = { luma, luma + paddedCount, nullptr, chroma, chroma + paddedCount / 2, nullptr, nullptr, x, y };
+					rowPair(rgb.Data + y * rgb.RowPitch + x * 4, rgb.Data + srcY1 * rgb.RowPitch + x * 4, count, dst, paddedCount);
+					WriteTensorRowPair(tables, tensor, image, dst.Y0, dst.Y1, dst.U, dst.V, x, y, count);
+				}
+			}
+		});
+	}
+
+	// CopyToTensor for one element type, in bands of row pairs.
+	template<typename Element>
+	void CopyImageToTensor(CpuThreadPool& threadPool, CpuKernels::TensorKernels const& kernels, CpuYuvImage const& i420, CpuYuvTensor const& tensor,
+		uint32_t index)
+	{
+		TensorTables<Element> tables(kernels, tensor);
+		TensorImage<Element> image = GetTensorImage<Element>(tensor, index);
+		uint32_t pairCount = i420.Height / 2;
+		uint32_t bandCount = threadPool.GetThreadCount() < pairCount ? threadPool.GetThreadCount() : pairCount;
+
+		threadPool.Run(bandCount, [&](uint32_t band)
+		{
+			uint32_t beginPair = static_cast<uint32_t>(uint64_t(pairCount) * band / bandCount);
+			uint32_t endPair = static_cast<uint32_t>(uint64_t(pairCount) * (band + 1) / bandCount);
+			for (uint32_t pair = beginPair; pair < endPair; ++pair)
+			{
+				uint8_t const* luma = i420.Y + size_t(pair) * 2 * i420.YRowPitch;
+				WriteTensorRowPair(tables, tensor, image, luma, luma + i420.YRowPitch, i420.U + pair * i420.URowPitch,
+					i420.V + pair * i420.VRowPitch, 0, pair * 2, tensor.Width);
+			}
+		});
+	}
+}
+
+CpuConverter::CpuConverter(uint32_t threadCount)
+	: CpuConverter(SelectCpuKernels(), threadCount)
+{
+}
+
+CpuConverter::CpuConverter(CpuKernels::KernelTable const& kernels, uint32_t threadCount)
+	: m_kernels(&kernels)
+	, m_entry(nullptr)
+	, m_threadPool(new CpuThreadPool(threadCount))
+	, m_scheduling(CpuScheduling::WorkStealing)
+	, m_tileWidth(DefaultTileWidth)
+	, m_tileHeight(DefaultTileHeight)
+	, m_storeMode(CpuStoreMode::Cached)
+{
+	SetFormat(CpuConversionFormat());
+}
+
+void CpuConverter::SetFormat(CpuConversionFormat const& format)
+{
+	// Tiled layouts run the kernels of their linear layout.
+	CpuConversionFormat kernelFormat = format;
+	kernelFormat.Output = GetLinearYuvLayout(format.Output);
+
+	CpuKernels::KernelEntry const* entry = m_kernels->Find(kernelFormat);
+	if (!entry)
+		throw std::invalid_argument(std::string("No ") + m_kernels->Name + " kernels for this conversion format.");
+
+	m_entry = entry;
+	m_format = format;
+}
+
+void CpuConverter::SetScheduling(CpuScheduling scheduling, uint32_t tileWidth, uint32_t tileHeight)
+{
+	if (tileWidth == 0 || tileHeight == 0 || tileWidth % 2 != 0 || tileHeight % 2 != 0)
+		throw std::invalid_argument("Tile sizes must be even and non-zero.");
+
+	m_scheduling = scheduling;
+	m_tileWidth = tileWidth;
+	m_tileHeight = tileHeight;
+}
+
+void CpuConverter::ConvertTiles(CpuKernels::RowKernels const& kernels, CpuRgbImage const& rgb, CpuYuvImage const& yuv) const
+{
+	// Even tile sizes keep every tile on whole chroma samples, so tiles never share an output byte.
+	// Tiles are numbered row-major, so each thread's initial share is a run of neighbouring tiles.
+	uint32_t tilesX = DivideRoundingUp(yuv.Width, m_tileWidth);
+	uint32_t tilesY = DivideRoundingUp(yuv.Height, m_tileHeight);
+
+	m_threadPool->RunStealing(tilesX * tilesY, [&](uint32_t tile)
+	{
+		uint32_t beginX = (tile % tilesX) * m_tileWidth;
+		uint32_t beginY = (tile / tilesX) * m_tileHeight;
+		uint32_t endX = yuv.Width - beginX > m_tileWidth ? beginX + m_tileWidth : yuv.Width;
+		uint32_t endY = yuv.Height - beginY > m_tileHeight ? beginY + m_tileHeight : yuv.Height;
+		ConvertRect(kernels, m_storeMode, m_format.Output, rgb, yuv, beginX, endX, beginY, endY);
+	});
+}
+
+size_t GetCompatibleYuvSize(uint32_t width, uint32_t height, CpuYuvLayout layout, CpuYuvTiling const& tiling)
+{
+	ValidateTiling(layout, tiling);
+
+	width = RoundUpToEven(width);
+	return GetYuvImageSize(layout, GetYuvHeight(layout, height), GetTiledPitch(layout, GetLumaRowSize(layout, width), tiling),
+		GetTiledPitch(layout, GetChromaRowSize(layout, width), tiling), tiling);
+}
+
+CpuYuvBuffer CreateCompatibleYuvBuffer(CpuRgbImage const& rgb, CpuYuvLayout layout, CpuYuvTiling const& tiling)
+{
+	ValidateTiling(layout, tiling);
+
+	CpuYuvBuffer result;
+
+	uint32_t width = RoundUpToEven(rgb.Width);
+	uint32_t height = GetYuvHeight(layout, rgb.Height);
+	size_t lumaPitch = GetTiledPitch(layout, GetLumaRowSize(layout, width), tiling);
+	size_t chromaPitch = GetTiledPitch(layout, GetChromaRowSize(layout, width), tiling);
+
+	result.Storage.resize(GetYuvImageSize(layout, height, lumaPitch, chromaPitch, tiling));
+
+	result.Image.Width = width;
+	result.Image.Height = height;
+	PlaceYuvPlanes(result.Storage.data(), layout, lumaPitch, chromaPitch, tiling, &result.Image);
+
+	return result;
+}
+
+CpuRgbPlane CreateRgbPlane(uint32_t width, uint32_t height, CpuPageMode pageMode)
+{
+	CpuRgbPlane result;
+
+	size_t rowPitch = GetAlignedRowPitch(size_t(width) * 4);
+	result.Memory = CpuPlaneMemory(rowPitch * height, pageMode);
+
+	result.Image.Data = result.Memory.Data();
+	result.Image.Width = width;
+	result.Image.Height = height;
+	result.Image.RowPitch = rowPitch;
+
+	return result;
+}
+
+size_t GetYuvTensorImageSize(CpuYuvTensor const& tensor)
+{
+	size_t lumaSize = size_t(tensor.Width) * tensor.Height;
+	size_t chromaSize = size_t(GetTensorChromaWidth(tensor)) * GetTensorChromaHeight(tensor);
+	return (lumaSize + chromaSize * 2) * (tensor.Type == CpuTensorType::Float16 ? 2 : 4);
+}
+
+size_t GetYuvTensorSize(CpuYuvTensor const& tensor)
+{
+	return GetYuvTensorImageSize(tensor) * tensor.BatchSize;
+}
+
+CpuYuvPlanes CreateCompatibleYuvPlanes(CpuRgbImage const& rgb, CpuPageMode pageMode, CpuYuvLayout layout, CpuYuvTiling const& tiling)
+{
+	ValidateTiling(layout, tiling);
+
+	CpuYuvPlanes result;
+
+	uint32_t width = RoundUpToEven(rgb.Width);
+	uint32_t height = GetYuvHeight(layout, rgb.Height);
+	size_t lumaPitch = GetTiledPitch(layout, GetAlignedRowPitch(GetLumaRowSize(layout, width)), tiling);
+	size_t chromaPitch = GetTiledPitch(layout, GetAlignedRowPitch(GetChromaRowSize(layout, width)), tiling);
+
+	result.Memory = CpuPlaneMemory(GetYuvImageSize(layout, height, lumaPitch, chromaPitch, tiling), pageMode);
+
+	result.Image.Width = width;
+	result.Image.Height = height;
+	PlaceYuvPlanes(result.Memory.Data(), layout, lumaPitch, chromaPitch, tiling, &result.Image);
+
+	return result;
+}
+
+CpuYuvFootprint GetCompatibleYuvFootprint(uint32_t width, uint32_t height, CpuYuvLayout layout, uint32_t pitchAlignment, uint32_t placementAlignment)
+{
+	if (IsTiledYuvLayout(layout))
+		throw std::invalid_argument("Tiled layouts have no footprint.");
+	if (width == 0 || height == 0 || pitchAlignment == 0 || placementAlignment == 0)
+		throw std::invalid_argument("Footprint sizes and alignments must be non-zero.");
+
+	CpuYuvFootprint result;
+	result.Layout = layout;
+	result.Width = RoundUpToEven(width);
+	result.Height = GetYuvHeight(layout, height);
+
+	FootprintPlane planes[4] = {};
+	uint32_t planeCount = GetFootprintPlanes(layout, result.Width, result.Height, planes);
+
+	// Each plane starts after the padded rows of the one before, like subresources in GetCopyableFootprints.
+	uint64_t offset = 0;
+	for (uint32_t i = 0; i < planeCount; ++i)
+	{
+		CpuYuvPlaneFootprint& plane = result.*planes[i].Plane;
+		plane.Offset = RoundUp(offset, placementAlignment);
+		plane.RowPitch = static_cast<uint32_t>(RoundUp(planes[i].RowSize, pitchAlignment));
+
+		result.TotalSize = GetFootprintPlaneEnd(plane, planes[i]);
+		offset = plane.Offset + uint64_t(plane.RowPitch) * planes[i].RowCount;
+	}
+
+	return result;
+}
+
+CpuYuvImage PlaceYuvFootprint(uint8_t* data, CpuYuvFootprint const& footprint)
+{
+	CpuYuvLayout layout = footprint.Layout;
+	if (IsTiledYuvLayout(layout))
+		throw std::invalid_argument("Tiled layouts have no footprint.");
+	if (!data || footprint.Width == 0 || footprint.Height == 0)
+		throw std::invalid_argument("Invalid footprint.");
+
+	FootprintPlane planes[4] = {};
+	uint32_t planeCount = GetFootprintPlanes(layout, footprint.Width, footprint.Height, planes);
+
+	for (uint32_t i = 0; i < planeCount; ++i)
+	{
+		CpuYuvPlaneFootprint const& plane = footprint.*planes[i].Plane;
+		if (plane.RowPitch < planes[i].RowSize || GetFootprintPlaneEnd(plane, planes[i]) > footprint.TotalSize)
+			throw std::invalid_argument("A plane doesn't fit in the footprint.");
+
+		for (uint32_t j = 0; j < i; ++j)
+		{
+			CpuYuvPlaneFootprint const& other = footprint.*planes[j].Plane;
+			if (plane.Offset < GetFootprintPlaneEnd(other, planes[j]) && other.Offset < GetFootprintPlaneEnd(plane, planes[i]))
+				throw std::invalid_argument("The planes of a footprint must not overlap.");
+		}
+	}
+
+	auto getPlane = [&](CpuYuvPlaneFootprint CpuYuvFootprint::* member, size_t* rowPitch) -> uint8_t*
+	{
+		for (uint32_t i = 0; i < planeCount; ++i)
+		{
+			if (planes[i].Plane == member)
+			{
+				*rowPitch = (footprint.*member).RowPitch;
+				return data + (footprint.*member).Offset;
+			}
+		}
+		*rowPitch = 0;
+		return nullptr;
+	};
+
+	CpuYuvImage result;
+	result.Y = getPlane(&CpuYuvFootprint::Y, &result.YRowPitch);
+	result.UV = getPlane(&CpuYuvFootprint::UV, &result.UVRowPitch);
+	result.U = getPlane(&CpuYuvFootprint::U, &result.URowPitch);
+	result.V = getPlane(&CpuYuvFootprint::V, &result.VRowPitch);
+	result.A = getPlane(&CpuYuvFootprint::A, &result.ARowPitch);
+	result.Width = footprint.Width;
+	result.Height = footprint.Height;
+	return result;
+}
+
+void CpuConverter::ConvertRgbToYuv(CpuRgbImage const& rgb, CpuYuvImage const& yuv, CpuAccuracy accuracy) const
+{
+	ValidateImages(rgb, yuv, m_format.Output);
+
+	CpuKernels::RowKernels const& kernels = m_entry->Get(accuracy);
+
+	if (m_scheduling == CpuScheduling::WorkStealing)
+	{
+		ConvertTiles(kernels, rgb, yuv);
+		return;
+	}
+
+	// Bands are whole row groups so no two threads share a chroma row.
+	uint32_t groupHeight = GetRowGroupHeight(m_format.Output);
+	uint32_t groupCount = yuv.Height / groupHeight;
+	uint32_t bandCount = m_threadPool->GetThreadCount() < groupCount ? m_threadPool->GetThreadCount() : groupCount;
+
+	m_threadPool->Run(bandCount, [&](uint32_t band)
+	{
+		uint32_t beginGroup = static_cast<uint32_t>(uint64_t(groupCount) * band / bandCount);
+		uint32_t endGroup = static_cast<uint32_t>(uint64_t(groupCount) * (band + 1) / bandCount);
+		ConvertRect(kernels, m_storeMode, m_format.Output, rgb, yuv, 0, yuv.Width, beginGroup * groupHeight, endGroup * groupHeight);
+	});
+}
+
+void CpuConverter::ConvertYuvToRgb(CpuYuvImage const& yuv, CpuRgbTarget const& rgb) const
+{
+	CpuYuvLayout layout = m_format.Output;
+	if (!IsReversibleYuvLayout(layout))
+		throw std::invalid_argument("This layout has no inverse conversion.");
+
+	ValidateImages(CpuRgbImage{ rgb.Data, rgb.Width, rgb.Height, rgb.RowPitch }, yuv, layout);
+
+	// Every tier has the same inverse.
+	CpuKernels::InverseRowFn inverseRow = m_entry->BitExact.InverseRow;
+	uint32_t chromaShift = HasVerticalChromaSubsampling(layout) ? 1 : 0;
+	uint32_t bandCount = m_threadPool->GetThreadCount() < rgb.Height ? m_threadPool->GetThreadCount() : rgb.Height;
+
+	m_threadPool->Run(bandCount, [&](uint32_t band)
+	{
+		uint32_t beginRow = static_cast<uint32_t>(uint64_t(rgb.Height) * band / bandCount);
+		uint32_t endRow = static_cast<uint32_t>(uint64_t(rgb.Height) * (band + 1) / bandCount);
+		for (uint32_t y = beginRow; y < endRow; ++y)
+		{
+			uint32_t chromaY = y >> chromaShift;
+			CpuKernels::InverseRowSource src = { yuv.Y + y * yuv.YRowPitch, yuv.U + chromaY * yuv.URowPitch, yuv.V + chromaY * yuv.VRowPitch };
+			inverseRow(src, rgb.Data + y * rgb.RowPitch, rgb.Width);
+		}
+	});
+}
+
+void CpuConverter::CopyToTiles(CpuYuvImage const& nv12, CpuYuvImage const& tiled) const
+{
+	CpuYuvTiling const& tiling = tiled.Tiling;
+	ValidateTiling(CpuYuvLayout::Nv12Tiled, tiling);
+	if (nv12.Width != tiled.Width || nv12.Height != tiled.Height || nv12.Width % 2 != 0 || nv12.Height % 2 != 0)
+		throw std::invalid_argument("The NV12 and tiled images must be the same even size.");
+	if (!nv12.Y || !nv12.UV || nv12.YRowPitch < nv12.Width || nv12.UVRowPitch < nv12.Width ||
+		!tiled.Y || !tiled.UV || tiled.YRowPitch < nv12.Width || tiled.UVRowPitch < nv12.Width ||
+		tiled.YRowPitch % tiling.Width != 0 || tiled.UVRowPitch % tiling.Width != 0)
+		throw std::invalid_argument("Invalid NV12 or tiled image.");
+
+	// Bands of whole rows of chroma tiles, and the two rows of luma tiles over each.
+	uint32_t chromaHeight = tiled.Height / 2;
+	uint32_t tileRowCount = DivideRoundingUp(chromaHeight, tiling.Height);
+	uint32_t bandCount = m_threadPool->GetThreadCount() < tileRowCount ? m_threadPool->GetThreadCount() : tileRowCount;
+
+	m_threadPool->Run(bandCount, [&](uint32_t band)
+	{
+		uint32_t beginRow = static_cast<uint32_t>(uint64_t(tileRowCount) * band / bandCount) * tiling.Height;
+		uint32_t endRow = static_cast<uint32_t>(uint64_t(tileRowCount) * (band + 1) / bandCount) * tiling.Height;
+		endRow = endRow < chromaHeight ? endRow : chromaHeight;
+
+		CopyRowsToTiles(nv12.Y + size_t(beginRow) * 2 * nv12.YRowPitch, nv12.YRowPitch, tiled.Y, tiled.YRowPitch, tiling, 0, tiled.Width, beginRow * 2, endRow * 2);
+		CopyRowsToTiles(nv12.UV + size_t(beginRow) * nv12.UVRowPitch, nv12.UVRowPitch, tiled.UV, tiled.UVRowPitch, tiling, 0, tiled.Width, beginRow, endRow);
+	});
+}
+
+void CpuConverter::CopyToTensor(CpuYuvImage const& i420, CpuYuvTensor const& tensor, uint32_t index) const
+{
+	ValidateTensor(tensor);
+	if (index >= tensor.BatchSize)
+		throw std::invalid_argument("Image index outside the batch.");
+	if (i420.Width != RoundUpToEven(tensor.Width) || i420.Height != RoundUpToEven(tensor.Height) || !i420.Y || !i420.U || !i420.V ||
+		i420.YRowPitch < i420.Width || i420.URowPitch < i420.Width / 2 || i420.VRowPitch < i420.Width / 2)
+		throw std::invalid_argument("The I420 image doesn't match the tensor.");
+
+	if (tensor.Type == CpuTensorType::Float16)
+		CopyImageToTensor<uint16_t>(*m_threadPool, m_kernels->Tensor, i420, tensor, index);
+	else
+		CopyImageToTensor<float>(*m_threadPool, m_kernels->Tensor, i420, tensor, index);
+}
+
+void CpuConverter::ConvertRgbToTensor(CpuRgbImage const* images, CpuYuvTensor const& tensor, CpuAccuracy accuracy) const
+{
+	ValidateTensor(tensor);
+	for (uint32_t i = 0; i < tensor.BatchSize; ++i)
+	{
+		CpuRgbImage const& rgb = images[i];
+		if (!rgb.Data || rgb.RowPitch < rgb.Width * 4ull)
+			throw std::invalid_argument("Invalid source image.");
+		if (rgb.Width != tensor.Width || rgb.Height != tensor.Height)
+			throw std::invalid_argument("Every image must be the size of the tensor.");
+	}
+
+	CpuConversionFormat format = m_format;
+	format.Output = CpuYuvLayout::I420;
+	CpuKernels::KernelEntry const* entry = m_kernels->Find(format);
+	if (!entry)
+		throw std::invalid_argument(std::string("No ") + m_kernels->Name + " I420 kernels for this conversion format.");
+
+	CpuKernels::RowPairFn rowPair = entry->Get(accuracy).GetRowPair(CpuStoreMode::Cached);
+	if (tensor.Type == CpuTensorType::Float16)
+		ConvertToTensor<uint16_t>(*m_threadPool, m_tileHeight, rowPair, m_kernels->Tensor, images, tensor);
+	else
+		ConvertToTensor<float>(*m_threadPool, m_tileHeight, rowPair, m_kernels->Tensor, images, tensor);
+}
+
+CpuYuvImage CpuConverter::ConvertRgbToYuvInPlace(uint8_t* buffer, size_t bufferSize, CpuRgbImage const& rgb, CpuAccuracy accuracy) const
+{
+	CpuYuvLayout layout = m_format.Output;
+	bool planar = IsPlanarYuvLayout(layout);
+
+	// Tiles span several rows, so their output can't follow the rows read.
+	if (IsTiledYuvLayout(layout))
+		throw std::invalid_argument("Tiled layouts can't be converted in place.");
+
+	CpuYuvImage yuv;
+	yuv.Width = RoundUpToEven(rgb.Width);
+	yuv.Height = GetYuvHeight(layout, rgb.Height);
+
+	size_t width = GetLumaRowSize(layout, yuv.Width);
+	size_t chromaWidth = GetChromaRowSize(layout, yuv.Width);
+	PlaceYuvPlanes(buffer, layout, width, chromaWidth, CpuYuvTiling(), &yuv);
+
+	ValidateImages(rgb, yuv, layout);
+
+	// Everything is tracked as byte offsets from the start of the buffer. Chroma is one interleaved plane,
+	// the U and V planes, or nothing for packed layouts and I400.
+	size_t chromaBegins[2] =
+	{
+		planar ? static_cast<size_t>(yuv.U - buffer) : yuv.UV ? static_cast<size_t>(yuv.UV - buffer) : 0,
+		planar ? static_cast<size_t>(yuv.V - buffer) : 0,
+	};
+	int chromaPlaneCount = planar ? 2 : yuv.UV ? 1 : 0;
+	bool alpha = HasAlphaPlane(layout);
+	size_t alphaBegin = alpha ? static_cast<size_t>(yuv.A - buffer) : 0;
+	size_t sourceBegin = static_cast<size_t>(rgb.Data - buffer);
+	size_t sourceEnd = sourceBegin + (rgb.Height - 1) * rgb.RowPitch + rgb.Width * 4ull;
+
+	if (rgb.Data < buffer || sourceEnd > bufferSize)
+		throw std::invalid_argument("The source image must lie inside the buffer.");
+	if (GetYuvImageSize(layout, yuv.Height, width, chromaWidth, CpuYuvTiling()) > bufferSize)
+		throw std::invalid_argument("The YUV image doesn't fit in the source buffer.");
+
+	// A target range can be written once every source row it overlaps has been read, i.e. it ends before
+	// readEnd, or if it lies past the source altogether.
+	auto isFree = [sourceEnd](size_t offset, size_t size, size_t readEnd)
+	{
+		return offset + size <= readEnd || offset >= sourceEnd;
+	};
+
+	CpuKernels::RowKernels const& kernels = m_entry->Get(accuracy);
+
+	// Row groups (pairs, or single rows without vertical subsampling) of a batch run in parallel, batches
+	// in order. Two groups per thread, and enough of them that a batch is more than a handful of rows.
+	uint32_t groupHeight = GetRowGroupHeight(layout);
+	uint32_t groupCount = yuv.Height / groupHeight;
+	uint32_t batchSize = m_threadPool->GetThreadCount() * 2 > 8 ? m_threadPool->GetThreadCount() * 2 : 8;
+
+	// Each group gets scratch space for its luma rows and chroma row, [Y0 | Y1 | chroma | A0 | A1] for row
+	// pairs, used by whichever target isn't free yet. Chroma is UV, or U and V at half the width; alpha rows
+	// are as wide as luma rows, and go with the chroma.
+	size_t lumaSize = groupHeight * width;
+	size_t alphaScratchOffset = lumaSize + chromaPlaneCount * chromaWidth;
+	size_t groupScratchSize = alphaScratchOffset + (alpha ? lumaSize : 0);
+	std::vector<uint8_t> scratch(size_t(batchSize) * groupScratchSize);
+	std::vector<uint8_t> deferred;
+	std::vector<DeferredWrite> deferredWrites;
+
+	auto write = [&](size_t offset, uint8_t const* data, size_t size, size_t readEnd)
+	{
+		if (isFree(offset, size, readEnd))
+		{
+			std::memcpy(buffer + offset, data, size);
+			return;
+		}
+
+		deferredWrites.push_back({ offset, size, deferred.size() });
+		deferred.insert(deferred.end(), data, data + size);
+	};
+
+	for (uint32_t firstGroup = 0; firstGroup < groupCount; firstGroup += batchSize)
+	{
+		uint32_t batchGroups = groupCount - firstGroup < batchSize ? groupCount - firstGroup : batchSize;
+
+		// Earlier batches have read everything before this batch's first source row.
+		size_t batchReadBegin = sourceBegin + size_t(firstGroup) * groupHeight * rgb.RowPitch;
+		auto isLumaDirect = [&](uint32_t group)
+		{
+			return isFree(group * lumaSize, lumaSize, batchReadBegin);
+		};
+		auto isChromaDirect = [&](uint32_t group)
+		{
+			bool free = true;
+			for (int plane = 0; plane < chromaPlaneCount; ++plane)
+			{
+				free = free && isFree(chromaBegins[plane] + group * chromaWidth, chromaWidth, batchReadBegin);
+			}
+			return free && (!alpha || isFree(alphaBegin + group * lumaSize, lumaSize, batchReadBegin));
+		};
+
+		m_threadPool->Run(batchGroups, [&](uint32_t i)
+		{
+			uint32_t group = firstGroup + i;
+			uint32_t y = group * groupHeight;
+
+			uint8_t* rows = scratch.data() + size_t(i) * groupScratchSize;
+			bool lumaDirect = isLumaDirect(group);
+			bool chromaDirect = isChromaDirect(group);
+
+			// Scratch rows are read back right away, so only direct targets get the chosen store mode.
+			CpuStoreMode storeMode = lumaDirect && chromaDirect ? m_storeMode : CpuStoreMode::Cached;
+
+			if (groupHeight == 1)
+			{
+				CpuKernels::RowTarget dst = GetRowTarget(yuv, layout, y, 0);
+				if (!lumaDirect)
+					dst.Y = rows;
+				if (!chromaDirect)
+				{
+					dst.UV = planar ? nullptr : rows + lumaSize;
+					dst.U = planar ? rows + lumaSize : nullptr;
+					dst.V = planar ? rows + lumaSize + chromaWidth : nullptr;
+				}
+
+				kernels.GetRow(storeMode)(rgb.Data + y * rgb.RowPitch, rgb.Width, dst, yuv.Width);
+				return;
+			}
+
+			// The padding row for odd heights replicates the last source row.
+			uint32_t srcY1 = y + 1 < rgb.Height ? y + 1 : rgb.Height - 1;
+			uint8_t const* src0 = rgb.Data + y * rgb.RowPitch;
+			uint8_t const* src1 = rgb.Data + srcY1 * rgb.RowPitch;
+
+			CpuKernels::RowPairTarget dst = GetRowPairTarget(yuv, layout, y, 0);
+			if (!lumaDirect)
+			{
+				dst.Y0 = rows;
+				dst.Y1 = rows + width;
+			}
+			if (!chromaDirect)
+			{
+				dst.UV = planar ? nullptr : rows + lumaSize;
+				dst.U = planar ? rows + lumaSize : nullptr;
+				dst.V = planar ? rows + lumaSize + chromaWidth : nullptr;
+				dst.A0 = alpha ? rows + alphaScratchOffset : nullptr;
+				dst.A1 = alpha ? rows + alphaScratchOffset + width : nullptr;
+			}
+
+			kernels.GetRowPair(storeMode)(src0, src1, rgb.Width, dst, yuv.Width);
+		});
+
+		// Once the last batch is done, the whole buffer is free.
+		uint32_t batchEndRow = (firstGroup + batchGroups) * groupHeight;
+		uint32_t rowsRead = batchEndRow < rgb.Height ? batchEndRow : rgb.Height;
+		size_t readEnd = firstGroup + batchGroups == groupCount ? bufferSize : sourceBegin + size_t(rowsRead) * rgb.RowPitch;
+
+		for (uint32_t i = 0; i < batchGroups; ++i)
+		{
+			uint32_t group = firstGroup + i;
+			uint8_t const* rows = scratch.data() + size_t(i) * groupScratchSize;
+			if (!isLumaDirect(group))
+				write(group * lumaSize, rows, lumaSize, readEnd);
+			if (!isChromaDirect(group))
+			{
+				for (int plane = 0; plane < chromaPlaneCount; ++plane)
+				{
+					write(chromaBegins[plane] + group * chromaWidth, rows + lumaSize + plane * chromaWidth, chromaWidth, readEnd);
+				}
+				if (alpha)
+					write(alphaBegin + group * lumaSize, rows + alphaScratchOffset, lumaSize, readEnd);
+			}
+		}
+
+		// Older output whose target has been read by now. Targets never overlap each other, so the order
+		// doesn't matter.
+		size_t kept = 0;
+		for (DeferredWrite const& pending : deferredWrites)
+		{
+			if (isFree(pending.Offset, pending.Size, readEnd))
+				std::memcpy(buffer + pending.Offset, deferred.data() + pending.ScratchOffset, pending.Size);
+			else
+				deferredWrites[kept++] = pending;
+		}
+		deferredWrites.resize(kept);
+		if (deferredWrites.empty())
+			deferred.clear();
+	}
+
+	return yuv;
+}
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "CpuFeatures.h"
+#include "CpuMemory.h"
+#include "CpuThreadPool.h"
+
+// CPU counterpart of the D3D12 path in Rgb2Yuv.cpp, for hosts without a GPU.
+// Produces the same NV12 output as RgbToYuvCS.hlsl: BT.601 coefficients, 2x2 box-averaged chroma, and a
+// target rounded up to even dimensions like CreateCompatibleYuvResource.
+
+// Source image; the pixel layout is CpuConversionFormat::Input. Not owned.
+struct CpuRgbImage
+{
+	uint8_t const* Data;
+	uint32_t Width;
+	uint32_t Height;
+	size_t RowPitch;
+};
+
+// Target of an inverse conversion, in the pixel layout of CpuConversionFormat::Input. Not owned.
+struct CpuRgbTarget
+{
+	uint8_t* Data;
+	uint32_t Width;
+	uint32_t Height;
+	size_t RowPitch;
+};
+
+// Tile size of a tiled target, in bytes and rows of a plane; both even. A plane is a grid of tiles, row
+// of tiles after row of tiles, and within a row of tiles one tile after the other, each Width * Height
+// bytes of whole tile rows. A row pitch still counts the bytes of one row of the plane, a whole number of
+// tiles, so a row of tiles starts every RowPitch * Height bytes. Common sizes are 4x4, 16x16 and 64x32.
+struct CpuYuvTiling
+{
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+};
+
+// YUV target: a luminance plane and chroma at the resolution of the layout. Not owned.
+// Width and Height are the padded (even) dimensions. NV12, NV21, NV16 and NV24 use UV, one plane of
+// interleaved chroma pairs. I420, YV12, I422 and I444 use U and V, two planes with one byte per sample;
+// their order in memory is up to the caller. YUY2 and UYVY use only Y, as their single plane of 2 bytes
+// per pixel, and AYUV as its plane of 4. I400 uses only Y, with no chroma at all. AV12 is NV12 plus A, an
+// alpha plane of the size of Y. Only the 4:2:0 layouts are padded to an even height. NV12 tiled has the
+// planes of NV12, laid out in tiles of Tiling (which only tiled layouts use); the planes hold whole rows of
+// tiles, and the converter doesn't write the part of the edge tiles outside the image. Planes the layout
+// doesn't use may be null.
+struct CpuYuvImage
+{
+	uint8_t* Y;
+	size_t YRowPitch;
+	uint8_t* UV;
+	size_t UVRowPitch;
+	uint8_t* U;
+	size_t URowPitch;
+	uint8_t* V;
+	size_t VRowPitch;
+	uint8_t* A;
+	size_t ARowPitch;
+	uint32_t Width;
+	uint32_t Height;
+	CpuYuvTiling Tiling;
+};
+
+// Tightly-packed storage, the CPU-side equivalent of the resource made by CreateCompatibleYuvResource.
+// The planes follow each other in the usual order of the layout: Y, then UV, or U then V for the planar
+// layouts except YV12, which has V then U. AV12 has A last. Tiled layouts take the tile size, and throw
+// std::invalid_argument without a valid one; their rows are rounded up to whole tiles.
+struct CpuYuvBuffer
+{
+	std::vector<uint8_t> Storage;
+	CpuYuvImage Image;
+};
+
+CpuYuvBuffer CreateCompatibleYuvBuffer(CpuRgbImage const& rgb, CpuYuvLayout layout = CpuYuvLayout::Nv12, CpuYuvTiling const& tiling = CpuYuvTiling());
+
+// Bytes in the CpuYuvBuffer for a source of the given size, which is also what in-place conversion needs.
+size_t GetCompatibleYuvSize(uint32_t width, uint32_t height, CpuYuvLayout layout, CpuYuvTiling const& tiling = CpuYuvTiling());
+
+// Source image in plane memory, with 64-byte aligned rows. Write the pixels through Memory.Data() at
+// Image.RowPitch.
+struct CpuRgbPlane
+{
+	CpuPlaneMemory Memory;
+	CpuRgbImage Image;
+};
+
+CpuRgbPlane CreateRgbPlane(uint32_t width, uint32_t height, CpuPageMode pageMode);
+
+// Target in plane memory, planes in the same order as CpuYuvBuffer, with 64-byte aligned rows in every
+// plane. Unlike CpuYuvBuffer it isn't tightly packed unless the rows of each plane are a multiple of 64
+// bytes. Tiled rows are then rounded up to whole tiles.
+struct CpuYuvPlanes
+{
+	CpuPlaneMemory Memory;
+	CpuYuvImage Image;
+};
+
+CpuYuvPlanes CreateCompatibleYuvPlanes(CpuRgbImage const& rgb, CpuPageMode pageMode, CpuYuvLayout layout = CpuYuvLayout::Nv12,
+	CpuYuvTiling const& tiling = CpuYuvTiling());
+
+// D3D12_TEXTURE_DATA_PITCH_ALIGNMENT and D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, without including d3d12.h.
+uint32_t const CpuD3D12PitchAlignment = 256;
+uint32_t const CpuD3D12PlacementAlignment = 512;
+
+// One plane of a footprint: where it starts in the allocation and the bytes from one row to the next,
+// like the Offset and Footprint.RowPitch of a D3D12_PLACED_SUBRESOURCE_FOOTPRINT.
+struct CpuYuvPlaneFootprint
+{
+	uint64_t Offset = 0;
+	uint32_t RowPitch = 0;
+};
+
+// Where the planes of a target go in one caller-owned allocation, such as a mapped upload heap or the
+// input buffer of a hardware encoder. Width and Height are the padded dimensions, as in CpuYuvImage, and
+// the planes are named as there; the ones the layout doesn't use are ignored, and can be anywhere in the
+// allocation, in any order. TotalSize is the size of the allocation. Tiled layouts have no footprint.
+struct CpuYuvFootprint
+{
+	CpuYuvLayout Layout = CpuYuvLayout::Nv12;
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	CpuYuvPlaneFootprint Y;
+	CpuYuvPlaneFootprint UV;
+	CpuYuvPlaneFootprint U;
+	CpuYuvPlaneFootprint V;
+	CpuYuvPlaneFootprint A;
+	uint64_t TotalSize = 0;
+};
+
+// Footprint of the target for a source of the given size: planes in the order of CpuYuvBuffer, rows
+// padded to pitchAlignment and planes placed at multiples of placementAlignment. TotalSize ends at the
+// last byte of the last row, without padding it. With the default alignments it's where
+// GetCopyableFootprints puts the planes of the matching DXGI format, NV12 for NV12, so the whole target
+// can be copied into an upload heap at once. Throws std::invalid_argument for zero alignments and tiled
+// layouts.
+CpuYuvFootprint GetCompatibleYuvFootprint(uint32_t width, uint32_t height, CpuYuvLayout layout,
+	uint32_t pitchAlignment = CpuD3D12PitchAlignment, uint32_t placementAlignment = CpuD3D12PlacementAlignment);
+
+// Points a target at the planes of footprint in data, which holds footprint.TotalSize bytes. The footprint
+// may come from GetCompatibleYuvFootprint or from the caller, e.g. from GetCopyableFootprints. Throws
+// std::invalid_argument if a plane's rows are shorter than the layout needs, a plane doesn't fit in
+// TotalSize, or two planes overlap.
+CpuYuvImage PlaceYuvFootprint(uint8_t* data, CpuYuvFootprint const& footprint);
+
+// Element type of a tensor.
+enum class CpuTensorType
+{
+	Float32,
+	Float16,	// IEEE 754 binary16, as the bits of a uint16_t
+};
+
+// A batch of images as normalized float YUV planes in NCHW order, for inference. Not owned.
+// Each image is a Y plane, then a U plane, then a V plane, with tightly packed rows, and image n starts
+// n * GetYuvTensorImageSize bytes into Data. Width and Height are the size of the images, not padded.
+// The samples are the 8-bit codes of I420 in the converter's format: a code c of channel i becomes
+// (c / 255 - Mean[i]) / Std[i], computed in double and rounded to Type. The chroma planes are ceil(Width / 2) x
+// ceil(Height / 2), or with UpsampleChroma as large as Y, each chroma sample repeated over its 2x2 block,
+// which makes the batch an N x 3 x Height x Width tensor.
+struct CpuYuvTensor
+{
+	void* Data = nullptr;
+	CpuTensorType Type = CpuTensorType::Float32;
+	uint32_t BatchSize = 0;
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	bool UpsampleChroma = false;
+	float Mean[3] = { 0, 0, 0 };
+	float Std[3] = { 1, 1, 1 };
+};
+
+// Bytes of one image of the tensor, and of the whole batch.
+size_t GetYuvTensorImageSize(CpuYuvTensor const& tensor);
+size_t GetYuvTensorSize(CpuYuvTensor const& tensor);
+
+// How a conversion is divided between the threads of the converter's pool.
+enum class CpuScheduling
+{
+	// One band of whole row pairs per thread. Least overhead when every core is free.
+	StaticBands,
+
+	// Tiles of even width and height, spread over per-thread queues; idle threads steal from busy ones.
+	// Keeps large images scaling when some cores are shared with other processes.
+	WorkStealing,
+};
+
+// The converter's thread pool lives as long as the converter.
+class CpuConverter
+{
+	CpuKernels::KernelTable const* m_kernels;
+	CpuKernels::KernelEntry const* m_entry;
+	CpuConversionFormat m_format;
+	std::unique_ptr<CpuThreadPool> m_threadPool;
+	CpuScheduling m_scheduling;
+	uint32_t m_tileWidth;
+	uint32_t m_tileHeight;
+	CpuStoreMode m_storeMode;
+
+	void ConvertTiles(CpuKernels::RowKernels const& kernels, CpuRgbImage const& rgb, CpuYuvImage const& yuv) const;
+
+public:
+	// Binds the best kernels for this CPU, or the level forced through RGB2YUV_CPU_LEVEL.
+	// threadCount includes the calling thread; 0 means one per hardware thread.
+	explicit CpuConverter(uint32_t threadCount = 0);
+	explicit CpuConverter(CpuKernels::KernelTable const& kernels, uint32_t threadCount = 0);
+
+	// One tile is a cache block: 2048x16 pixels is 128 KiB of source and 48 KiB of NV12, which fits in L2
+	// together on current cores.
+	static uint32_t const DefaultTileWidth = 2048;
+	static uint32_t const DefaultTileHeight = 16;
+
+	char const* GetKernelName() const { return m_kernels->Name; }
+
+	// The default is the shader's conversion: B8G8R8A8 to NV12 with its BT.601 coefficients and no offsets.
+	// Targets must have the planes of the format's layout.
+	// The kernels for a format are looked up here, once, not per conversion.
+	// Throws std::invalid_argument if the bound kernel level has no kernels for the format.
+	CpuConversionFormat const& GetFormat() const { return m_format; }
+	void SetFormat(CpuConversionFormat const& format);
+
+	uint32_t GetThreadCount() const { return m_threadPool->GetThreadCount(); }
+	CpuScheduling GetScheduling() const { return m_scheduling; }
+
+	// WorkStealing is the default. Tile sizes only apply to WorkStealing; both must be even and non-zero,
+	// otherwise this throws std::invalid_argument.
+	void SetScheduling(CpuScheduling scheduling, uint32_t tileWidth = DefaultTileWidth, uint32_t tileHeight = DefaultTileHeight);
+
+	// Cached is the default.
+	CpuStoreMode GetStoreMode() const { return m_storeMode; }
+	void SetStoreMode(CpuStoreMode storeMode) { m_storeMode = storeMode; }
+
+	// Backs every page of memory using the converter's threads, e.g. for the planes of the next conversion.
+	// See CpuPlaneMemory::Prefault.
+	void Prefault(CpuPlaneMemory& memory) const { memory.Prefault(m_threadPool.get()); }
+
+	// Copies an NV12 image into the tiles of an NV12 tiled target of the same size, using the converter's
+	// threads. Converting to the tiled layout does this in the same pass; this is for NV12 from elsewhere.
+	// Throws std::invalid_argument if the images don't match.
+	void CopyToTiles(CpuYuvImage const& nv12, CpuYuvImage const& tiled) const;
+
+	// Writes an I420 image, the padded size of the tensor's images, into image index of the tensor. This is
+	// the second pass that ConvertRgbToTensor saves, for I420 from elsewhere.
+	// Throws std::invalid_argument if the tensor is invalid, index is outside the batch, or the image
+	// doesn't match.
+	void CopyToTensor(CpuYuvImage const& i420, CpuYuvTensor const& tensor, uint32_t index) const;
+
+	// Synchronous: returns once the whole image has been converted.
+	// Tiled targets get written in the same pass, with no linear copy of the image: each block of up to two
+	// rows of luma tiles is converted into a small scratch block and copied out tile by tile. Store modes
+	// don't apply to them.
+	// Throws std::invalid_argument if the target isn't the padded size of the source, or lacks a plane of
+	// the layout.
+	void ConvertRgbToYuv(CpuRgbImage const& rgb, CpuYuvImage const& yuv, CpuAccuracy accuracy = CpuAccuracy::BitExact) const;
+
+	// Converts the source to YUV in its own memory, for images too large to hold twice. buffer is the
+	// source allocation (rgb.Data, writable) and bufferSize its size in bytes. On return the buffer holds
+	// the padded image, tightly packed like CpuYuvBuffer: the Y plane at the start and the chroma planes
+	// right after it, as described by the returned image. The source is gone.
+	//
+	// Row pairs (single rows for layouts without vertical subsampling) are converted top to bottom, a batch
+	// at a time, and nothing gets written over source rows that haven't been read yet. Output that would
+	// land on unread rows waits in scratch memory until they have been; that is a small fraction of the
+	// frame (about 1/28 of the source for tight NV12 rows), needed at the start only. Scheduling and tile sizes don't apply.
+	// Throws std::invalid_argument if the source is invalid, isn't inside the buffer, or the YUV image
+	// doesn't fit in the buffer, and for tiled layouts.
+	CpuYuvImage ConvertRgbToYuvInPlace(uint8_t* buffer, size_t bufferSize, CpuRgbImage const& rgb, CpuAccuracy accuracy = CpuAccuracy::BitExact) const;
+
+	// The inverse of ConvertRgbToYuv, for reversible layouts (IsReversibleYuvLayout): writes rgb back from
+	// yuv, which is its padded size, with opaque alpha. YCoCg-R 4:4:4 gives back the source pixels exactly;
+	// 4:2:0 gives each 2x2 block the Co and Cg of the block. Bands of rows go to the converter's threads;
+	// scheduling and store modes don't apply.
+	// Throws std::invalid_argument for layouts without an inverse, if yuv isn't the padded size of rgb, or
+	// if it lacks a plane of the layout.
+	void ConvertYuvToRgb(CpuYuvImage const& yuv, CpuRgbTarget const& rgb) const;
+
+	// Converts images[0] to images[tensor.BatchSize - 1] into the tensor, in one pass: each row pair is
+	// converted to I420 in a small scratch block and written out as tensor elements while it's still in
+	// the cache, so no I420 frame is ever stored. The I420 kernels of the converter's input, matrix and
+	// range are used, whatever its layout. Bands of rows of every image are spread over the threads like
+	// tiles; tile widths and store modes don't apply. The result is the same as ConvertRgbToYuv to I420
+	// followed by CopyToTensor.
+	// Throws std::invalid_argument if the tensor is invalid (no data, a zero size, or a zero Std), an
+	// image isn't the tensor's size, or the kernel level has no I420 kernels for the format.
+	void ConvertRgbToTensor(CpuRgbImage const* images, CpuYuvTensor const& tensor, CpuAccuracy accuracy = CpuAccuracy::BitExact) const;
+};
@@ -0,0 +1,171 @@
+// CpuFeatures.cpp: CPUID probing and kernel selection.
+
+#include "CpuFeatures.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(RGB2YUV_X86_KERNELS)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace
+{
+#if defined(RGB2YUV_X86_KERNELS)
+	struct CpuidResult
+	{
+		uint32_t Eax;
+		uint32_t Ebx;
+		uint32_t Ecx;
+		uint32_t Edx;
+	};
+
+	CpuidResult Cpuid(uint32_t leaf, uint32_t subleaf)
+	{
+		CpuidResult result{};
+#if defined(_MSC_VER)
+		int registers[4];
+		__cpuidex(registers, static_cast<int>(leaf), static_cast<int>(subleaf));
+		result.Eax = registers[0];
+		result.Ebx = registers[1];
+		result.Ecx = registers[2];
+		result.Edx = registers[3];
+#else
+		__cpuid_count(leaf, subleaf, result.Eax, result.Ebx, result.Ecx, result.Edx);
+#endif
+		return result;
+	}
+
+	// Which register state the OS saves on context switch. Only valid when OSXSAVE is set.
+	uint64_t GetEnabledXsaveFeatures()
+	{
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		uint32_t eax = 0;
+		uint32_t edx = 0;
+		__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return (uint64_t(edx) << 32) | eax;
+#endif
+	}
+
+	bool HasBit(uint32_t value, int bit)
+	{
+		return (value & (1u << bit)) != 0;
+	}
+
+	CpuKernelLevel ProbeCpuKernelLevel()
+	{
+		uint32_t maxLeaf = Cpuid(0, 0).Eax;
+		if (maxLeaf < 1)
+			return CpuKernelLevel::Scalar;
+
+		CpuidResult leaf1 = Cpuid(1, 0);
+		bool ssse3 = HasBit(leaf1.Ecx, 9);
+		bool sse41 = HasBit(leaf1.Ecx, 19);
+		if (!ssse3 || !sse41)
+			return CpuKernelLevel::Scalar;
+
+		bool osxsave = HasBit(leaf1.Ecx, 27);
+		bool avx = HasBit(leaf1.Ecx, 28);
+		if (!osxsave || !avx || maxLeaf < 7)
+			return CpuKernelLevel::Sse41;
+
+		uint64_t xcr0 = GetEnabledXsaveFeatures();
+		bool ymmState = (xcr0 & 0x6) == 0x6;			// SSE and AVX state
+		bool zmmState = (xcr0 & 0xE6) == 0xE6;		// plus opmask and both halves of the ZMM registers
+
+		CpuidResult leaf7 = Cpuid(7, 0);
+		bool avx2 = HasBit(leaf7.Ebx, 5);
+		if (!ymmState || !avx2)
+			return CpuKernelLevel::Sse41;
+
+		bool avx512f = HasBit(leaf7.Ebx, 16);
+		bool avx512bw = HasBit(leaf7.Ebx, 30);
+		bool avx512vl = HasBit(leaf7.Ebx, 31);
+		if (!zmmState || !avx512f || !avx512bw || !avx512vl)
+			return CpuKernelLevel::Avx2;
+
+		bool avx512vnni = HasBit(leaf7.Ecx, 11);
+		return avx512vnni ? CpuKernelLevel::Avx512Vnni : CpuKernelLevel::Avx512;
+	}
+#else
+	CpuKernelLevel ProbeCpuKernelLevel()
+	{
+		return CpuKernelLevel::Scalar;
+	}
+#endif
+
+	CpuKernelLevel const c_allLevels[] =
+	{
+		CpuKernelLevel::Scalar,
+		CpuKernelLevel::Sse41,
+		CpuKernelLevel::Avx2,
+		CpuKernelLevel::Avx512,
+		CpuKernelLevel::Avx512Vnni,
+	};
+}
+
+bool IsCpuKernelLevelSupported(CpuKernelLevel level)
+{
+	return level <= DetectCpuKernelLevel();
+}
+
+CpuKernelLevel DetectCpuKernelLevel()
+{
+	static CpuKernelLevel const detected = ProbeCpuKernelLevel();
+	return detected;
+}
+
+CpuKernels::KernelTable const& GetCpuKernels(CpuKernelLevel level)
+{
+	switch (level)
+	{
+#if defined(RGB2YUV_X86_KERNELS)
+	case CpuKernelLevel::Sse41: return CpuKernels::Sse41Kernels;
+	case CpuKernelLevel::Avx2: return CpuKernels::Avx2Kernels;
+	case CpuKernelLevel::Avx512: return CpuKernels::Avx512Kernels;
+	case CpuKernelLevel::Avx512Vnni: return CpuKernels::Avx512VnniKernels;
+#endif
+	default: return CpuKernels::ScalarKernels;
+	}
+}
+
+bool ParseCpuKernelLevel(char const* name, CpuKernelLevel* level)
+{
+	for (CpuKernelLevel candidate : c_allLevels)
+	{
+		if (std::strcmp(name, GetCpuKernels(candidate).Name) == 0)
+		{
+			*level = candidate;
+			return true;
+		}
+	}
+	return false;
+}
+
+CpuKernels::KernelTable const& SelectCpuKernels(char const* requestedLevel)
+{
+	char const* forced = requestedLevel;
+	if (!forced || !*forced)
+		forced = std::getenv(RGB2YUV_CPU_LEVEL_VARIABLE);
+
+	if (!forced || !*forced)
+		return GetCpuKernels(DetectCpuKernelLevel());
+
+	CpuKernelLevel level;
+	if (!ParseCpuKernelLevel(forced, &level))
+		throw std::runtime_error(std::string("Unknown CPU kernel level ") + forced);
+
+	if (!IsCpuKernelLevelSupported(level))
+		throw std::runtime_error(std::string("CPU kernel level ") + forced + " isn't supported on this host");
+
+	return GetCpuKernels(level);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "CpuKernels.h"
+
+// Runtime selection of the row kernels, the CPU-side counterpart of GetHardwareAdapter.
+// One binary carries every kernel; CPUID decides which one is safe and fastest on this host.
+
+enum class CpuKernelLevel
+{
+	Scalar,
+	Sse41,
+	Avx2,
+	Avx512,
+	Avx512Vnni,
+};
+
+// Environment variable that forces a level, e.g. RGB2YUV_CPU_LEVEL=avx2 to stay clear of AVX-512
+// frequency drops, or to A/B two levels on the same host.
+#define RGB2YUV_CPU_LEVEL_VARIABLE "RGB2YUV_CPU_LEVEL"
+
+bool IsCpuKernelLevelSupported(CpuKernelLevel level);
+
+// Highest level this CPU and OS support.
+CpuKernelLevel DetectCpuKernelLevel();
+
+CpuKernels::KernelTable const& GetCpuKernels(CpuKernelLevel level);
+
+// Returns false for names that aren't a known level. Names are the kernel table names (scalar, sse41, ...).
+bool ParseCpuKernelLevel(char const* name, CpuKernelLevel* level);
+
+// Picks the kernels to use: requestedLevel if given (e.g. from the command line), otherwise
+// RGB2YUV_CPU_LEVEL, otherwise the detected level.
+// Throws std::runtime_error if a forced level is unknown or not supported by this CPU.
+CpuKernels::KernelTable const& SelectCpuKernels(char const* requestedLevel = nullptr);
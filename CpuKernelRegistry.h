@@ -0,0 +1,72 @@
+#pragma once
+
+#include <utility>
+
+#include "CpuColorMath.h"
+
+// Expands one family of kernel templates into a KernelTable entry per conversion format.
+//
+// A family is a class template over ColorTraits and a KernelStore, with three static RowKernels members,
+// BitExact, Fast and Dithered. Each kernel translation unit instantiates the registry
+// with its own family, so every entry is compiled with that unit's instruction set flags and has its
+// coefficients and offsets folded in as constants.
+//
+// Layouts that differ only in the order of U and V share kernels. NV21 runs the NV12 kernels with the U
+// and V coefficients exchanged; I420 and YV12 run the same kernels, and only place the planes differently.
+// The 16-bit layouts run with WideSamples traits (see LayoutColor). Stores without vertical subsampling
+// (IsRowStore) fill in the Row entry points, the others RowPair. YCoCg-R has an entry for every matrix and
+// range, which it ignores; its kernels only depend on the input, so the entries share them.
+//
+// Every entry instantiates its row kernels for three tiers and both store modes, and the coefficients
+// differ per entry, so nothing is shared between matrices and ranges: a full table is a few thousand
+// kernel functions, and each SIMD unit takes a minute or more to compile.
+namespace Rgb2YuvMath
+{
+namespace
+{
+	constexpr CpuPixelFormat c_registryInputs[] = { CpuPixelFormat::Bgra8, CpuPixelFormat::Rgba8 };
+#if defined(RGB2YUV_DEFAULT_COLOR_KERNELS)
+	// Set for the SIMD units when RGB2YUV_ALL_KERNEL_COLORS is off: a sixth of the instantiations, and a
+	// sixth of the compile time. The scalar table keeps every combination.
+	constexpr CpuColorMatrix c_registryMatrices[] = { CpuColorMatrix::Bt601 };
+	constexpr CpuColorRange c_registryRanges[] = { CpuColorRange::Shader };
+#else
+	constexpr CpuColorMatrix c_registryMatrices[] = { CpuColorMatrix::Bt601, CpuColorMatrix::Bt709 };
+	constexpr CpuColorRange c_registryRanges[] = { CpuColorRange::Shader, CpuColorRange::Limited, CpuColorRange::Full };
+#endif
+	constexpr CpuYuvLayout c_registryLayouts[] =
+	{
+		CpuYuvLayout::Nv12, CpuYuvLayout::Nv21, CpuYuvLayout::I420, CpuYuvLayout::Yv12, CpuYuvLayout::Yuy2, CpuYuvLayout::Uyvy,
+		CpuYuvLayout::Nv16, CpuYuvLayout::I422, CpuYuvLayout::Nv24, CpuYuvLayout::I444,
+		CpuYuvLayout::P010, CpuYuvLayout::P016, CpuYuvLayout::I010, CpuYuvLayout::Av12, CpuYuvLayout::Ayuv,
+		CpuYuvLayout::YCoCgR444, CpuYuvLayout::YCoCgR420, CpuYuvLayout::I400,
+	};
+
+	constexpr size_t c_inputCount = sizeof(c_registryInputs) / sizeof(c_registryInputs[0]);
+	constexpr size_t c_matrixCount = sizeof(c_registryMatrices) / sizeof(c_registryMatrices[0]);
+	constexpr size_t c_rangeCount = sizeof(c_registryRanges) / sizeof(c_registryRanges[0]);
+	constexpr size_t c_layoutCount = sizeof(c_registryLayouts) / sizeof(c_registryLayouts[0]);
+
+	template<template<typename, KernelStore> class Family, size_t Index>
+	constexpr CpuKernels::KernelEntry MakeKernelEntry()
+	{
+		constexpr CpuPixelFormat input = c_registryInputs[Index % c_inputCount];
+		constexpr CpuColorMatrix matrix = c_registryMatrices[(Index / c_inputCount) % c_matrixCount];
+		constexpr CpuColorRange range = c_registryRanges[(Index / (c_inputCount * c_matrixCount)) % c_rangeCount];
+		constexpr CpuYuvLayout layout = c_registryLayouts[Index / (c_inputCount * c_matrixCount * c_rangeCount)];
+
+		typedef Family<LayoutColor<ColorTraits<input, matrix, range>, layout>, GetKernelStore(layout)> Kernels;
+		return { { input, layout, matrix, range }, Kernels::BitExact, Kernels::Fast, Kernels::Dithered };
+	}
+
+	template<template<typename, KernelStore> class Family, typename Indices = std::make_index_sequence<c_inputCount * c_matrixCount * c_rangeCount * c_layoutCount>>
+	struct KernelRegistry;
+
+	template<template<typename, KernelStore> class Family, size_t... Index>
+	struct KernelRegistry<Family, std::index_sequence<Index...>>
+	{
+		static constexpr CpuKernels::KernelEntry Entries[] = { MakeKernelEntry<Family, Index>()... };
+		static constexpr size_t EntryCount = sizeof...(Index);
+	};
+}
+}
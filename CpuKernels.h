@@ -0,0 +1,362 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Row kernels used by CpuConverter. LumaRow is OutputY for one source row. RowPair does what the
+// shader's main() does for a pair of source rows, OutputY for both and OutputUV for the pair, but loads
+// each source pixel once instead of twice. RowPairStreaming produces the same bytes with non-temporal
+// stores and software prefetch of the source (see CpuStoreMode). Layouts with chroma on every row have Row
+// and RowStreaming instead of the RowPair entry points: one source row in, one target row out.
+//
+// srcWidth is the real image width; dstWidth is the even width of the target. Pixels at or past
+// srcWidth replicate the last source pixel, which is how the CPU path fills the padding column that
+// CreateCompatibleYuvResource adds to odd-sized images.
+//
+// Reversible layouts also have InverseRow, which turns one target row back into source pixels.
+
+// Accuracy tier, chosen per conversion. The YCoCg-R layouts have nothing to round, so every tier runs the
+// same kernels for them.
+enum class CpuAccuracy
+{
+	// Exact integer arithmetic; matches a double-precision evaluation of the shader formulas bit for bit.
+	BitExact,
+
+	// 8-bit coefficients that fit pmaddubsw. At most 1 LSB off the float formulas. 8-bit coefficients
+	// can't deliver 10-bit samples, so the 16-bit layouts run their exact kernels.
+	Fast,
+
+	// Exact arithmetic, but rounded with a 4x4 ordered dither instead of to nearest: at most 1 LSB off the
+	// float formulas, and smooth gradients keep their average level instead of breaking into bands. The
+	// 16-bit layouts have nothing to dither and run their exact kernels. LumaRow, which has no position,
+	// dithers like the top left of an image.
+	Dithered,
+};
+
+// Source pixel layout.
+enum class CpuPixelFormat
+{
+	Bgra8,		// DXGI_FORMAT_B8G8R8A8_UNORM, what the shader reads
+	Rgba8,		// DXGI_FORMAT_R8G8B8A8_UNORM
+};
+
+// Target plane layout.
+enum class CpuYuvLayout
+{
+	// 4:2:0, chroma at half resolution in both directions.
+	Nv12,		// Y plane, then interleaved UV
+	Nv21,		// Y plane, then interleaved VU
+	I420,		// Y plane, then a U plane, then a V plane
+	Yv12,		// Y plane, then a V plane, then a U plane
+
+	// Packed 4:2:2, chroma at half resolution horizontally only: one plane, 4 bytes per pixel pair.
+	Yuy2,		// Y0 U Y1 V
+	Uyvy,		// U Y0 V Y1
+
+	// 4:2:2 in planes, chroma rows of half the width.
+	Nv16,		// Y plane, then interleaved UV
+	I422,		// Y plane, then a U plane, then a V plane
+
+	// 4:4:4, chroma at full resolution.
+	Nv24,		// Y plane, then interleaved UV
+	I444,		// Y plane, then a U plane, then a V plane
+
+	// 4:2:0 with 16-bit little-endian samples.
+	P010,		// Y plane, then interleaved UV; 10 bits in the high bits of each sample
+	P016,		// Y plane, then interleaved UV; 16 bits
+	I010,		// Y plane, then a U plane, then a V plane; 10 bits in the low bits of each sample
+
+	// With the source alpha carried through, unchanged; color stays premultiplied if the source is.
+	Av12,		// NV12, then a full-resolution alpha plane
+	Ayuv,		// Packed 4:4:4, one plane of V U Y A, 4 bytes per pixel (DXGI_FORMAT_AYUV)
+
+	// In tiles rather than rows, for encoders and display engines that take tiled surfaces. The tile size
+	// is part of the target (CpuYuvImage::Tiling), not of the layout.
+	Nv12Tiled,	// Y plane, then interleaved UV, both in tiles of the same size
+
+	// Reversible YCoCg-R instead of YUV: Co = R - B, t = B + (Co >> 1), Cg = G - t, Y = t + (Cg >> 1), with
+	// arithmetic shifts, and back by undoing each step. Matrix and Range don't apply. Y, Co and Cg are
+	// planes of 16-bit little-endian words, Y in [0, 255] and Co and Cg signed in [-255, 255]; CpuYuvImage
+	// has Co in U and Cg in V. Only 4:4:4 round-trips exactly; 4:2:0 averages Co and Cg over 2x2 blocks.
+	YCoCgR444,	// Y plane, then a Co plane, then a Cg plane
+	YCoCgR420,	// the same with Co and Cg at half resolution in both directions
+
+	// Luma only, for consumers that never read chroma: no chroma is loaded, averaged or stored.
+	I400,		// Y plane alone (grey)
+};
+
+// Layouts with separate U and V planes, rather than one interleaved chroma plane.
+constexpr bool IsPlanarYuvLayout(CpuYuvLayout layout)
+{
+	return layout == CpuYuvLayout::I420 || layout == CpuYuvLayout::Yv12 || layout == CpuYuvLayout::I422 || layout == CpuYuvLayout::I444 ||
+		layout == CpuYuvLayout::I010 || layout == CpuYuvLayout::YCoCgR444 || layout == CpuYuvLayout::YCoCgR420;
+}
+
+// Layouts with nothing but a Y plane.
+constexpr bool IsLumaOnlyYuvLayout(CpuYuvLayout layout)
+{
+	return layout == CpuYuvLayout::I400;
+}
+
+// Layouts with an inverse conversion back to the source format.
+constexpr bool IsReversibleYuvLayout(CpuYuvLayout layout)
+{
+	return layout == CpuYuvLayout::YCoCgR444 || layout == CpuYuvLayout::YCoCgR420;
+}
+
+// Layouts with luma and chroma interleaved in a single plane.
+constexpr bool IsPackedYuvLayout(CpuYuvLayout layout)
+{
+	return layout == CpuYuvLayout::Yuy2 || layout == CpuYuvLayout::Uyvy || layout == CpuYuvLayout::Ayuv;
+}
+
+// Bytes per pixel of the single plane of a packed layout.
+constexpr uint32_t GetPackedPixelSize(CpuYuvLayout layout)
+{
+	return layout == CpuYuvLayout::Ayuv ? 4 : 2;
+}
+
+// Layouts whose planes are stored in tiles.
+constexpr bool IsTiledYuvLayout(CpuYuvLayout layout)
+{
+	return layout == CpuYuvLayout::Nv12Tiled;
+}
+
+// The layout whose kernels a tiled layout runs: tiles only change where the rows go.
+constexpr CpuYuvLayout GetLinearYuvLayout(CpuYuvLayout layout)
+{
+	return layout == CpuYuvLayout::Nv12Tiled ? CpuYuvLayout::Nv12 : layout;
+}
+
+// Layouts with chroma planes next to Y: all but the packed and luma-only ones.
+constexpr bool HasChromaPlanes(CpuYuvLayout layout)
+{
+	return !IsPackedYuvLayout(layout) && !IsLumaOnlyYuvLayout(layout);
+}
+
+// Layouts with a separate alpha plane, as large as the luma plane.
+constexpr bool HasAlphaPlane(CpuYuvLayout layout)
+{
+	return layout == CpuYuvLayout::Av12;
+}
+
+// Layouts that average chroma over row pairs. The others have chroma on every row and don't pad the
+// target to an even height.
+constexpr bool HasVerticalChromaSubsampling(CpuYuvLayout layout)
+{
+	return layout == CpuYuvLayout::Nv12 || layout == CpuYuvLayout::Nv21 || layout == CpuYuvLayout::I420 || layout == CpuYuvLayout::Yv12 ||
+		layout == CpuYuvLayout::P010 || layout == CpuYuvLayout::P016 || layout == CpuYuvLayout::I010 || layout == CpuYuvLayout::Av12 || layout == CpuYuvLayout::Nv12Tiled ||
+		layout == CpuYuvLayout::YCoCgR420;
+}
+
+// Layouts with one chroma sample per horizontal pixel pair. The 4:4:4 ones have one per pixel. I400 counts
+// as subsampled, so its rows are padded to an even width like those of every other layout.
+constexpr bool HasHorizontalChromaSubsampling(CpuYuvLayout layout)
+{
+	return layout != CpuYuvLayout::Nv24 && layout != CpuYuvLayout::I444 && layout != CpuYuvLayout::Ayuv && layout != CpuYuvLayout::YCoCgR444;
+}
+
+// Significant bits per sample, 9 for the signed Co and Cg of YCoCg-R. Samples of more than 8 bits take
+// 16-bit words.
+constexpr int GetYuvSampleBits(CpuYuvLayout layout)
+{
+	return layout == CpuYuvLayout::P016 ? 16 : layout == CpuYuvLayout::P010 || layout == CpuYuvLayout::I010 ? 10 :
+		IsReversibleYuvLayout(layout) ? 9 : 8;
+}
+
+// Bytes per sample.
+constexpr uint32_t GetYuvSampleSize(CpuYuvLayout layout)
+{
+	return GetYuvSampleBits(layout) > 8 ? 2 : 1;
+}
+
+// How far each sample is shifted up in its word: P010 keeps its 10 bits at the top, like P016.
+constexpr int GetYuvSampleShift(CpuYuvLayout layout)
+{
+	return layout == CpuYuvLayout::P010 ? 6 : 0;
+}
+
+enum class CpuColorMatrix
+{
+	Bt601,
+	Bt709,
+};
+
+enum class CpuColorRange
+{
+	// Y in [16, 235], chroma in [16, 240] around 128.
+	Limited,
+
+	// Y and chroma use all of [0, 255], chroma around 128.
+	Full,
+
+	// What RgbToYuvCS.hlsl computes: limited-range scale without the +16/+128 offsets, so negative
+	// chroma clamps to zero.
+	Shader,
+};
+
+// Everything that selects a kernel instantiation. The default is the shader's own conversion.
+struct CpuConversionFormat
+{
+	CpuPixelFormat Input = CpuPixelFormat::Bgra8;
+	CpuYuvLayout Output = CpuYuvLayout::Nv12;
+	CpuColorMatrix Matrix = CpuColorMatrix::Bt601;
+	CpuColorRange Range = CpuColorRange::Shader;
+
+	bool operator==(CpuConversionFormat const& other) const
+	{
+		return Input == other.Input && Output == other.Output && Matrix == other.Matrix && Range == other.Range;
+	}
+};
+
+// How the kernels write the target.
+enum class CpuStoreMode
+{
+	// Ordinary stores; the target ends up in cache.
+	Cached,
+
+	// Non-temporal stores that bypass the cache, plus prefetch of the source rows ahead of the kernel.
+	// For frames much larger than the cache, where the target isn't read again soon: the stores neither
+	// evict the source nor read each target line in before writing it. Rows whose target pointers can't be
+	// brought to the vector alignment together fall back to ordinary stores.
+	Streaming,
+};
+
+namespace CpuKernels
+{
+	// Target rows of one row pair. Interleaved layouts write their chroma row to UV, planar ones to U and
+	// V, which are half as wide; the pointers a layout doesn't use are ignored. 16-bit layouts write two
+	// bytes per sample. AV12 also copies the source alpha to A0 and A1.
+	//
+	// Left and Top are the image position of the first target pixel. Only dithering kernels use them, to
+	// keep the pattern continuous across tiles.
+	struct RowPairTarget
+	{
+		uint8_t* Y0;
+		uint8_t* Y1;
+		uint8_t* UV;
+		uint8_t* U;
+		uint8_t* V;
+		uint8_t* A0;
+		uint8_t* A1;
+		uint32_t Left;
+		uint32_t Top;
+	};
+
+	// Target of one row, for layouts with chroma on every row. Packed layouts write the whole row to Y, and
+	// I400 only writes Y. The chroma rows hold a sample per pixel pair for 4:2:2 and per pixel for 4:4:4.
+	struct RowTarget
+	{
+		uint8_t* Y;
+		uint8_t* UV;
+		uint8_t* U;
+		uint8_t* V;
+		uint32_t Left;
+		uint32_t Top;
+	};
+
+	// Source of one row of an inverse conversion. Layouts with vertical chroma subsampling pass the chroma
+	// rows of the row's pair.
+	struct InverseRowSource
+	{
+		uint8_t const* Y;
+		uint8_t const* U;
+		uint8_t const* V;
+	};
+
+	typedef void (*LumaRowFn)(uint8_t const* src, uint32_t srcWidth, uint8_t* dstY, uint32_t dstWidth);
+	typedef void (*RowPairFn)(uint8_t const* src0, uint8_t const* src1, uint32_t srcWidth, RowPairTarget const& dst, uint32_t dstWidth);
+	typedef void (*RowFn)(uint8_t const* src, uint32_t srcWidth, RowTarget const& dst, uint32_t dstWidth);
+	typedef void (*InverseRowFn)(InverseRowSource const& src, uint8_t* dst, uint32_t width);
+	typedef void (*TensorRowFn)(uint8_t const* codes, void const* table, void* dst, uint32_t count);
+
+	// A layout has either the RowPair or the Row entry points, depending on HasVerticalChromaSubsampling;
+	// the others are null. InverseRow is null unless the layout is reversible; it writes width source
+	// pixels with opaque alpha.
+	struct RowKernels
+	{
+		LumaRowFn LumaRow;
+		RowPairFn RowPair;
+		RowPairFn RowPairStreaming;
+		RowFn Row;
+		RowFn RowStreaming;
+		InverseRowFn InverseRow;
+
+		RowPairFn GetRowPair(CpuStoreMode storeMode) const
+		{
+			return storeMode == CpuStoreMode::Streaming ? RowPairStreaming : RowPair;
+		}
+
+		RowFn GetRow(CpuStoreMode storeMode) const
+		{
+			return storeMode == CpuStoreMode::Streaming ? RowStreaming : Row;
+		}
+	};
+
+	// The kernels of one instruction set level for one conversion format. Coefficients and offsets are
+	// template arguments of the kernels, so nothing about the format is decided per pixel.
+	struct KernelEntry
+	{
+		CpuConversionFormat Format;
+		RowKernels BitExact;
+		RowKernels Fast;
+		RowKernels Dithered;
+
+		RowKernels const& Get(CpuAccuracy accuracy) const
+		{
+			switch (accuracy)
+			{
+			case CpuAccuracy::Fast: return Fast;
+			case CpuAccuracy::Dithered: return Dithered;
+			default: return BitExact;
+			}
+		}
+	};
+
+	// Bytes after each tensor table that the kernels may read, so a 32-bit gather can fetch the last
+	// binary16 element.
+	constexpr size_t TensorTablePadding = 4;
+
+	// Expansion of 8-bit codes into tensor elements through a table of the element of every code: floats
+	// for the Float32 kernels, binary16 bits for the Float16 ones, followed by TensorTablePadding bytes.
+	// Each writes count elements; the Doubled variants repeat every code, so element i is the one of code
+	// codes[i / 2]. Elements are copied from the table, so every level writes the same bits.
+	struct TensorKernels
+	{
+		TensorRowFn Float32;
+		TensorRowFn Float32Doubled;
+		TensorRowFn Float16;
+		TensorRowFn Float16Doubled;
+	};
+
+	// Every conversion format one instruction set level supports. Look entries up once when setting up a
+	// conversion, not per row.
+	struct KernelTable
+	{
+		char const* Name;
+		KernelEntry const* Entries;
+		size_t EntryCount;
+		TensorKernels Tensor;
+
+		// Returns null if this level has no kernels for the format.
+		KernelEntry const* Find(CpuConversionFormat const& format) const
+		{
+			for (size_t i = 0; i < EntryCount; ++i)
+			{
+				if (Entries[i].Format == format)
+					return &Entries[i];
+			}
+			return nullptr;
+		}
+	};
+
+	extern KernelTable const ScalarKernels;
+
+#if defined(RGB2YUV_X86_KERNELS)
+	// Only safe to call on CPUs with the matching instruction set.
+	extern KernelTable const Sse41Kernels;		// SSSE3 and SSE4.1
+	extern KernelTable const Avx2Kernels;
+	extern KernelTable const Avx512Kernels;		// AVX-512F/BW/VL
+	extern KernelTable const Avx512VnniKernels;	// AVX-512F/BW/VL plus VNNI
+#endif
+}
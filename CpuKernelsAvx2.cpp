@@ -0,0 +1,971 @@
+// CpuKernelsAvx2.cpp: AVX2 row kernels. Built with AVX2 code generation; only call through Avx2Kernels.
+
+#include "CpuKernels.h"
+#include "CpuKernelRegistry.h"
+
+#include <immintrin.h>
+
+using namespace Rgb2YuvMath;
+
+namespace
+{
+	// Pairs a low and a high 16-bit operand for pmaddwd.
+	__m256i WordPair(int16_t low, int16_t high)
+	{
+		return _mm256_set1_epi32(static_cast<int32_t>((static_cast<uint32_t>(static_cast<uint16_t>(high)) << 16) | static_cast<uint16_t>(low)));
+	}
+
+	// Four 16-bit operands repeated per 64 bits, for madd against the [B, G, R, A] chroma sums.
+	__m256i WordQuad(int16_t b, int16_t g, int16_t r)
+	{
+		return _mm256_setr_epi16(b, g, r, 0, b, g, r, 0, b, g, r, 0, b, g, r, 0);
+	}
+
+	// floor((n + rounding) / d) for every lane. A float estimate is within one of the answer, and the exact
+	// integer remainder fixes it up, so this matches the scalar division bit for bit.
+	__m256i RoundedDivide(__m256i n, __m256i rounding, int32_t denominator)
+	{
+		__m256i d = _mm256_set1_epi32(denominator);
+		n = _mm256_add_epi32(n, rounding);
+
+		__m256i q = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(n), _mm256_set1_ps(1.0f / denominator)));
+		__m256i r = _mm256_sub_epi32(n, _mm256_mullo_epi32(q, d));
+
+		q = _mm256_add_epi32(q, _mm256_cmpgt_epi32(_mm256_setzero_si256(), r));
+		q = _mm256_sub_epi32(q, _mm256_cmpgt_epi32(r, _mm256_sub_epi32(d, _mm256_set1_epi32(1))));
+		return q;
+	}
+
+	// Packs 4x8 int32 results into 32 bytes in source order, saturating to [0, 255].
+	__m256i PackToBytes(__m256i q0, __m256i q1, __m256i q2, __m256i q3)
+	{
+		__m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(q0, q1), _mm256_packs_epi32(q2, q3));
+		return _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+	}
+
+	// Saturates 2x8 int32 results to 16-bit samples of Color, shifted into place. Like packus, this works
+	// within 128-bit lanes: q0 and q1 alternate in blocks of four.
+	template<typename Color>
+	__m256i PackToWords(__m256i q0, __m256i q1)
+	{
+		__m256i words = _mm256_packus_epi32(q0, q1);
+		if (Color::SampleBits < 16)
+			words = _mm256_min_epu16(words, _mm256_set1_epi16(static_cast<int16_t>(MaxSample<Color>())));
+		return _mm256_slli_epi16(words, Color::SampleShift);
+	}
+
+	// Luma roundings of 8 pixels from image position (x, y) on. The dither pattern repeats every 4 pixels,
+	// so they hold for every later group in the row, and without dithering they're all the same.
+	template<typename Color>
+	__m256i LumaRounding(uint32_t x, uint32_t y)
+	{
+		return _mm256_setr_epi32(
+			LumaRoundingAt<Color>(x, y), LumaRoundingAt<Color>(x + 1, y), LumaRoundingAt<Color>(x + 2, y), LumaRoundingAt<Color>(x + 3, y),
+			LumaRoundingAt<Color>(x + 4, y), LumaRoundingAt<Color>(x + 5, y), LumaRoundingAt<Color>(x + 6, y), LumaRoundingAt<Color>(x + 7, y));
+	}
+
+	// The same for 8 chroma samples from (x, y) of the chroma plane on, in the lane order of
+	// ChromaComponent8, or in sample order for PixelChroma8.
+	template<typename Color, bool SampleOrder>
+	__m256i ChromaRounding(uint32_t x, uint32_t y)
+	{
+		uint32_t const quads[8] = { 0, 1, 4, 5, 2, 3, 6, 7 };
+		int32_t roundings[8];
+		for (uint32_t i = 0; i < 8; ++i)
+		{
+			roundings[i] = ChromaRoundingAt<Color>(x + (SampleOrder ? i : quads[i]), y);
+		}
+		return _mm256_loadu_si256(reinterpret_cast<__m256i const*>(roundings));
+	}
+
+	__m256i Load(uint8_t const* src)
+	{
+		return _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src));
+	}
+
+	// OutputY for 8 pixels; one int32 per lane.
+	template<typename Color>
+	__m256i Luma8(__m256i pixels, __m256i rounding)
+	{
+		__m256i byteMask = _mm256_set1_epi32(0x00FF00FF);
+
+		__m256i br = _mm256_and_si256(pixels, byteMask);
+		__m256i ga = _mm256_and_si256(_mm256_srli_epi32(pixels, 8), byteMask);
+
+		__m256i high = _mm256_add_epi32(
+			_mm256_madd_epi16(br, WordPair(HighPart(Color::YB), HighPart(Color::YR))),
+			_mm256_madd_epi16(ga, WordPair(HighPart(Color::YG), 0)));
+		__m256i low = _mm256_add_epi32(
+			_mm256_madd_epi16(br, WordPair(LowPart(Color::YB), LowPart(Color::YR))),
+			_mm256_madd_epi16(ga, WordPair(LowPart(Color::YG), 0)));
+
+		__m256i n = _mm256_add_epi32(_mm256_slli_epi32(high, SplitShift), low);
+		return RoundedDivide(_mm256_slli_epi32(n, Color::LumaNumeratorShift), rounding, Color::LumaDivisor);
+	}
+
+	// Fast tier: pmaddubsw on [R, G, B, G] byte pairs, then pmaddwd to add the two halves.
+	template<typename Color>
+	__m256i LumaFast8(__m256i pixels)
+	{
+		__m256i rgbg = _mm256_shuffle_epi8(
+			pixels,
+			_mm256_setr_epi8(
+				2, 1, 0, 1, 6, 5, 4, 5, 10, 9, 8, 9, 14, 13, 12, 13,
+				2, 1, 0, 1, 6, 5, 4, 5, 10, 9, 8, 9, 14, 13, 12, 13));
+		__m256i coefficients = _mm256_set1_epi32(
+			Color::FastYR | (Color::FastYGWithR << 8) | (Color::FastYB << 16) | (Color::FastYGWithB << 24));
+
+		__m256i n = _mm256_madd_epi16(_mm256_maddubs_epi16(rgbg, coefficients), _mm256_set1_epi16(1));
+		return _mm256_srai_epi32(_mm256_add_epi32(n, _mm256_set1_epi32(Color::FastLumaRounding)), FastShift);
+	}
+
+	// Sums each horizontal pixel pair of two rows: 8 pixels per row in, [B, G, R, A] words for 4 quads out.
+	__m256i QuadSums(__m256i row0, __m256i row1)
+	{
+		__m256i pairBytes = _mm256_setr_epi8(
+			0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15,
+			0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15);
+		__m256i ones = _mm256_set1_epi8(1);
+
+		return _mm256_add_epi16(
+			_mm256_maddubs_epi16(_mm256_shuffle_epi8(row0, pairBytes), ones),
+			_mm256_maddubs_epi16(_mm256_shuffle_epi8(row1, pairBytes), ones));
+	}
+
+	// One chroma component for 8 quads. Lane order comes out as quads [0 1 4 5 | 2 3 6 7].
+	template<typename Color>
+	__m256i ChromaComponent8(__m256i sumsA, __m256i sumsB, int32_t cb, int32_t cg, int32_t cr, __m256i rounding)
+	{
+		__m256i highCoefficients = WordQuad(HighPart(cb), HighPart(cg), HighPart(cr));
+		__m256i lowCoefficients = WordQuad(LowPart(cb), LowPart(cg), LowPart(cr));
+
+		__m256i high = _mm256_hadd_epi32(_mm256_madd_epi16(sumsA, highCoefficients), _mm256_madd_epi16(sumsB, highCoefficients));
+		__m256i low = _mm256_hadd_epi32(_mm256_madd_epi16(sumsA, lowCoefficients), _mm256_madd_epi16(sumsB, lowCoefficients));
+
+		__m256i n = _mm256_add_epi32(_mm256_slli_epi32(high, SplitShift), low);
+		return RoundedDivide(_mm256_slli_epi32(n, Color::ChromaNumeratorShift), rounding, Color::ChromaDivisor);
+	}
+
+	// Fast tier: rounds the quad average to 8 bits, then a single madd with the Q8 coefficients.
+	__m256i ChromaComponentFast8(__m256i averagesA, __m256i averagesB, int16_t cb, int16_t cg, int16_t cr, int32_t rounding)
+	{
+		__m256i coefficients = WordQuad(cb, cg, cr);
+		__m256i n = _mm256_hadd_epi32(_mm256_madd_epi16(averagesA, coefficients), _mm256_madd_epi16(averagesB, coefficients));
+		return _mm256_srai_epi32(_mm256_add_epi32(n, _mm256_set1_epi32(rounding)), FastShift);
+	}
+
+	__m256i QuadAverages(__m256i sums)
+	{
+		return _mm256_srli_epi16(_mm256_add_epi16(sums, _mm256_set1_epi16(2)), 2);
+	}
+
+	// U and V as int32 from the [B, G, R, A] sums of 8 quads, in the lane order of ChromaComponent8.
+	template<typename Color>
+	void ExactChroma8(__m256i sumsA, __m256i sumsB, __m256i rounding, __m256i* u, __m256i* v)
+	{
+		*u = ChromaComponent8<Color>(sumsA, sumsB, Color::UB, Color::UG, Color::UR, rounding);
+		*v = ChromaComponent8<Color>(sumsA, sumsB, Color::VB, Color::VG, Color::VR, rounding);
+	}
+
+	// Interleaved U/V as int16 from the [B, G, R, A] sums of 8 quads, in the lane order of ChromaComponent8.
+	// The fast tier ignores rounding.
+	template<typename Color, bool Fast>
+	__m256i QuadChroma8(__m256i sumsA, __m256i sumsB, __m256i rounding)
+	{
+		__m256i u;
+		__m256i v;
+		if (Fast)
+		{
+			__m256i averagesA = QuadAverages(sumsA);
+			__m256i averagesB = QuadAverages(sumsB);
+			u = ChromaComponentFast8(averagesA, averagesB, Color::FastUB, Color::FastUG, Color::FastUR, Color::FastChromaRounding);
+			v = ChromaComponentFast8(averagesA, averagesB, Color::FastVB, Color::FastVG, Color::FastVR, Color::FastChromaRounding);
+		}
+		else
+		{
+			ExactChroma8<Color>(sumsA, sumsB, rounding, &u, &v);
+		}
+
+		return _mm256_packs_epi32(_mm256_unpacklo_epi32(u, v), _mm256_unpackhi_epi32(u, v));
+	}
+
+	// OutputUV for 16 pixels of two rows: interleaved U/V as int16, laid out for PackToBytes-style fixup.
+	template<typename Color, bool Fast>
+	__m256i Chroma8(__m256i const* row0, __m256i const* row1, __m256i rounding)
+	{
+		return QuadChroma8<Color, Fast>(QuadSums(row0[0], row1[0]), QuadSums(row0[1], row1[1]), rounding);
+	}
+
+	// 4:4:4 chroma of 8 pixels, each taken as a quad of four copies of itself (see RowSpan). Unpacking the
+	// pixels to words puts them in the lane order QuadChroma8 undoes, so this comes out as interleaved U/V
+	// int16 in pixel order.
+	template<typename Color, bool Fast>
+	__m256i PixelChroma8(__m256i pixels, __m256i rounding)
+	{
+		__m256i zero = _mm256_setzero_si256();
+		return QuadChroma8<Color, Fast>(_mm256_slli_epi16(_mm256_unpacklo_epi8(pixels, zero), 2), _mm256_slli_epi16(_mm256_unpackhi_epi8(pixels, zero), 2), rounding);
+	}
+
+	template<typename Color, bool Fast>
+	__m256i LumaAny8(__m256i pixels, __m256i rounding)
+	{
+		return Fast ? LumaFast8<Color>(pixels) : Luma8<Color>(pixels, rounding);
+	}
+
+	// 32 luma bytes from 32 pixels.
+	template<typename Color, bool Fast>
+	__m256i Luma32(__m256i const* pixels, __m256i rounding)
+	{
+		return PackToBytes(
+			LumaAny8<Color, Fast>(pixels[0], rounding), LumaAny8<Color, Fast>(pixels[1], rounding),
+			LumaAny8<Color, Fast>(pixels[2], rounding), LumaAny8<Color, Fast>(pixels[3], rounding));
+	}
+
+	// 16 luma words from 16 pixels.
+	template<typename Color>
+	__m256i LumaWords16(__m256i const* pixels, __m256i rounding)
+	{
+		__m256i words = PackToWords<Color>(Luma8<Color>(pixels[0], rounding), Luma8<Color>(pixels[1], rounding));
+		return _mm256_permute4x64_epi64(words, _MM_SHUFFLE(3, 1, 2, 0));
+	}
+
+	// 32 alpha bytes from 32 pixels.
+	__m256i Alpha32(__m256i const* pixels)
+	{
+		return PackToBytes(
+			_mm256_srli_epi32(pixels[0], 24), _mm256_srli_epi32(pixels[1], 24),
+			_mm256_srli_epi32(pixels[2], 24), _mm256_srli_epi32(pixels[3], 24));
+	}
+
+	template<bool Stream>
+	void Store(uint8_t* dst, __m256i bytes)
+	{
+		if (Stream)
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(dst), bytes);
+		else
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), bytes);
+	}
+
+	template<bool Stream>
+	void StoreHalf(uint8_t* dst, __m128i bytes)
+	{
+		if (Stream)
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst), bytes);
+		else
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), bytes);
+	}
+
+	// [U0 V0 U1 V1 ...] bytes of 16 pairs split into 16 bytes of U, then 16 of V.
+	__m256i SplitChroma(__m256i uv)
+	{
+		__m256i split = _mm256_shuffle_epi8(uv, _mm256_setr_epi8(
+			0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15,
+			0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15));
+		return _mm256_permute4x64_epi64(split, _MM_SHUFFLE(3, 1, 2, 0));
+	}
+
+	// Chroma bytes [U0 V0 U1 V1 ...] of 16 pairs, as they are or split into 16 bytes each of U and V. x is
+	// the offset of the pairs in an interleaved chroma row; planar rows are half as wide.
+	template<bool Planar, bool Stream, typename Target>
+	void StoreChroma(Target const& dst, uint32_t x, __m256i uv)
+	{
+		if (Planar)
+		{
+			__m256i split = SplitChroma(uv);
+			StoreHalf<Stream>(dst.U + x / 2, _mm256_castsi256_si128(split));
+			StoreHalf<Stream>(dst.V + x / 2, _mm256_extracti128_si256(split, 1));
+		}
+		else
+		{
+			Store<Stream>(dst.UV + x, uv);
+		}
+	}
+
+	void Load32(uint8_t const* src, __m256i* pixels)
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			pixels[i] = Load(src + i * 32);
+		}
+	}
+
+	template<typename Color, bool Fast>
+	void LumaRowAvx2(uint8_t const* src, uint32_t srcWidth, uint8_t* dstY, uint32_t dstWidth)
+	{
+		__m256i rounding = LumaRounding<Color>(0, 0);
+		uint32_t x = 0;
+		for (; x + 32 <= srcWidth; x += 32)
+		{
+			__m256i pixels[4];
+			Load32(src + x * 4, pixels);
+			if constexpr (Color::SampleBits > 8)
+			{
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dstY + x * 2), LumaWords16<Color>(pixels, rounding));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dstY + x * 2 + 32), LumaWords16<Color>(pixels + 2, rounding));
+			}
+			else
+			{
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dstY + x), Luma32<Color, Fast>(pixels, rounding));
+			}
+		}
+
+		LumaSpan<Color, Fast>(src, srcWidth, dstY, x, dstWidth);
+	}
+
+	// One I400 row; see GreyRowSse41.
+	template<typename Color, bool Fast, bool Stream>
+	void GreyRowAvx2(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t dstWidth)
+	{
+		uint32_t x = 0;
+		if (Stream)
+		{
+			if (!GetPackedStreamingHead(dst.Y, 32, dstWidth, &x, 1))
+			{
+				GreyRowAvx2<Color, Fast, false>(src, srcWidth, dst, dstWidth);
+				return;
+			}
+
+			GreyRowSpan<Color, Fast>(src, srcWidth, dst, 0, x);
+		}
+
+		__m256i rounding = LumaRounding<Color>(dst.Left + x, dst.Top);
+		for (; x + 32 <= srcWidth; x += 32)
+		{
+			if (Stream)
+			{
+				for (uint32_t line = 0; line < 128; line += 64)
+				{
+					_mm_prefetch(reinterpret_cast<char const*>(src + x * 4 + PrefetchDistance + line), _MM_HINT_T0);
+				}
+			}
+
+			__m256i pixels[4];
+			Load32(src + x * 4, pixels);
+			Store<Stream>(dst.Y + x, Luma32<Color, Fast>(pixels, rounding));
+		}
+
+		GreyRowSpan<Color, Fast>(src, srcWidth, dst, x, dstWidth);
+
+		if (Stream)
+			_mm_sfence();
+	}
+
+	// Every source pixel is loaded once and feeds its luma value, its chroma quad and, with Alpha, the alpha
+	// rows.
+	template<typename Color, bool Fast, bool Planar, bool Alpha, bool Stream>
+	void RowPairAvx2(uint8_t const* src0, uint8_t const* src1, uint32_t srcWidth, CpuKernels::RowPairTarget const& dst, uint32_t dstWidth)
+	{
+		uint32_t x = 0;
+		if (Stream)
+		{
+			if (!GetStreamingHead(dst, Planar, Alpha, 32, dstWidth, &x))
+			{
+				RowPairAvx2<Color, Fast, Planar, Alpha, false>(src0, src1, srcWidth, dst, dstWidth);
+				return;
+			}
+
+			RowPairSpan<Color, Fast, Planar, Alpha>(src0, src1, srcWidth, dst, 0, x);
+		}
+
+		__m256i luma0 = LumaRounding<Color>(dst.Left + x, dst.Top);
+		__m256i luma1 = LumaRounding<Color>(dst.Left + x, dst.Top + 1);
+		__m256i chroma = ChromaRounding<Color, false>((dst.Left + x) / 2, dst.Top / 2);
+		for (; x + 32 <= srcWidth; x += 32)
+		{
+			if (Stream)
+			{
+				for (uint32_t line = 0; line < 128; line += 64)
+				{
+					_mm_prefetch(reinterpret_cast<char const*>(src0 + x * 4 + PrefetchDistance + line), _MM_HINT_T0);
+					_mm_prefetch(reinterpret_cast<char const*>(src1 + x * 4 + PrefetchDistance + line), _MM_HINT_T0);
+				}
+			}
+
+			__m256i row0[4];
+			__m256i row1[4];
+			Load32(src0 + x * 4, row0);
+			Load32(src1 + x * 4, row1);
+
+			Store<Stream>(dst.Y0 + x, Luma32<Color, Fast>(row0, luma0));
+			Store<Stream>(dst.Y1 + x, Luma32<Color, Fast>(row1, luma1));
+
+			__m256i a = Chroma8<Color, Fast>(row0, row1, chroma);
+			__m256i b = Chroma8<Color, Fast>(row0 + 2, row1 + 2, chroma);
+			StoreChroma<Planar, Stream>(dst, x, _mm256_permutevar8x32_epi32(_mm256_packus_epi16(a, b), _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7)));
+
+			if (Alpha)
+			{
+				Store<Stream>(dst.A0 + x, Alpha32(row0));
+				Store<Stream>(dst.A1 + x, Alpha32(row1));
+			}
+		}
+
+		RowPairSpan<Color, Fast, Planar, Alpha>(src0, src1, srcWidth, dst, x, dstWidth);
+
+		// Non-temporal stores are weakly ordered; fence them before the caller signals completion.
+		if (Stream)
+			_mm_sfence();
+	}
+
+	// RowPairAvx2 for 16-bit samples, always exact: luma and chroma stay int32 until PackToWords, so every
+	// vector of pixels fills twice the bytes.
+	template<typename Color, bool Planar, bool Stream>
+	void RowPairWideAvx2(uint8_t const* src0, uint8_t const* src1, uint32_t srcWidth, CpuKernels::RowPairTarget const& dst, uint32_t dstWidth)
+	{
+		uint32_t x = 0;
+		if (Stream)
+		{
+			if (!GetStreamingHead(dst, Planar, false, 32, dstWidth, &x, 2))
+			{
+				RowPairWideAvx2<Color, Planar, false>(src0, src1, srcWidth, dst, dstWidth);
+				return;
+			}
+
+			RowPairSpan<Color, false, Planar, false>(src0, src1, srcWidth, dst, 0, x);
+		}
+
+		__m256i luma0 = LumaRounding<Color>(dst.Left + x, dst.Top);
+		__m256i luma1 = LumaRounding<Color>(dst.Left + x, dst.Top + 1);
+		__m256i chroma = ChromaRounding<Color, false>((dst.Left + x) / 2, dst.Top / 2);
+		for (; x + 32 <= srcWidth; x += 32)
+		{
+			if (Stream)
+			{
+				for (uint32_t line = 0; line < 128; line += 64)
+				{
+					_mm_prefetch(reinterpret_cast<char const*>(src0 + x * 4 + PrefetchDistance + line), _MM_HINT_T0);
+					_mm_prefetch(reinterpret_cast<char const*>(src1 + x * 4 + PrefetchDistance + line), _MM_HINT_T0);
+				}
+			}
+
+			__m256i row0[4];
+			__m256i row1[4];
+			Load32(src0 + x * 4, row0);
+			Load32(src1 + x * 4, row1);
+
+			Store<Stream>(dst.Y0 + x * 2, LumaWords16<Color>(row0, luma0));
+			Store<Stream>(dst.Y0 + x * 2 + 32, LumaWords16<Color>(row0 + 2, luma0));
+			Store<Stream>(dst.Y1 + x * 2, LumaWords16<Color>(row1, luma1));
+			Store<Stream>(dst.Y1 + x * 2 + 32, LumaWords16<Color>(row1 + 2, luma1));
+
+			// Quads [0 1 4 5 | 2 3 6 7] in A, 8 more in B.
+			__m256i uA;
+			__m256i vA;
+			__m256i uB;
+			__m256i vB;
+			ExactChroma8<Color>(QuadSums(row0[0], row1[0]), QuadSums(row0[1], row1[1]), chroma, &uA, &vA);
+			ExactChroma8<Color>(QuadSums(row0[2], row1[2]), QuadSums(row0[3], row1[3]), chroma, &uB, &vB);
+			if (Planar)
+			{
+				// Word pairs [0 4 8 12 | 2 6 10 14] after packing.
+				__m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+				Store<Stream>(dst.U + x, _mm256_permutevar8x32_epi32(PackToWords<Color>(uA, uB), order));
+				Store<Stream>(dst.V + x, _mm256_permutevar8x32_epi32(PackToWords<Color>(vA, vB), order));
+			}
+			else
+			{
+				// U/V pairs of quads [0 1 4 5 | 2 3 6 7] after packing.
+				__m256i a = PackToWords<Color>(_mm256_unpacklo_epi32(uA, vA), _mm256_unpackhi_epi32(uA, vA));
+				__m256i b = PackToWords<Color>(_mm256_unpacklo_epi32(uB, vB), _mm256_unpackhi_epi32(uB, vB));
+				Store<Stream>(dst.UV + x * 2, _mm256_permute4x64_epi64(a, _MM_SHUFFLE(3, 1, 2, 0)));
+				Store<Stream>(dst.UV + x * 2 + 32, _mm256_permute4x64_epi64(b, _MM_SHUFFLE(3, 1, 2, 0)));
+			}
+		}
+
+		RowPairSpan<Color, false, Planar, false>(src0, src1, srcWidth, dst, x, dstWidth);
+
+		if (Stream)
+			_mm_sfence();
+	}
+
+	// One packed 4:2:2 row. The chroma of a pixel pair is Chroma8 with the row passed as both rows (see
+	// PackedRowSpan), and interleaving it bytewise with the luma gives YUY2 or UYVY order directly.
+	template<typename Color, bool Fast, bool Uyvy, bool Stream>
+	void PackedRowAvx2(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t dstWidth)
+	{
+		uint32_t x = 0;
+		if (Stream)
+		{
+			if (!GetPackedStreamingHead(dst.Y, 32, dstWidth, &x))
+			{
+				PackedRowAvx2<Color, Fast, Uyvy, false>(src, srcWidth, dst, dstWidth);
+				return;
+			}
+
+			PackedRowSpan<Color, Fast, Uyvy>(src, srcWidth, dst, 0, x);
+		}
+
+		__m256i lumaRounding = LumaRounding<Color>(dst.Left + x, dst.Top);
+		__m256i chromaRounding = ChromaRounding<Color, false>((dst.Left + x) / 2, dst.Top);
+		for (; x + 32 <= srcWidth; x += 32)
+		{
+			if (Stream)
+			{
+				for (uint32_t line = 0; line < 128; line += 64)
+				{
+					_mm_prefetch(reinterpret_cast<char const*>(src + x * 4 + PrefetchDistance + line), _MM_HINT_T0);
+				}
+			}
+
+			__m256i pixels[4];
+			Load32(src + x * 4, pixels);
+
+			__m256i luma = Luma32<Color, Fast>(pixels, lumaRounding);
+			__m256i a = Chroma8<Color, Fast>(pixels, pixels, chromaRounding);
+			__m256i b = Chroma8<Color, Fast>(pixels + 2, pixels + 2, chromaRounding);
+			__m256i chroma = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(a, b), _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+
+			// Pixels [0, 8) and [16, 24) in low, [8, 16) and [24, 32) in high.
+			__m256i low = Uyvy ? _mm256_unpacklo_epi8(chroma, luma) : _mm256_unpacklo_epi8(luma, chroma);
+			__m256i high = Uyvy ? _mm256_unpackhi_epi8(chroma, luma) : _mm256_unpackhi_epi8(luma, chroma);
+			Store<Stream>(dst.Y + x * 2, _mm256_permute2x128_si256(low, high, 0x20));
+			Store<Stream>(dst.Y + x * 2 + 32, _mm256_permute2x128_si256(low, high, 0x31));
+		}
+
+		PackedRowSpan<Color, Fast, Uyvy>(src, srcWidth, dst, x, dstWidth);
+
+		if (Stream)
+			_mm_sfence();
+	}
+
+	// One row of 4:2:2 or 4:4:4 (FullChroma) luma and chroma; see RowSpan.
+	template<typename Color, bool Fast, bool Planar, bool FullChroma, bool Stream>
+	void RowAvx2(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t dstWidth)
+	{
+		uint32_t x = 0;
+		if (Stream)
+		{
+			if (!GetRowStreamingHead(dst, Planar, FullChroma, 32, dstWidth, &x))
+			{
+				RowAvx2<Color, Fast, Planar, FullChroma, false>(src, srcWidth, dst, dstWidth);
+				return;
+			}
+
+			RowSpan<Color, Fast, Planar, FullChroma>(src, srcWidth, dst, 0, x);
+		}
+
+		__m256i lumaRounding = LumaRounding<Color>(dst.Left + x, dst.Top);
+		__m256i chromaRounding = ChromaRounding<Color, FullChroma>(FullChroma ? dst.Left + x : (dst.Left + x) / 2, dst.Top);
+		for (; x + 32 <= srcWidth; x += 32)
+		{
+			if (Stream)
+			{
+				for (uint32_t line = 0; line < 128; line += 64)
+				{
+					_mm_prefetch(reinterpret_cast<char const*>(src + x * 4 + PrefetchDistance + line), _MM_HINT_T0);
+				}
+			}
+
+			__m256i pixels[4];
+			Load32(src + x * 4, pixels);
+
+			Store<Stream>(dst.Y + x, Luma32<Color, Fast>(pixels, lumaRounding));
+
+			if (FullChroma)
+			{
+				// 32 pairs, 16 per vector once the 64-bit blocks are in order.
+				__m256i a = _mm256_packus_epi16(PixelChroma8<Color, Fast>(pixels[0], chromaRounding), PixelChroma8<Color, Fast>(pixels[1], chromaRounding));
+				__m256i b = _mm256_packus_epi16(PixelChroma8<Color, Fast>(pixels[2], chromaRounding), PixelChroma8<Color, Fast>(pixels[3], chromaRounding));
+				a = _mm256_permute4x64_epi64(a, _MM_SHUFFLE(3, 1, 2, 0));
+				b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(3, 1, 2, 0));
+				if (Planar)
+				{
+					a = SplitChroma(a);
+					b = SplitChroma(b);
+					Store<Stream>(dst.U + x, _mm256_permute2x128_si256(a, b, 0x20));
+					Store<Stream>(dst.V + x, _mm256_permute2x128_si256(a, b, 0x31));
+				}
+				else
+				{
+					Store<Stream>(dst.UV + x * 2, a);
+					Store<Stream>(dst.UV + x * 2 + 32, b);
+				}
+			}
+			else
+			{
+				__m256i a = Chroma8<Color, Fast>(pixels, pixels, chromaRounding);
+				__m256i b = Chroma8<Color, Fast>(pixels + 2, pixels + 2, chromaRounding);
+				StoreChroma<Planar, Stream>(dst, x, _mm256_permutevar8x32_epi32(_mm256_packus_epi16(a, b), _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7)));
+			}
+		}
+
+		RowSpan<Color, Fast, Planar, FullChroma>(src, srcWidth, dst, x, dstWidth);
+
+		if (Stream)
+			_mm_sfence();
+	}
+
+	// One AYUV row; see AyuvRowSpan and AyuvRowSse41.
+	template<typename Color, bool Fast, bool Stream>
+	void AyuvRowAvx2(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t dstWidth)
+	{
+		uint32_t x = 0;
+		if (Stream)
+		{
+			if (!GetPackedStreamingHead(dst.Y, 32, dstWidth, &x, 4))
+			{
+				AyuvRowAvx2<Color, Fast, false>(src, srcWidth, dst, dstWidth);
+				return;
+			}
+
+			AyuvRowSpan<Color, Fast>(src, srcWidth, dst, 0, x);
+		}
+
+		__m256i lumaRounding = LumaRounding<Color>(dst.Left + x, dst.Top);
+		__m256i chromaRounding = ChromaRounding<Color, true>(dst.Left + x, dst.Top);
+		for (; x + 32 <= srcWidth; x += 32)
+		{
+			if (Stream)
+			{
+				for (uint32_t line = 0; line < 128; line += 64)
+				{
+					_mm_prefetch(reinterpret_cast<char const*>(src + x * 4 + PrefetchDistance + line), _MM_HINT_T0);
+				}
+			}
+
+			__m256i pixels[4];
+			Load32(src + x * 4, pixels);
+
+			// [Y A] pairs of pixels [0, 16) and [16, 32), in order.
+			__m256i luma = Luma32<Color, Fast>(pixels, lumaRounding);
+			__m256i alpha = Alpha32(pixels);
+			__m256i low = _mm256_unpacklo_epi8(luma, alpha);
+			__m256i high = _mm256_unpackhi_epi8(luma, alpha);
+			__m256i lumaAlpha[2] = { _mm256_permute2x128_si256(low, high, 0x20), _mm256_permute2x128_si256(low, high, 0x31) };
+
+			// [V U] pairs of the same pixels, as in RowAvx2.
+			__m256i chroma[2] =
+			{
+				_mm256_packus_epi16(PixelChroma8<Color, Fast>(pixels[0], chromaRounding), PixelChroma8<Color, Fast>(pixels[1], chromaRounding)),
+				_mm256_packus_epi16(PixelChroma8<Color, Fast>(pixels[2], chromaRounding), PixelChroma8<Color, Fast>(pixels[3], chromaRounding)),
+			};
+
+			for (int i = 0; i < 2; ++i)
+			{
+				// Pixels [0, 4) and [8, 12) of the 16 in first, [4, 8) and [12, 16) in second.
+				__m256i ordered = _mm256_permute4x64_epi64(chroma[i], _MM_SHUFFLE(3, 1, 2, 0));
+				__m256i first = _mm256_unpacklo_epi16(ordered, lumaAlpha[i]);
+				__m256i second = _mm256_unpackhi_epi16(ordered, lumaAlpha[i]);
+
+				uint8_t* out = dst.Y + (x + i * 16) * 4;
+				Store<Stream>(out, _mm256_permute2x128_si256(first, second, 0x20));
+				Store<Stream>(out + 32, _mm256_permute2x128_si256(first, second, 0x31));
+			}
+		}
+
+		AyuvRowSpan<Color, Fast>(src, srcWidth, dst, x, dstWidth);
+
+		if (Stream)
+			_mm_sfence();
+	}
+
+	// YCoCg-R of 8 pixels, one int32 per lane; see YCoCg.
+	template<bool SwapRB>
+	void YCoCg8(__m256i pixels, __m256i* y, __m256i* co, __m256i* cg)
+	{
+		__m256i mask = _mm256_set1_epi32(0xFF);
+		__m256i low = _mm256_and_si256(pixels, mask);
+		__m256i g = _mm256_and_si256(_mm256_srli_epi32(pixels, 8), mask);
+		__m256i high = _mm256_and_si256(_mm256_srli_epi32(pixels, 16), mask);
+		__m256i r = SwapRB ? low : high;
+		__m256i b = SwapRB ? high : low;
+
+		*co = _mm256_sub_epi32(r, b);
+		__m256i t = _mm256_add_epi32(b, _mm256_srai_epi32(*co, 1));
+		*cg = _mm256_sub_epi32(g, t);
+		*y = _mm256_add_epi32(t, _mm256_srai_epi32(*cg, 1));
+	}
+
+	// 16 words in order from two vectors of 8 int32; packs works within 128-bit lanes.
+	__m256i PackWords(__m256i q0, __m256i q1)
+	{
+		return _mm256_permute4x64_epi64(_mm256_packs_epi32(q0, q1), _MM_SHUFFLE(3, 1, 2, 0));
+	}
+
+	template<bool SwapRB>
+	void YCoCgLumaRowAvx2(uint8_t const* src, uint32_t srcWidth, uint8_t* dstY, uint32_t dstWidth)
+	{
+		uint32_t x = 0;
+		for (; x + 16 <= srcWidth; x += 16)
+		{
+			__m256i y[2];
+			__m256i co[2];
+			__m256i cg[2];
+			YCoCg8<SwapRB>(Load(src + x * 4), &y[0], &co[0], &cg[0]);
+			YCoCg8<SwapRB>(Load(src + x * 4 + 32), &y[1], &co[1], &cg[1]);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dstY + x * 2), PackWords(y[0], y[1]));
+		}
+
+		YCoCgLumaSpan<SwapRB>(src, srcWidth, dstY, x, dstWidth);
+	}
+
+	// One YCoCg-R 4:4:4 row; see YCoCgRowSpan. 16 pixels fill 32 bytes of each plane.
+	template<bool SwapRB, bool Stream>
+	void YCoCgRowAvx2(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t dstWidth)
+	{
+		uint32_t x = 0;
+		if (Stream)
+		{
+			uint8_t* luma[] = { dst.Y };
+			uint8_t* chroma[] = { dst.U, dst.V };
+			if (!GetYCoCgStreamingHead(luma, 1, chroma, 2, false, 32, dstWidth, &x))
+			{
+				YCoCgRowAvx2<SwapRB, false>(src, srcWidth, dst, dstWidth);
+				return;
+			}
+
+			YCoCgRowSpan<SwapRB>(src, srcWidth, dst, 0, x);
+		}
+
+		for (; x + 16 <= srcWidth; x += 16)
+		{
+			if (Stream)
+				_mm_prefetch(reinterpret_cast<char const*>(src + x * 4 + PrefetchDistance), _MM_HINT_T0);
+
+			__m256i y[2];
+			__m256i co[2];
+			__m256i cg[2];
+			YCoCg8<SwapRB>(Load(src + x * 4), &y[0], &co[0], &cg[0]);
+			YCoCg8<SwapRB>(Load(src + x * 4 + 32), &y[1], &co[1], &cg[1]);
+			Store<Stream>(dst.Y + x * 2, PackWords(y[0], y[1]));
+			Store<Stream>(dst.U + x * 2, PackWords(co[0], co[1]));
+			Store<Stream>(dst.V + x * 2, PackWords(cg[0], cg[1]));
+		}
+
+		YCoCgRowSpan<SwapRB>(src, srcWidth, dst, x, dstWidth);
+
+		if (Stream)
+			_mm_sfence();
+	}
+
+	// Rounded averages of the 2x2 blocks of 32 pixels as 16 words in order, from the vertical sums of each
+	// vector of 8. hadd leaves the blocks of a pair of vectors in the order [0 1 4 5 | 2 3 6 7], and one
+	// dword permute after packing puts both pairs right.
+	__m256i YCoCgQuadAverages(__m256i const* sums)
+	{
+		__m256i two = _mm256_set1_epi32(2);
+		__m256i a = _mm256_srai_epi32(_mm256_add_epi32(_mm256_hadd_epi32(sums[0], sums[1]), two), 2);
+		__m256i b = _mm256_srai_epi32(_mm256_add_epi32(_mm256_hadd_epi32(sums[2], sums[3]), two), 2);
+		return _mm256_permutevar8x32_epi32(_mm256_packs_epi32(a, b), _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+	}
+
+	// One YCoCg-R 4:2:0 row pair; see YCoCgRowPairSpan. 32 pixels fill 64 bytes of each luma row and 32 of
+	// each chroma row.
+	template<bool SwapRB, bool Stream>
+	void YCoCgRowPairAvx2(uint8_t const* src0, uint8_t const* src1, uint32_t srcWidth, CpuKernels::RowPairTarget const& dst, uint32_t dstWidth)
+	{
+		uint32_t x = 0;
+		if (Stream)
+		{
+			uint8_t* luma[] = { dst.Y0, dst.Y1 };
+			uint8_t* chroma[] = { dst.U, dst.V };
+			if (!GetYCoCgStreamingHead(luma, 2, chroma, 2, true, 32, dstWidth, &x))
+			{
+				YCoCgRowPairAvx2<SwapRB, false>(src0, src1, srcWidth, dst, dstWidth);
+				return;
+			}
+
+			YCoCgRowPairSpan<SwapRB>(src0, src1, srcWidth, dst, 0, x);
+		}
+
+		for (; x + 32 <= srcWidth; x += 32)
+		{
+			if (Stream)
+			{
+				for (uint32_t line = 0; line < 128; line += 64)
+				{
+					_mm_prefetch(reinterpret_cast<char const*>(src0 + x * 4 + PrefetchDistance + line), _MM_HINT_T0);
+					_mm_prefetch(reinterpret_cast<char const*>(src1 + x * 4 + PrefetchDistance + line), _MM_HINT_T0);
+				}
+			}
+
+			__m256i y[2][4];
+			__m256i coSums[4];
+			__m256i cgSums[4];
+			for (int i = 0; i < 4; ++i)
+			{
+				__m256i co[2];
+				__m256i cg[2];
+				YCoCg8<SwapRB>(Load(src0 + x * 4 + i * 32), &y[0][i], &co[0], &cg[0]);
+				YCoCg8<SwapRB>(Load(src1 + x * 4 + i * 32), &y[1][i], &co[1], &cg[1]);
+				coSums[i] = _mm256_add_epi32(co[0], co[1]);
+				cgSums[i] = _mm256_add_epi32(cg[0], cg[1]);
+			}
+
+			Store<Stream>(dst.Y0 + x * 2, PackWords(y[0][0], y[0][1]));
+			Store<Stream>(dst.Y0 + x * 2 + 32, PackWords(y[0][2], y[0][3]));
+			Store<Stream>(dst.Y1 + x * 2, PackWords(y[1][0], y[1][1]));
+			Store<Stream>(dst.Y1 + x * 2 + 32, PackWords(y[1][2], y[1][3]));
+			Store<Stream>(dst.U + x, YCoCgQuadAverages(coSums));
+			Store<Stream>(dst.V + x, YCoCgQuadAverages(cgSums));
+		}
+
+		YCoCgRowPairSpan<SwapRB>(src0, src1, srcWidth, dst, x, dstWidth);
+
+		if (Stream)
+			_mm_sfence();
+	}
+
+	// One row back from YCoCg-R; see YCoCgInverseSpan and YCoCgInverseRowSse41. 16 pixels per iteration.
+	template<bool SwapRB, bool Subsampled>
+	void YCoCgInverseRowAvx2(CpuKernels::InverseRowSource const& src, uint8_t* dst, uint32_t width)
+	{
+		uint32_t x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			__m256i co;
+			__m256i cg;
+			if (Subsampled)
+			{
+				__m128i co8 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src.U + x));
+				__m128i cg8 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src.V + x));
+				co = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16(co8, co8)), _mm_unpackhi_epi16(co8, co8), 1);
+				cg = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16(cg8, cg8)), _mm_unpackhi_epi16(cg8, cg8), 1);
+			}
+			else
+			{
+				co = Load(src.U + x * 2);
+				cg = Load(src.V + x * 2);
+			}
+
+			__m256i y = Load(src.Y + x * 2);
+			__m256i t = _mm256_sub_epi16(y, _mm256_srai_epi16(cg, 1));
+			__m256i g = _mm256_add_epi16(cg, t);
+			__m256i b = _mm256_sub_epi16(t, _mm256_srai_epi16(co, 1));
+			__m256i r = _mm256_add_epi16(b, co);
+
+			// Pixels [0, 4) and [8, 12) in low, [4, 8) and [12, 16) in high.
+			__m256i outer = _mm256_packus_epi16(SwapRB ? r : b, SwapRB ? b : r);
+			__m256i inner = _mm256_packus_epi16(g, _mm256_set1_epi16(255));
+			__m256i first = _mm256_unpacklo_epi8(outer, inner);
+			__m256i second = _mm256_unpackhi_epi8(outer, inner);
+			__m256i low = _mm256_unpacklo_epi16(first, second);
+			__m256i high = _mm256_unpackhi_epi16(first, second);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), _mm256_permute2x128_si256(low, high, 0x20));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4 + 32), _mm256_permute2x128_si256(low, high, 0x31));
+		}
+
+		YCoCgInverseSpan<SwapRB, Subsampled>(src, dst, x, width);
+	}
+
+	// Tensor rows, one gather of 8 floats per iteration; doubled rows write each twice.
+	template<bool Doubled>
+	void TensorRowFloat32Avx2(uint8_t const* codes, void const* table, void* dst, uint32_t count)
+	{
+		float const* elements = static_cast<float const*>(table);
+		float* row = static_cast<float*>(dst);
+		uint32_t const step = Doubled ? 16 : 8;
+		uint32_t i = 0;
+		for (; i + step <= count; i += step)
+		{
+			__m128i eight = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(codes + (Doubled ? i / 2 : i)));
+			__m256 values = _mm256_i32gather_ps(elements, _mm256_cvtepu8_epi32(eight), 4);
+			if (Doubled)
+			{
+				__m256 low = _mm256_unpacklo_ps(values, values);
+				__m256 high = _mm256_unpackhi_ps(values, values);
+				_mm256_storeu_ps(row + i, _mm256_permute2f128_ps(low, high, 0x20));
+				_mm256_storeu_ps(row + i + 8, _mm256_permute2f128_ps(low, high, 0x31));
+			}
+			else
+			{
+				_mm256_storeu_ps(row + i, values);
+			}
+		}
+
+		TensorSpan<float, Doubled>(codes, table, dst, i, count);
+	}
+
+	// The same for binary16 elements. Each lane gathers 32 bits at the element, which the table padding
+	// covers for the last code, and keeps the low half: 16 elements from two gathers, or 16 doubled ones
+	// from one.
+	template<bool Doubled>
+	void TensorRowFloat16Avx2(uint8_t const* codes, void const* table, void* dst, uint32_t count)
+	{
+		int const* elements = static_cast<int const*>(table);
+		uint16_t* row = static_cast<uint16_t*>(dst);
+		__m256i const lowHalves = _mm256_set1_epi32(0xFFFF);
+		uint32_t i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			if (Doubled)
+			{
+				__m128i eight = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(codes + i / 2));
+				__m256i values = _mm256_and_si256(_mm256_i32gather_epi32(elements, _mm256_cvtepu8_epi32(eight), 2), lowHalves);
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(row + i), _mm256_or_si256(values, _mm256_slli_epi32(values, 16)));
+			}
+			else
+			{
+				__m128i sixteen = _mm_loadu_si128(reinterpret_cast<__m128i const*>(codes + i));
+				__m256i first = _mm256_i32gather_epi32(elements, _mm256_cvtepu8_epi32(sixteen), 2);
+				__m256i second = _mm256_i32gather_epi32(elements, _mm256_cvtepu8_epi32(_mm_srli_si128(sixteen, 8)), 2);
+				__m256i packed = _mm256_packus_epi32(_mm256_and_si256(first, lowHalves), _mm256_and_si256(second, lowHalves));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(row + i), _mm256_permute4x64_epi64(packed, 0xD8));
+			}
+		}
+
+		TensorSpan<uint16_t, Doubled>(codes, table, dst, i, count);
+	}
+
+	template<typename Color, bool Fast, KernelStore Store>
+	constexpr CpuKernels::RowKernels MakeAvx2Kernels()
+	{
+		constexpr bool planar = IsPlanarStore(Store);
+		if constexpr (Store == KernelStore::YCoCg444)
+		{
+			constexpr bool swap = Color::SwapRB;
+			return { YCoCgLumaRowAvx2<swap>, nullptr, nullptr, YCoCgRowAvx2<swap, false>, YCoCgRowAvx2<swap, true>, YCoCgInverseRowAvx2<swap, false> };
+		}
+		else if constexpr (Store == KernelStore::YCoCg420)
+		{
+			constexpr bool swap = Color::SwapRB;
+			return { YCoCgLumaRowAvx2<swap>, YCoCgRowPairAvx2<swap, false>, YCoCgRowPairAvx2<swap, true>, nullptr, nullptr, YCoCgInverseRowAvx2<swap, true> };
+		}
+		else if constexpr (IsWideStore(Store))
+		{
+			return { LumaRowAvx2<Color, false>, RowPairWideAvx2<Color, planar, false>, RowPairWideAvx2<Color, planar, true>, nullptr, nullptr, nullptr };
+		}
+		else if constexpr (Store == KernelStore::Ayuv)
+		{
+			return { LumaRowAvx2<Color, Fast>, nullptr, nullptr, AyuvRowAvx2<Color, Fast, false>, AyuvRowAvx2<Color, Fast, true>, nullptr };
+		}
+		else if constexpr (Store == KernelStore::Grey)
+		{
+			return { LumaRowAvx2<Color, Fast>, nullptr, nullptr, GreyRowAvx2<Color, Fast, false>, GreyRowAvx2<Color, Fast, true>, nullptr };
+		}
+		else if constexpr (IsPackedStore(Store))
+		{
+			constexpr bool uyvy = Store == KernelStore::Uyvy;
+			return { LumaRowAvx2<Color, Fast>, nullptr, nullptr, PackedRowAvx2<Color, Fast, uyvy, false>, PackedRowAvx2<Color, Fast, uyvy, true>, nullptr };
+		}
+		else if constexpr (IsRowStore(Store))
+		{
+			constexpr bool full = IsFullChromaStore(Store);
+			return { LumaRowAvx2<Color, Fast>, nullptr, nullptr, RowAvx2<Color, Fast, planar, full, false>, RowAvx2<Color, Fast, planar, full, true>, nullptr };
+		}
+		else
+		{
+			constexpr bool alpha = Store == KernelStore::InterleavedAlpha;
+			return { LumaRowAvx2<Color, Fast>, RowPairAvx2<Color, Fast, planar, alpha, false>, RowPairAvx2<Color, Fast, planar, alpha, true>, nullptr, nullptr, nullptr };
+		}
+	}
+
+	template<typename Color, KernelStore Store>
+	struct Avx2Family
+	{
+		static constexpr CpuKernels::RowKernels BitExact = MakeAvx2Kernels<Color, false, Store>();
+		static constexpr CpuKernels::RowKernels Fast = MakeAvx2Kernels<Color, true, Store>();
+		static constexpr CpuKernels::RowKernels Dithered = MakeAvx2Kernels<DitheredColor<Color>, false, Store>();
+	};
+}
+
+namespace CpuKernels
+{
+	KernelTable const Avx2Kernels =
+	{
+		"avx2",
+		KernelRegistry<Avx2Family>::Entries,
+		KernelRegistry<Avx2Family>::EntryCount,
+		{ TensorRowFloat32Avx2<false>, TensorRowFloat32Avx2<true>, TensorRowFloat16Avx2<false>, TensorRowFloat16Avx2<true> },
+	};
+}
@@ -0,0 +1,15 @@
+// CpuKernelsAvx512.cpp: The AVX-512BW kernel table. Built with AVX-512F/BW/VL code generation and nothing
+// more, so it runs on hosts without VNNI; only call through Avx512Kernels.
+
+#include "CpuKernelsAvx512.h"
+
+namespace CpuKernels
+{
+	KernelTable const Avx512Kernels =
+	{
+		"avx512",
+		KernelRegistry<Avx512Families<false>::Family>::Entries,
+		KernelRegistry<Avx512Families<false>::Family>::EntryCount,
+		{ TensorRowFloat32Avx512<false>, TensorRowFloat32Avx512<true>, TensorRowFloat16Avx512<false>, TensorRowFloat16Avx512<true> },
+	};
+}
@@ -0,0 +1,1122 @@
+#pragma once
+
+// AVX-512BW row kernels, 64 pixels per iteration, with a VNNI variant. Only CpuKernelsAvx512.cpp and
+// CpuKernelsAvx512Vnni.cpp include this, each with its own code generation flags, so the plain table never
+// contains an instruction from VNNI: every VNNI path is behind if constexpr on the Vnni parameter.
+//
+// Row tails use mask registers instead of a scalar epilogue. Lanes past the end of the source row are
+// filled with the last source pixel by the masked load itself, which also produces the padding column
+// of odd-width images without a separate pass.
+
+#include "CpuKernels.h"
+#include "CpuKernelRegistry.h"
+
+#include <immintrin.h>
+
+using namespace Rgb2YuvMath;
+
+namespace
+{
+	__m512i WordPair(int16_t low, int16_t high)
+	{
+		return _mm512_set1_epi32(static_cast<int32_t>((static_cast<uint32_t>(static_cast<uint16_t>(high)) << 16) | static_cast<uint16_t>(low)));
+	}
+
+	// Byte operands for vpdpbusd against B8G8R8A8 pixels.
+	__m512i ByteQuad(int8_t b, int8_t g, int8_t r)
+	{
+		return _mm512_set1_epi32(static_cast<int32_t>(
+			static_cast<uint32_t>(static_cast<uint8_t>(b)) |
+			(static_cast<uint32_t>(static_cast<uint8_t>(g)) << 8) |
+			(static_cast<uint32_t>(static_cast<uint8_t>(r)) << 16)));
+	}
+
+	__mmask16 PixelMask(int32_t remaining)
+	{
+		if (remaining >= 16)
+			return 0xFFFF;
+		if (remaining <= 0)
+			return 0;
+		return static_cast<__mmask16>((1u << remaining) - 1);
+	}
+
+	// The same for 32 word lanes.
+	__mmask32 WordMask(int32_t remaining)
+	{
+		return _mm512_kunpackw(PixelMask(remaining - 16), PixelMask(remaining));
+	}
+
+	// 16 pixels; lanes past the row end get the replicated edge pixel.
+	__m512i LoadPixels(uint8_t const* src, int32_t remaining, __m512i edge)
+	{
+		return _mm512_mask_loadu_epi32(edge, PixelMask(remaining), src);
+	}
+
+	// Same as the AVX2 version: float estimate, then an exact remainder correction.
+	__m512i RoundedDivide(__m512i n, __m512i rounding, int32_t denominator)
+	{
+		__m512i d = _mm512_set1_epi32(denominator);
+		n = _mm512_add_epi32(n, rounding);
+
+		__m512i q = _mm512_cvttps_epi32(_mm512_mul_ps(_mm512_cvtepi32_ps(n), _mm512_set1_ps(1.0f / denominator)));
+		__m512i r = _mm512_sub_epi32(n, _mm512_mullo_epi32(q, d));
+
+		q = _mm512_mask_sub_epi32(q, _mm512_cmplt_epi32_mask(r, _mm512_setzero_si512()), q, _mm512_set1_epi32(1));
+		q = _mm512_mask_add_epi32(q, _mm512_cmpge_epi32_mask(r, d), q, _mm512_set1_epi32(1));
+		return q;
+	}
+
+	// Saturates 16 int32 results to [0, 255] bytes, in order.
+	__m128i PackToBytes(__m512i q)
+	{
+		return _mm512_cvtusepi32_epi8(_mm512_max_epi32(q, _mm512_setzero_si512()));
+	}
+
+	// Packs 4x16 int32 results into 64 bytes in order, saturating to [0, 255]. The packs work within 128-bit
+	// lanes, which leaves lane k with pixels 4k to 4k + 3 of every input; the permute puts them in order.
+	__m512i PackToBytes(__m512i const* q)
+	{
+		__m512i packed = _mm512_packus_epi16(_mm512_packs_epi32(q[0], q[1]), _mm512_packs_epi32(q[2], q[3]));
+		return _mm512_permutexvar_epi32(_mm512_setr_epi32(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15), packed);
+	}
+
+	// The alpha bytes of 16 pixels.
+	__m128i Alpha16(__m512i pixels)
+	{
+		return _mm512_cvtepi32_epi8(_mm512_srli_epi32(pixels, 24));
+	}
+
+	// Clamps 16 int32 results to 16-bit samples of Color, shifted into place, in order.
+	template<typename Color>
+	__m256i PackToWords(__m512i q)
+	{
+		__m512i clamped = _mm512_min_epi32(_mm512_max_epi32(q, _mm512_setzero_si512()), _mm512_set1_epi32(MaxSample<Color>()));
+		return _mm256_slli_epi16(_mm512_cvtepi32_epi16(clamped), Color::SampleShift);
+	}
+
+	// Luma roundings of 16 pixels from image position (x, y) on. The dither pattern repeats every 4 pixels,
+	// so they hold for every later group in the row, and without dithering they're all the same.
+	template<typename Color>
+	__m512i LumaRounding(uint32_t x, uint32_t y)
+	{
+		int32_t roundings[16];
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			roundings[i] = LumaRoundingAt<Color>(x + i, y);
+		}
+		return _mm512_loadu_si512(roundings);
+	}
+
+	// The same for chroma samples from (x, y) of the chroma plane on: interleaved U/V pairs for Chroma16,
+	// one sample per lane for PixelChroma16.
+	template<typename Color, bool Interleaved>
+	__m512i ChromaRounding(uint32_t x, uint32_t y)
+	{
+		int32_t roundings[16];
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			roundings[i] = ChromaRoundingAt<Color>(x + (Interleaved ? i / 2 : i), y);
+		}
+		return _mm512_loadu_si512(roundings);
+	}
+
+	// Dot product of every B8G8R8A8 pixel (summed over the given rows) with one set of coefficients.
+	template<bool Vnni, int32_t cb, int32_t cg, int32_t cr>
+	__m512i PixelDot(__m512i const* rows, int rowCount)
+	{
+		if constexpr (Vnni)
+		{
+			// Three signed base-128 digits, most significant first, so the running sum is shifted up a
+			// digit between passes.
+			auto digitDot = [&](__m512i n, __m512i coefficients)
+			{
+				for (int i = 0; i < rowCount; ++i)
+				{
+					n = _mm512_dpbusd_epi32(n, rows[i], coefficients);
+				}
+				return n;
+			};
+
+			__m512i n = digitDot(_mm512_setzero_si512(), ByteQuad(Digit(cb, 2), Digit(cg, 2), Digit(cr, 2)));
+			n = digitDot(_mm512_slli_epi32(n, DigitShift), ByteQuad(Digit(cb, 1), Digit(cg, 1), Digit(cr, 1)));
+			n = digitDot(_mm512_slli_epi32(n, DigitShift), ByteQuad(Digit(cb, 0), Digit(cg, 0), Digit(cr, 0)));
+			return n;
+		}
+		else
+		{
+			__m512i byteMask = _mm512_set1_epi32(0x00FF00FF);
+			__m512i br = _mm512_setzero_si512();
+			__m512i ga = _mm512_setzero_si512();
+			for (int i = 0; i < rowCount; ++i)
+			{
+				br = _mm512_add_epi16(br, _mm512_and_si512(rows[i], byteMask));
+				ga = _mm512_add_epi16(ga, _mm512_and_si512(_mm512_srli_epi32(rows[i], 8), byteMask));
+			}
+
+			__m512i high = _mm512_add_epi32(
+				_mm512_madd_epi16(br, WordPair(HighPart(cb), HighPart(cr))),
+				_mm512_madd_epi16(ga, WordPair(HighPart(cg), 0)));
+			__m512i low = _mm512_add_epi32(
+				_mm512_madd_epi16(br, WordPair(LowPart(cb), LowPart(cr))),
+				_mm512_madd_epi16(ga, WordPair(LowPart(cg), 0)));
+
+			return _mm512_add_epi32(_mm512_slli_epi32(high, SplitShift), low);
+		}
+	}
+
+	__m512i ShiftFast(__m512i n, int32_t rounding)
+	{
+		return _mm512_srai_epi32(_mm512_add_epi32(n, _mm512_set1_epi32(rounding)), FastShift);
+	}
+
+	// Fast tier luma: [R, G, B, G] bytes against Q8 coefficients, G split across both pairs.
+	template<typename Color, bool Vnni>
+	__m512i LumaFast16(__m512i pixels)
+	{
+		__m512i rgbg = _mm512_shuffle_epi8(pixels, _mm512_broadcast_i32x4(
+			_mm_setr_epi8(2, 1, 0, 1, 6, 5, 4, 5, 10, 9, 8, 9, 14, 13, 12, 13)));
+		__m512i coefficients = _mm512_set1_epi32(
+			Color::FastYR | (Color::FastYGWithR << 8) | (Color::FastYB << 16) | (Color::FastYGWithB << 24));
+
+		__m512i n;
+		if constexpr (Vnni)
+			n = _mm512_dpbusd_epi32(_mm512_setzero_si512(), rgbg, coefficients);
+		else
+			n = _mm512_madd_epi16(_mm512_maddubs_epi16(rgbg, coefficients), _mm512_set1_epi16(1));
+		return ShiftFast(n, Color::FastLumaRounding);
+	}
+
+	// Fast tier chroma for 16 pixels of two rows: rounded 8-bit quad averages against Q8 coefficients.
+	// Returns [U0 V0 U1 V1 ...] for 8 quads.
+	template<typename Color>
+	__m512i ChromaFast16(__m512i row0, __m512i row1)
+	{
+		__m512i byteMask = _mm512_set1_epi32(0x00FF00FF);
+		__m512i br = _mm512_add_epi16(_mm512_and_si512(row0, byteMask), _mm512_and_si512(row1, byteMask));
+		__m512i ga = _mm512_add_epi16(
+			_mm512_and_si512(_mm512_srli_epi32(row0, 8), byteMask),
+			_mm512_and_si512(_mm512_srli_epi32(row1, 8), byteMask));
+
+		// Add each odd pixel into its even neighbour; odd lanes are left with junk that gets blended away.
+		br = _mm512_add_epi16(br, _mm512_srli_epi64(br, 32));
+		ga = _mm512_add_epi16(ga, _mm512_srli_epi64(ga, 32));
+
+		__m512i two = _mm512_set1_epi16(2);
+		br = _mm512_srli_epi16(_mm512_add_epi16(br, two), 2);
+		ga = _mm512_srli_epi16(_mm512_add_epi16(ga, two), 2);
+
+		__m512i u = _mm512_add_epi32(
+			_mm512_madd_epi16(br, WordPair(Color::FastUB, Color::FastUR)),
+			_mm512_madd_epi16(ga, WordPair(Color::FastUG, 0)));
+		__m512i v = _mm512_add_epi32(
+			_mm512_madd_epi16(br, WordPair(Color::FastVB, Color::FastVR)),
+			_mm512_madd_epi16(ga, WordPair(Color::FastVG, 0)));
+
+		return ShiftFast(_mm512_mask_blend_epi32(0xAAAA, u, _mm512_slli_epi64(v, 32)), Color::FastChromaRounding);
+	}
+
+	// The fast tier ignores rounding, here and in the chroma functions.
+	template<typename Color, bool Vnni, bool Fast>
+	__m512i Luma16(__m512i pixels, __m512i rounding)
+	{
+		if (Fast)
+			return LumaFast16<Color, Vnni>(pixels);
+
+		__m512i n = PixelDot<Vnni, Color::YB, Color::YG, Color::YR>(&pixels, 1);
+		return RoundedDivide(_mm512_slli_epi32(n, Color::LumaNumeratorShift), rounding, Color::LumaDivisor);
+	}
+
+	// Interleaved [U0 V0 U1 V1 ...] for the 8 quads covered by 16 pixels of two rows. With rowCount 1, the
+	// one row stands in for both (packed 4:2:2), and its numerators are doubled rather than computed twice.
+	template<typename Color, bool Vnni, bool Fast>
+	__m512i Chroma16(__m512i const* rows, __m512i rounding, int rowCount = 2)
+	{
+		if (Fast)
+			return ChromaFast16<Color>(rows[0], rows[rowCount - 1]);
+
+		// Per-pixel numerators, already summed over both rows.
+		__m512i u = PixelDot<Vnni, Color::UB, Color::UG, Color::UR>(rows, rowCount);
+		__m512i v = PixelDot<Vnni, Color::VB, Color::VG, Color::VR>(rows, rowCount);
+
+		// Add horizontal pixel pairs, leaving U and V interleaved: [U0 V0 U1 V1] per 128 bits.
+		__m512i a = _mm512_unpacklo_epi32(u, v);
+		__m512i b = _mm512_unpackhi_epi32(u, v);
+		__m512i sums = _mm512_add_epi32(_mm512_unpacklo_epi64(a, b), _mm512_unpackhi_epi64(a, b));
+		if (rowCount == 1)
+			sums = _mm512_slli_epi32(sums, 1);
+		return RoundedDivide(_mm512_slli_epi32(sums, Color::ChromaNumeratorShift), rounding, Color::ChromaDivisor);
+	}
+
+	// 4:4:4 chroma of 16 pixels, each its own quad of four copies (see RowSpan): U and V bytes in pixel order.
+	template<typename Color, bool Vnni, bool Fast>
+	void PixelChroma16(__m512i pixels, __m512i rounding, __m128i* u, __m128i* v)
+	{
+		if (Fast)
+		{
+			// The average of four copies is the pixel itself.
+			__m512i byteMask = _mm512_set1_epi32(0x00FF00FF);
+			__m512i br = _mm512_and_si512(pixels, byteMask);
+			__m512i ga = _mm512_and_si512(_mm512_srli_epi32(pixels, 8), byteMask);
+
+			*u = PackToBytes(ShiftFast(_mm512_add_epi32(
+				_mm512_madd_epi16(br, WordPair(Color::FastUB, Color::FastUR)),
+				_mm512_madd_epi16(ga, WordPair(Color::FastUG, 0))), Color::FastChromaRounding));
+			*v = PackToBytes(ShiftFast(_mm512_add_epi32(
+				_mm512_madd_epi16(br, WordPair(Color::FastVB, Color::FastVR)),
+				_mm512_madd_epi16(ga, WordPair(Color::FastVG, 0))), Color::FastChromaRounding));
+			return;
+		}
+
+		__m512i nu = _mm512_slli_epi32(PixelDot<Vnni, Color::UB, Color::UG, Color::UR>(&pixels, 1), 2 + Color::ChromaNumeratorShift);
+		__m512i nv = _mm512_slli_epi32(PixelDot<Vnni, Color::VB, Color::VG, Color::VR>(&pixels, 1), 2 + Color::ChromaNumeratorShift);
+		*u = PackToBytes(RoundedDivide(nu, rounding, Color::ChromaDivisor));
+		*v = PackToBytes(RoundedDivide(nv, rounding, Color::ChromaDivisor));
+	}
+
+	template<typename Color, bool Vnni, bool Fast>
+	void LumaRowAvx512(uint8_t const* src, uint32_t srcWidth, uint8_t* dstY, uint32_t dstWidth)
+	{
+		__m512i edge = _mm512_set1_epi32(reinterpret_cast<int32_t const*>(src)[srcWidth - 1]);
+		__m512i rounding = LumaRounding<Color>(0, 0);
+
+		for (uint32_t x = 0; x < dstWidth; x += 64)
+		{
+			for (uint32_t i = 0; i < 64; i += 16)
+			{
+				int32_t srcRemaining = static_cast<int32_t>(srcWidth) - static_cast<int32_t>(x + i);
+				int32_t dstRemaining = static_cast<int32_t>(dstWidth) - static_cast<int32_t>(x + i);
+				if (dstRemaining <= 0)
+					break;
+
+				__m512i pixels = LoadPixels(src + (x + i) * 4, srcRemaining, edge);
+				__m512i luma = Luma16<Color, Vnni, Fast>(pixels, rounding);
+				if constexpr (Color::SampleBits > 8)
+					_mm256_mask_storeu_epi16(dstY + (x + i) * 2, PixelMask(dstRemaining), PackToWords<Color>(luma));
+				else
+					_mm_mask_storeu_epi8(dstY + x + i, PixelMask(dstRemaining), PackToBytes(luma));
+			}
+		}
+	}
+
+	// Full 16-byte blocks go out as non-temporal stores when streaming; the partial last block can't.
+	template<bool Stream>
+	void StoreBytes(uint8_t* dst, int32_t remaining, __m128i bytes)
+	{
+		if (Stream && remaining >= 16)
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst), bytes);
+		else
+			_mm_mask_storeu_epi8(dst, PixelMask(remaining), bytes);
+	}
+
+	// The 8 chroma bytes of one plane for 16 pixels, in the low half of bytes; remaining counts pixels.
+	template<bool Stream>
+	void StoreHalfBytes(uint8_t* dst, int32_t remaining, __m128i bytes)
+	{
+		if (Stream && remaining >= 16)
+		{
+#if defined(_M_X64) || defined(__x86_64__)
+			_mm_stream_si64(reinterpret_cast<long long*>(dst), _mm_cvtsi128_si64(bytes));
+#else
+			_mm_stream_si32(reinterpret_cast<int*>(dst), _mm_cvtsi128_si32(bytes));
+			_mm_stream_si32(reinterpret_cast<int*>(dst + 4), _mm_extract_epi32(bytes, 1));
+#endif
+		}
+		else if (remaining >= 16)
+		{
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst), bytes);
+		}
+		else
+		{
+			_mm_mask_storeu_epi8(dst, PixelMask(remaining / 2) & 0xFF, bytes);
+		}
+	}
+
+	// 64 bytes, all of them in the row.
+	template<bool Stream>
+	void StoreBlock(uint8_t* dst, __m512i bytes)
+	{
+		if (Stream)
+			_mm512_stream_si512(reinterpret_cast<__m512i*>(dst), bytes);
+		else
+			_mm512_storeu_si512(dst, bytes);
+	}
+
+	// 16 words; remaining counts them.
+	template<bool Stream>
+	void StoreWords(uint8_t* dst, int32_t remaining, __m256i words)
+	{
+		if (Stream && remaining >= 16)
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(dst), words);
+		else
+			_mm256_mask_storeu_epi16(dst, PixelMask(remaining), words);
+	}
+
+	// 8 words; remaining counts them.
+	template<bool Stream>
+	void StoreHalfWords(uint8_t* dst, int32_t remaining, __m128i words)
+	{
+		if (Stream && remaining >= 8)
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst), words);
+		else
+			_mm_mask_storeu_epi16(dst, PixelMask(remaining) & 0xFF, words);
+	}
+
+	// 16 dwords; remaining counts them.
+	template<bool Stream>
+	void StoreDwords(uint8_t* dst, int32_t remaining, __m512i dwords)
+	{
+		if (Stream && remaining >= 16)
+			_mm512_stream_si512(reinterpret_cast<__m512i*>(dst), dwords);
+		else
+			_mm512_mask_storeu_epi32(dst, PixelMask(remaining), dwords);
+	}
+
+	// Chroma of 16 pixels from Chroma16, interleaved or split into the U and V planes. Works for row pairs and
+	// for 4:2:2 rows alike.
+	template<bool Planar, bool Stream, typename Target>
+	void StoreChroma(Target const& dst, uint32_t x, int32_t remaining, __m512i uv)
+	{
+		if (Planar)
+		{
+			__m128i split = _mm_shuffle_epi8(PackToBytes(uv), _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15));
+			StoreHalfBytes<Stream>(dst.U + x / 2, remaining, split);
+			StoreHalfBytes<Stream>(dst.V + x / 2, remaining, _mm_unpackhi_epi64(split, split));
+		}
+		else
+		{
+			StoreBytes<Stream>(dst.UV + x, remaining, PackToBytes(uv));
+		}
+	}
+
+	// One I400 row; see GreyRowSse41. Masked loads and stores take the edge, as in LumaRowAvx512.
+	template<typename Color, bool Vnni, bool Fast, bool Stream>
+	void GreyRowAvx512(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t dstWidth)
+	{
+		uint32_t head = 0;
+		if (Stream)
+		{
+			if (!GetPackedStreamingHead(dst.Y, 64, dstWidth, &head, 1))
+			{
+				GreyRowAvx512<Color, Vnni, Fast, false>(src, srcWidth, dst, dstWidth);
+				return;
+			}
+
+			GreyRowAvx512<Color, Vnni, Fast, false>(src, srcWidth, dst, head);
+		}
+
+		__m512i edge = _mm512_set1_epi32(reinterpret_cast<int32_t const*>(src)[srcWidth - 1]);
+		__m512i rounding = LumaRounding<Color>(dst.Left + head, dst.Top);
+
+		// Whole blocks of 64 pixels inside both the source and the target go out as one full-width store. The
+		// dither pattern repeats every 4 pixels, so one rounding serves all four groups.
+		uint32_t blockEnd = srcWidth < dstWidth ? srcWidth : dstWidth;
+		uint32_t x = head;
+		for (; x + 64 <= blockEnd; x += 64)
+		{
+			if (Stream)
+			{
+				for (uint32_t line = 0; line < 256; line += 64)
+				{
+					_mm_prefetch(reinterpret_cast<char const*>(src + x * 4 + PrefetchDistance + line), _MM_HINT_T0);
+				}
+			}
+
+			__m512i luma[4];
+			for (uint32_t i = 0; i < 4; ++i)
+			{
+				luma[i] = Luma16<Color, Vnni, Fast>(_mm512_loadu_si512(src + (x + i * 16) * 4), rounding);
+			}
+			StoreBlock<Stream>(dst.Y + x, PackToBytes(luma));
+		}
+
+		// The rest, 16 pixels at a time, with masks for the row tail and the padding column.
+		for (; x < dstWidth; x += 16)
+		{
+			int32_t srcRemaining = static_cast<int32_t>(srcWidth) - static_cast<int32_t>(x);
+			int32_t dstRemaining = static_cast<int32_t>(dstWidth) - static_cast<int32_t>(x);
+			if (Stream)
+				_mm_prefetch(reinterpret_cast<char const*>(src + x * 4 + PrefetchDistance), _MM_HINT_T0);
+
+			__m512i pixels = LoadPixels(src + x * 4, srcRemaining, edge);
+			StoreBytes<Stream>(dst.Y + x, dstRemaining, PackToBytes(Luma16<Color, Vnni, Fast>(pixels, rounding)));
+		}
+
+		if (Stream)
+			_mm_sfence();
+	}
+
+	// Every source pixel is loaded once and feeds its luma value, its chroma quad and, with Alpha, the alpha
+	// rows.
+	template<typename Color, bool Vnni, bool Fast, bool Planar, bool Alpha, bool Stream>
+	void RowPairAvx512(uint8_t const* src0, uint8_t const* src1, uint32_t srcWidth, CpuKernels::RowPairTarget const& dst, uint32_t dstWidth)
+	{
+		uint32_t head = 0;
+		if (Stream)
+		{
+			if (!GetStreamingHead(dst, Planar, Alpha, 16, dstWidth, &head))
+			{
+				RowPairAvx512<Color, Vnni, Fast, Planar, Alpha, false>(src0, src1, srcWidth, dst, dstWidth);
+				return;
+			}
+
+			// Masked stores handle the unaligned head without a scalar loop.
+			RowPairAvx512<Color, Vnni, Fast, Planar, Alpha, false>(src0, src1, srcWidth, dst, head);
+		}
+
+		__m512i edge0 = _mm512_set1_epi32(reinterpret_cast<int32_t const*>(src0)[srcWidth - 1]);
+		__m512i edge1 = _mm512_set1_epi32(reinterpret_cast<int32_t const*>(src1)[srcWidth - 1]);
+		__m512i luma0 = LumaRounding<Color>(dst.Left + head, dst.Top);
+		__m512i luma1 = LumaRounding<Color>(dst.Left + head, dst.Top + 1);
+		__m512i chroma = ChromaRounding<Color, true>((dst.Left + head) / 2, dst.Top / 2);
+
+		for (uint32_t x = head; x < dstWidth; x += 64)
+		{
+			for (uint32_t i = 0; i < 64; i += 16)
+			{
+				int32_t srcRemaining = static_cast<int32_t>(srcWidth) - static_cast<int32_t>(x + i);
+				int32_t dstRemaining = static_cast<int32_t>(dstWidth) - static_cast<int32_t>(x + i);
+				if (dstRemaining <= 0)
+					break;
+
+				if (Stream)
+				{
+					_mm_prefetch(reinterpret_cast<char const*>(src0 + (x + i) * 4 + PrefetchDistance), _MM_HINT_T0);
+					_mm_prefetch(reinterpret_cast<char const*>(src1 + (x + i) * 4 + PrefetchDistance), _MM_HINT_T0);
+				}
+
+				__m512i rows[2] =
+				{
+					LoadPixels(src0 + (x + i) * 4, srcRemaining, edge0),
+					LoadPixels(src1 + (x + i) * 4, srcRemaining, edge1)
+				};
+
+				StoreBytes<Stream>(dst.Y0 + x + i, dstRemaining, PackToBytes(Luma16<Color, Vnni, Fast>(rows[0], luma0)));
+				StoreBytes<Stream>(dst.Y1 + x + i, dstRemaining, PackToBytes(Luma16<Color, Vnni, Fast>(rows[1], luma1)));
+				StoreChroma<Planar, Stream>(dst, x + i, dstRemaining, Chroma16<Color, Vnni, Fast>(rows, chroma));
+
+				if (Alpha)
+				{
+					StoreBytes<Stream>(dst.A0 + x + i, dstRemaining, Alpha16(rows[0]));
+					StoreBytes<Stream>(dst.A1 + x + i, dstRemaining, Alpha16(rows[1]));
+				}
+			}
+		}
+
+		// Non-temporal stores are weakly ordered; fence them before the caller signals completion.
+		if (Stream)
+			_mm_sfence();
+	}
+
+	// RowPairAvx512 for 16-bit samples, always exact. 16 pixels fill 32 bytes of each luma row and 16 of
+	// each chroma plane, or 32 of an interleaved chroma row.
+	template<typename Color, bool Vnni, bool Planar, bool Stream>
+	void RowPairWideAvx512(uint8_t const* src0, uint8_t const* src1, uint32_t srcWidth, CpuKernels::RowPairTarget const& dst, uint32_t dstWidth)
+	{
+		uint32_t head = 0;
+		if (Stream)
+		{
+			if (!GetStreamingHead(dst, Planar, false, 32, dstWidth, &head, 2))
+			{
+				RowPairWideAvx512<Color, Vnni, Planar, false>(src0, src1, srcWidth, dst, dstWidth);
+				return;
+			}
+
+			RowPairWideAvx512<Color, Vnni, Planar, false>(src0, src1, srcWidth, dst, head);
+		}
+
+		__m512i edge0 = _mm512_set1_epi32(reinterpret_cast<int32_t const*>(src0)[srcWidth - 1]);
+		__m512i edge1 = _mm512_set1_epi32(reinterpret_cast<int32_t const*>(src1)[srcWidth - 1]);
+		__m512i luma0 = LumaRounding<Color>(dst.Left + head, dst.Top);
+		__m512i luma1 = LumaRounding<Color>(dst.Left + head, dst.Top + 1);
+		__m512i chroma = ChromaRounding<Color, true>((dst.Left + head) / 2, dst.Top / 2);
+
+		// U of the 8 quads in the low half, V in the high half.
+		__m512i splitChroma = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+
+		for (uint32_t x = head; x < dstWidth; x += 64)
+		{
+			for (uint32_t i = 0; i < 64; i += 16)
+			{
+				int32_t srcRemaining = static_cast<int32_t>(srcWidth) - static_cast<int32_t>(x + i);
+				int32_t dstRemaining = static_cast<int32_t>(dstWidth) - static_cast<int32_t>(x + i);
+				if (dstRemaining <= 0)
+					break;
+
+				if (Stream)
+				{
+					_mm_prefetch(reinterpret_cast<char const*>(src0 + (x + i) * 4 + PrefetchDistance), _MM_HINT_T0);
+					_mm_prefetch(reinterpret_cast<char const*>(src1 + (x + i) * 4 + PrefetchDistance), _MM_HINT_T0);
+				}
+
+				__m512i rows[2] =
+				{
+					LoadPixels(src0 + (x + i) * 4, srcRemaining, edge0),
+					LoadPixels(src1 + (x + i) * 4, srcRemaining, edge1)
+				};
+
+				StoreWords<Stream>(dst.Y0 + (x + i) * 2, dstRemaining, PackToWords<Color>(Luma16<Color, Vnni, false>(rows[0], luma0)));
+				StoreWords<Stream>(dst.Y1 + (x + i) * 2, dstRemaining, PackToWords<Color>(Luma16<Color, Vnni, false>(rows[1], luma1)));
+
+				__m512i uv = Chroma16<Color, Vnni, false>(rows, chroma);
+				if (Planar)
+				{
+					__m256i split = PackToWords<Color>(_mm512_permutexvar_epi32(splitChroma, uv));
+					StoreHalfWords<Stream>(dst.U + x + i, dstRemaining / 2, _mm256_castsi256_si128(split));
+					StoreHalfWords<Stream>(dst.V + x + i, dstRemaining / 2, _mm256_extracti128_si256(split, 1));
+				}
+				else
+				{
+					StoreWords<Stream>(dst.UV + (x + i) * 2, dstRemaining, PackToWords<Color>(uv));
+				}
+			}
+		}
+
+		if (Stream)
+			_mm_sfence();
+	}
+
+	// One packed 4:2:2 row: Chroma16 of the row standing in for both rows (see PackedRowSpan), interleaved
+	// bytewise with the luma. 16 pixels fill 32 bytes, stored as two masked halves.
+	template<typename Color, bool Vnni, bool Fast, bool Uyvy, bool Stream>
+	void PackedRowAvx512(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t dstWidth)
+	{
+		uint32_t head = 0;
+		if (Stream)
+		{
+			if (!GetPackedStreamingHead(dst.Y, 16, dstWidth, &head))
+			{
+				PackedRowAvx512<Color, Vnni, Fast, Uyvy, false>(src, srcWidth, dst, dstWidth);
+				return;
+			}
+
+			PackedRowAvx512<Color, Vnni, Fast, Uyvy, false>(src, srcWidth, dst, head);
+		}
+
+		__m512i edge = _mm512_set1_epi32(reinterpret_cast<int32_t const*>(src)[srcWidth - 1]);
+		__m512i lumaRounding = LumaRounding<Color>(dst.Left + head, dst.Top);
+		__m512i chromaRounding = ChromaRounding<Color, true>((dst.Left + head) / 2, dst.Top);
+
+		for (uint32_t x = head; x < dstWidth; x += 64)
+		{
+			for (uint32_t i = 0; i < 64; i += 16)
+			{
+				int32_t srcRemaining = static_cast<int32_t>(srcWidth) - static_cast<int32_t>(x + i);
+				int32_t dstRemaining = static_cast<int32_t>(dstWidth) - static_cast<int32_t>(x + i);
+				if (dstRemaining <= 0)
+					break;
+
+				if (Stream)
+					_mm_prefetch(reinterpret_cast<char const*>(src + (x + i) * 4 + PrefetchDistance), _MM_HINT_T0);
+
+				__m512i pixels = LoadPixels(src + (x + i) * 4, srcRemaining, edge);
+				__m128i luma = PackToBytes(Luma16<Color, Vnni, Fast>(pixels, lumaRounding));
+				__m128i chroma = PackToBytes(Chroma16<Color, Vnni, Fast>(&pixels, chromaRounding, 1));
+				uint8_t* out = dst.Y + (x + i) * 2;
+				StoreBytes<Stream>(out, dstRemaining * 2, Uyvy ? _mm_unpacklo_epi8(chroma, luma) : _mm_unpacklo_epi8(luma, chroma));
+				StoreBytes<Stream>(out + 16, dstRemaining * 2 - 16, Uyvy ? _mm_unpackhi_epi8(chroma, luma) : _mm_unpackhi_epi8(luma, chroma));
+			}
+		}
+
+		if (Stream)
+			_mm_sfence();
+	}
+
+	// One row of 4:2:2 or 4:4:4 (FullChroma) luma and chroma; see RowSpan.
+	template<typename Color, bool Vnni, bool Fast, bool Planar, bool FullChroma, bool Stream>
+	void RowAvx512(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t dstWidth)
+	{
+		uint32_t head = 0;
+		if (Stream)
+		{
+			if (!GetRowStreamingHead(dst, Planar, FullChroma, 16, dstWidth, &head))
+			{
+				RowAvx512<Color, Vnni, Fast, Planar, FullChroma, false>(src, srcWidth, dst, dstWidth);
+				return;
+			}
+
+			RowAvx512<Color, Vnni, Fast, Planar, FullChroma, false>(src, srcWidth, dst, head);
+		}
+
+		__m512i edge = _mm512_set1_epi32(reinterpret_cast<int32_t const*>(src)[srcWidth - 1]);
+		__m512i lumaRounding = LumaRounding<Color>(dst.Left + head, dst.Top);
+		__m512i chromaRounding = ChromaRounding<Color, !FullChroma>(FullChroma ? dst.Left + head : (dst.Left + head) / 2, dst.Top);
+
+		for (uint32_t x = head; x < dstWidth; x += 64)
+		{
+			for (uint32_t i = 0; i < 64; i += 16)
+			{
+				int32_t srcRemaining = static_cast<int32_t>(srcWidth) - static_cast<int32_t>(x + i);
+				int32_t dstRemaining = static_cast<int32_t>(dstWidth) - static_cast<int32_t>(x + i);
+				if (dstRemaining <= 0)
+					break;
+
+				if (Stream)
+					_mm_prefetch(reinterpret_cast<char const*>(src + (x + i) * 4 + PrefetchDistance), _MM_HINT_T0);
+
+				__m512i pixels = LoadPixels(src + (x + i) * 4, srcRemaining, edge);
+				StoreBytes<Stream>(dst.Y + x + i, dstRemaining, PackToBytes(Luma16<Color, Vnni, Fast>(pixels, lumaRounding)));
+
+				if (FullChroma)
+				{
+					__m128i u;
+					__m128i v;
+					PixelChroma16<Color, Vnni, Fast>(pixels, chromaRounding, &u, &v);
+					if (Planar)
+					{
+						StoreBytes<Stream>(dst.U + x + i, dstRemaining, u);
+						StoreBytes<Stream>(dst.V + x + i, dstRemaining, v);
+					}
+					else
+					{
+						uint8_t* uv = dst.UV + (x + i) * 2;
+						StoreBytes<Stream>(uv, dstRemaining * 2, _mm_unpacklo_epi8(u, v));
+						StoreBytes<Stream>(uv + 16, dstRemaining * 2 - 16, _mm_unpackhi_epi8(u, v));
+					}
+				}
+				else
+				{
+					StoreChroma<Planar, Stream>(dst, x + i, dstRemaining, Chroma16<Color, Vnni, Fast>(&pixels, chromaRounding, 1));
+				}
+			}
+		}
+
+		if (Stream)
+			_mm_sfence();
+	}
+
+	// One AYUV row; see AyuvRowSpan. Each pixel's [V U Y A] is assembled in a dword from its bytes, so 16
+	// pixels fill one 64-byte store.
+	template<typename Color, bool Vnni, bool Fast, bool Stream>
+	void AyuvRowAvx512(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t dstWidth)
+	{
+		uint32_t head = 0;
+		if (Stream)
+		{
+			if (!GetPackedStreamingHead(dst.Y, 64, dstWidth, &head, 4))
+			{
+				AyuvRowAvx512<Color, Vnni, Fast, false>(src, srcWidth, dst, dstWidth);
+				return;
+			}
+
+			AyuvRowAvx512<Color, Vnni, Fast, false>(src, srcWidth, dst, head);
+		}
+
+		__m512i edge = _mm512_set1_epi32(reinterpret_cast<int32_t const*>(src)[srcWidth - 1]);
+		__m512i lumaRounding = LumaRounding<Color>(dst.Left + head, dst.Top);
+		__m512i chromaRounding = ChromaRounding<Color, false>(dst.Left + head, dst.Top);
+		__m512i alphaMask = _mm512_set1_epi32(static_cast<int32_t>(0xFF000000u));
+
+		for (uint32_t x = head; x < dstWidth; x += 64)
+		{
+			for (uint32_t i = 0; i < 64; i += 16)
+			{
+				int32_t srcRemaining = static_cast<int32_t>(srcWidth) - static_cast<int32_t>(x + i);
+				int32_t dstRemaining = static_cast<int32_t>(dstWidth) - static_cast<int32_t>(x + i);
+				if (dstRemaining <= 0)
+					break;
+
+				if (Stream)
+					_mm_prefetch(reinterpret_cast<char const*>(src + (x + i) * 4 + PrefetchDistance), _MM_HINT_T0);
+
+				__m512i pixels = LoadPixels(src + (x + i) * 4, srcRemaining, edge);
+				__m128i luma = PackToBytes(Luma16<Color, Vnni, Fast>(pixels, lumaRounding));
+				__m128i u;
+				__m128i v;
+				PixelChroma16<Color, Vnni, Fast>(pixels, chromaRounding, &u, &v);
+
+				__m512i ayuv = _mm512_or_si512(
+					_mm512_or_si512(_mm512_cvtepu8_epi32(u), _mm512_slli_epi32(_mm512_cvtepu8_epi32(v), 8)),
+					_mm512_or_si512(_mm512_slli_epi32(_mm512_cvtepu8_epi32(luma), 16), _mm512_and_si512(pixels, alphaMask)));
+				StoreDwords<Stream>(dst.Y + (x + i) * 4, dstRemaining, ayuv);
+			}
+		}
+
+		if (Stream)
+			_mm_sfence();
+	}
+
+	// YCoCg-R of 16 pixels, one int32 per lane; see YCoCg.
+	template<bool SwapRB>
+	void YCoCg16(__m512i pixels, __m512i* y, __m512i* co, __m512i* cg)
+	{
+		__m512i mask = _mm512_set1_epi32(0xFF);
+		__m512i low = _mm512_and_si512(pixels, mask);
+		__m512i g = _mm512_and_si512(_mm512_srli_epi32(pixels, 8), mask);
+		__m512i high = _mm512_and_si512(_mm512_srli_epi32(pixels, 16), mask);
+		__m512i r = SwapRB ? low : high;
+		__m512i b = SwapRB ? high : low;
+
+		*co = _mm512_sub_epi32(r, b);
+		__m512i t = _mm512_add_epi32(b, _mm512_srai_epi32(*co, 1));
+		*cg = _mm512_sub_epi32(g, t);
+		*y = _mm512_add_epi32(t, _mm512_srai_epi32(*cg, 1));
+	}
+
+	// Rounded averages of the 2x2 blocks of 16 pixels as 8 words, from their vertical sums: each pixel pair
+	// adds up in the low dword of its qword.
+	__m128i YCoCgQuadAverages(__m512i sums)
+	{
+		__m512i pairs = _mm512_add_epi32(sums, _mm512_srli_epi64(sums, 32));
+		return _mm512_cvtepi64_epi16(_mm512_srai_epi32(_mm512_add_epi32(pairs, _mm512_set1_epi32(2)), 2));
+	}
+
+	template<bool SwapRB>
+	void YCoCgLumaRowAvx512(uint8_t const* src, uint32_t srcWidth, uint8_t* dstY, uint32_t dstWidth)
+	{
+		__m512i edge = _mm512_set1_epi32(reinterpret_cast<int32_t const*>(src)[srcWidth - 1]);
+
+		for (uint32_t x = 0; x < dstWidth; x += 16)
+		{
+			int32_t srcRemaining = static_cast<int32_t>(srcWidth) - static_cast<int32_t>(x);
+			int32_t dstRemaining = static_cast<int32_t>(dstWidth) - static_cast<int32_t>(x);
+
+			__m512i y;
+			__m512i co;
+			__m512i cg;
+			YCoCg16<SwapRB>(LoadPixels(src + x * 4, srcRemaining, edge), &y, &co, &cg);
+			StoreWords<false>(dstY + x * 2, dstRemaining, _mm512_cvtepi32_epi16(y));
+		}
+	}
+
+	// One YCoCg-R 4:4:4 row; see YCoCgRowSpan. 16 pixels fill 32 bytes of each plane.
+	template<bool SwapRB, bool Stream>
+	void YCoCgRowAvx512(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t dstWidth)
+	{
+		uint32_t head = 0;
+		if (Stream)
+		{
+			uint8_t* luma[] = { dst.Y };
+			uint8_t* chroma[] = { dst.U, dst.V };
+			if (!GetYCoCgStreamingHead(luma, 1, chroma, 2, false, 32, dstWidth, &head))
+			{
+				YCoCgRowAvx512<SwapRB, false>(src, srcWidth, dst, dstWidth);
+				return;
+			}
+
+			YCoCgRowAvx512<SwapRB, false>(src, srcWidth, dst, head);
+		}
+
+		__m512i edge = _mm512_set1_epi32(reinterpret_cast<int32_t const*>(src)[srcWidth - 1]);
+
+		for (uint32_t x = head; x < dstWidth; x += 16)
+		{
+			int32_t srcRemaining = static_cast<int32_t>(srcWidth) - static_cast<int32_t>(x);
+			int32_t dstRemaining = static_cast<int32_t>(dstWidth) - static_cast<int32_t>(x);
+
+			if (Stream)
+				_mm_prefetch(reinterpret_cast<char const*>(src + x * 4 + PrefetchDistance), _MM_HINT_T0);
+
+			__m512i y;
+			__m512i co;
+			__m512i cg;
+			YCoCg16<SwapRB>(LoadPixels(src + x * 4, srcRemaining, edge), &y, &co, &cg);
+			StoreWords<Stream>(dst.Y + x * 2, dstRemaining, _mm512_cvtepi32_epi16(y));
+			StoreWords<Stream>(dst.U + x * 2, dstRemaining, _mm512_cvtepi32_epi16(co));
+			StoreWords<Stream>(dst.V + x * 2, dstRemaining, _mm512_cvtepi32_epi16(cg));
+		}
+
+		if (Stream)
+			_mm_sfence();
+	}
+
+	// One YCoCg-R 4:2:0 row pair; see YCoCgRowPairSpan. 16 pixels fill 32 bytes of each luma row and 16 of
+	// each chroma row.
+	template<bool SwapRB, bool Stream>
+	void YCoCgRowPairAvx512(uint8_t const* src0, uint8_t const* src1, uint32_t srcWidth, CpuKernels::RowPairTarget const& dst, uint32_t dstWidth)
+	{
+		uint32_t head = 0;
+		if (Stream)
+		{
+			uint8_t* luma[] = { dst.Y0, dst.Y1 };
+			uint8_t* chroma[] = { dst.U, dst.V };
+			if (!GetYCoCgStreamingHead(luma, 2, chroma, 2, true, 32, dstWidth, &head))
+			{
+				YCoCgRowPairAvx512<SwapRB, false>(src0, src1, srcWidth, dst, dstWidth);
+				return;
+			}
+
+			YCoCgRowPairAvx512<SwapRB, false>(src0, src1, srcWidth, dst, head);
+		}
+
+		__m512i edge0 = _mm512_set1_epi32(reinterpret_cast<int32_t const*>(src0)[srcWidth - 1]);
+		__m512i edge1 = _mm512_set1_epi32(reinterpret_cast<int32_t const*>(src1)[srcWidth - 1]);
+
+		for (uint32_t x = head; x < dstWidth; x += 16)
+		{
+			int32_t srcRemaining = static_cast<int32_t>(srcWidth) - static_cast<int32_t>(x);
+			int32_t dstRemaining = static_cast<int32_t>(dstWidth) - static_cast<int32_t>(x);
+
+			if (Stream)
+			{
+				_mm_prefetch(reinterpret_cast<char const*>(src0 + x * 4 + PrefetchDistance), _MM_HINT_T0);
+				_mm_prefetch(reinterpret_cast<char const*>(src1 + x * 4 + PrefetchDistance), _MM_HINT_T0);
+			}
+
+			__m512i y[2];
+			__m512i co[2];
+			__m512i cg[2];
+			YCoCg16<SwapRB>(LoadPixels(src0 + x * 4, srcRemaining, edge0), &y[0], &co[0], &cg[0]);
+			YCoCg16<SwapRB>(LoadPixels(src1 + x * 4, srcRemaining, edge1), &y[1], &co[1], &cg[1]);
+			StoreWords<Stream>(dst.Y0 + x * 2, dstRemaining, _mm512_cvtepi32_epi16(y[0]));
+			StoreWords<Stream>(dst.Y1 + x * 2, dstRemaining, _mm512_cvtepi32_epi16(y[1]));
+			StoreHalfWords<Stream>(dst.U + x, dstRemaining / 2, YCoCgQuadAverages(_mm512_add_epi32(co[0], co[1])));
+			StoreHalfWords<Stream>(dst.V + x, dstRemaining / 2, YCoCgQuadAverages(_mm512_add_epi32(cg[0], cg[1])));
+		}
+
+		if (Stream)
+			_mm_sfence();
+	}
+
+	// One row back from YCoCg-R; see YCoCgInverseSpan. The steps run on 16 words, and each pixel's bytes are
+	// assembled in a dword as in AyuvRowAvx512. Masked loads stop at the row end; subsampled chroma words
+	// are doubled up to one per pixel.
+	template<bool SwapRB, bool Subsampled>
+	void YCoCgInverseRowAvx512(CpuKernels::InverseRowSource const& src, uint8_t* dst, uint32_t width)
+	{
+		__m256i zero = _mm256_setzero_si256();
+		__m256i max = _mm256_set1_epi16(255);
+		__m512i alpha = _mm512_set1_epi32(static_cast<int32_t>(0xFF000000u));
+
+		for (uint32_t x = 0; x < width; x += 16)
+		{
+			int32_t remaining = static_cast<int32_t>(width) - static_cast<int32_t>(x);
+
+			__m256i co;
+			__m256i cg;
+			if (Subsampled)
+			{
+				__mmask8 chromaMask = static_cast<__mmask8>(PixelMask((remaining + 1) / 2));
+				__m256i co16 = _mm256_cvtepu16_epi32(_mm_maskz_loadu_epi16(chromaMask, src.U + x));
+				__m256i cg16 = _mm256_cvtepu16_epi32(_mm_maskz_loadu_epi16(chromaMask, src.V + x));
+				co = _mm256_or_si256(co16, _mm256_slli_epi32(co16, 16));
+				cg = _mm256_or_si256(cg16, _mm256_slli_epi32(cg16, 16));
+			}
+			else
+			{
+				co = _mm256_maskz_loadu_epi16(PixelMask(remaining), src.U + x * 2);
+				cg = _mm256_maskz_loadu_epi16(PixelMask(remaining), src.V + x * 2);
+			}
+
+			__m256i y = _mm256_maskz_loadu_epi16(PixelMask(remaining), src.Y + x * 2);
+			__m256i t = _mm256_sub_epi16(y, _mm256_srai_epi16(cg, 1));
+			__m256i g = _mm256_add_epi16(cg, t);
+			__m256i b = _mm256_sub_epi16(t, _mm256_srai_epi16(co, 1));
+			__m256i r = _mm256_add_epi16(b, co);
+
+			auto clamp = [&](__m256i value)
+			{
+				return _mm512_cvtepu16_epi32(_mm256_min_epi16(_mm256_max_epi16(value, zero), max));
+			};
+
+			__m512i pixels = _mm512_or_si512(
+				_mm512_or_si512(clamp(SwapRB ? r : b), _mm512_slli_epi32(clamp(g), 8)),
+				_mm512_or_si512(_mm512_slli_epi32(clamp(SwapRB ? b : r), 16), alpha));
+			StoreDwords<false>(dst + x * 4, remaining, pixels);
+		}
+	}
+
+	// Qword indices for vpermt2q that put the doubled-up elements of the unpacklo/unpackhi pair back in
+	// order: the first half of the row, then the second.
+	__m512i DoubledFirstHalf()
+	{
+		return _mm512_setr_epi64(0, 1, 8, 9, 2, 3, 10, 11);
+	}
+
+	__m512i DoubledSecondHalf()
+	{
+		return _mm512_setr_epi64(4, 5, 12, 13, 6, 7, 14, 15);
+	}
+
+	// Tensor rows, one gather of 16 floats per iteration; doubled rows write each twice. Codes past the row
+	// end load as zero, which still indexes the table, and the stores are masked.
+	template<bool Doubled>
+	void TensorRowFloat32Avx512(uint8_t const* codes, void const* table, void* dst, uint32_t count)
+	{
+		float const* elements = static_cast<float const*>(table);
+		float* row = static_cast<float*>(dst);
+		uint32_t const step = Doubled ? 32 : 16;
+		for (uint32_t i = 0; i < count; i += step)
+		{
+			int32_t remaining = static_cast<int32_t>(count - i);
+			int32_t codeCount = Doubled ? (remaining + 1) / 2 : remaining;
+			__m128i sixteen = _mm_maskz_loadu_epi8(PixelMask(codeCount), codes + (Doubled ? i / 2 : i));
+			__m512 values = _mm512_i32gather_ps(_mm512_cvtepu8_epi32(sixteen), elements, 4);
+			if (Doubled)
+			{
+				__m512d low = _mm512_castps_pd(_mm512_unpacklo_ps(values, values));
+				__m512d high = _mm512_castps_pd(_mm512_unpackhi_ps(values, values));
+				_mm512_mask_storeu_ps(row + i, PixelMask(remaining), _mm512_castpd_ps(_mm512_permutex2var_pd(low, DoubledFirstHalf(), high)));
+				_mm512_mask_storeu_ps(row + i + 16, PixelMask(remaining - 16), _mm512_castpd_ps(_mm512_permutex2var_pd(low, DoubledSecondHalf(), high)));
+			}
+			else
+			{
+				_mm512_mask_storeu_ps(row + i, PixelMask(remaining), values);
+			}
+		}
+	}
+
+	// The binary16 elements of 32 codes, one per word, from a table held in eight registers: vpermi2w picks
+	// from 64 entries by the low 6 bits, and bits 6 and 7 choose among the four results.
+	__m512i LookUpHalves(__m512i const (&entries)[8], __m512i codes)
+	{
+		__m512i q0 = _mm512_permutex2var_epi16(entries[0], codes, entries[1]);
+		__m512i q1 = _mm512_permutex2var_epi16(entries[2], codes, entries[3]);
+		__m512i q2 = _mm512_permutex2var_epi16(entries[4], codes, entries[5]);
+		__m512i q3 = _mm512_permutex2var_epi16(entries[6], codes, entries[7]);
+		__mmask32 bit6 = _mm512_test_epi16_mask(codes, _mm512_set1_epi16(64));
+		__mmask32 bit7 = _mm512_test_epi16_mask(codes, _mm512_set1_epi16(128));
+		return _mm512_mask_blend_epi16(bit7, _mm512_mask_blend_epi16(bit6, q0, q1), _mm512_mask_blend_epi16(bit6, q2, q3));
+	}
+
+	// The same for binary16 elements, 32 codes per iteration, looked up with permutes instead of gathers.
+	template<bool Doubled>
+	void TensorRowFloat16Avx512(uint8_t const* codes, void const* table, void* dst, uint32_t count)
+	{
+		uint16_t const* elements = static_cast<uint16_t const*>(table);
+		uint16_t* row = static_cast<uint16_t*>(dst);
+		__m512i entries[8];
+		for (int k = 0; k < 8; ++k)
+		{
+			entries[k] = _mm512_loadu_si512(elements + k * 32);
+		}
+
+		uint32_t const step = Doubled ? 64 : 32;
+		for (uint32_t i = 0; i < count; i += step)
+		{
+			int32_t remaining = static_cast<int32_t>(count - i);
+			int32_t codeCount = Doubled ? (remaining + 1) / 2 : remaining;
+			__m256i thirtyTwo = _mm256_maskz_loadu_epi8(WordMask(codeCount), codes + (Doubled ? i / 2 : i));
+			__m512i values = LookUpHalves(entries, _mm512_cvtepu8_epi16(thirtyTwo));
+			if (Doubled)
+			{
+				__m512i low = _mm512_unpacklo_epi16(values, values);
+				__m512i high = _mm512_unpackhi_epi16(values, values);
+				_mm512_mask_storeu_epi16(row + i, WordMask(remaining), _mm512_permutex2var_epi64(low, DoubledFirstHalf(), high));
+				_mm512_mask_storeu_epi16(row + i + 32, WordMask(remaining - 32), _mm512_permutex2var_epi64(low, DoubledSecondHalf(), high));
+			}
+			else
+			{
+				_mm512_mask_storeu_epi16(row + i, WordMask(remaining), values);
+			}
+		}
+	}
+
+	template<typename Color, bool Vnni, bool Fast, KernelStore Store>
+	constexpr CpuKernels::RowKernels MakeAvx512Kernels()
+	{
+		constexpr bool planar = IsPlanarStore(Store);
+		if constexpr (Store == KernelStore::YCoCg444)
+		{
+			constexpr bool swap = Color::SwapRB;
+			return
+			{
+				YCoCgLumaRowAvx512<swap>,
+				nullptr,
+				nullptr,
+				YCoCgRowAvx512<swap, false>,
+				YCoCgRowAvx512<swap, true>,
+				YCoCgInverseRowAvx512<swap, false>,
+			};
+		}
+		else if constexpr (Store == KernelStore::YCoCg420)
+		{
+			constexpr bool swap = Color::SwapRB;
+			return
+			{
+				YCoCgLumaRowAvx512<swap>,
+				YCoCgRowPairAvx512<swap, false>,
+				YCoCgRowPairAvx512<swap, true>,
+				nullptr,
+				nullptr,
+				YCoCgInverseRowAvx512<swap, true>,
+			};
+		}
+		else if constexpr (IsWideStore(Store))
+		{
+			return
+			{
+				LumaRowAvx512<Color, Vnni, false>,
+				RowPairWideAvx512<Color, Vnni, planar, false>,
+				RowPairWideAvx512<Color, Vnni, planar, true>,
+				nullptr,
+				nullptr,
+				nullptr,
+			};
+		}
+		else if constexpr (Store == KernelStore::Ayuv)
+		{
+			return
+			{
+				LumaRowAvx512<Color, Vnni, Fast>,
+				nullptr,
+				nullptr,
+				AyuvRowAvx512<Color, Vnni, Fast, false>,
+				AyuvRowAvx512<Color, Vnni, Fast, true>,
+				nullptr,
+			};
+		}
+		else if constexpr (Store == KernelStore::Grey)
+		{
+			return
+			{
+				LumaRowAvx512<Color, Vnni, Fast>,
+				nullptr,
+				nullptr,
+				GreyRowAvx512<Color, Vnni, Fast, false>,
+				GreyRowAvx512<Color, Vnni, Fast, true>,
+				nullptr,
+			};
+		}
+		else if constexpr (IsPackedStore(Store))
+		{
+			constexpr bool uyvy = Store == KernelStore::Uyvy;
+			return
+			{
+				LumaRowAvx512<Color, Vnni, Fast>,
+				nullptr,
+				nullptr,
+				PackedRowAvx512<Color, Vnni, Fast, uyvy, false>,
+				PackedRowAvx512<Color, Vnni, Fast, uyvy, true>,
+				nullptr,
+			};
+		}
+		else if constexpr (IsRowStore(Store))
+		{
+			constexpr bool full = IsFullChromaStore(Store);
+			return
+			{
+				LumaRowAvx512<Color, Vnni, Fast>,
+				nullptr,
+				nullptr,
+				RowAvx512<Color, Vnni, Fast, planar, full, false>,
+				RowAvx512<Color, Vnni, Fast, planar, full, true>,
+				nullptr,
+			};
+		}
+		else
+		{
+			constexpr bool alpha = Store == KernelStore::InterleavedAlpha;
+			return
+			{
+				LumaRowAvx512<Color, Vnni, Fast>,
+				RowPairAvx512<Color, Vnni, Fast, planar, alpha, false>,
+				RowPairAvx512<Color, Vnni, Fast, planar, alpha, true>,
+				nullptr,
+				nullptr,
+				nullptr,
+			};
+		}
+	}
+
+	template<bool Vnni>
+	struct Avx512Families
+	{
+		template<typename Color, KernelStore Store>
+		struct Family
+		{
+			static constexpr CpuKernels::RowKernels BitExact = MakeAvx512Kernels<Color, Vnni, false, Store>();
+			static constexpr CpuKernels::RowKernels Fast = MakeAvx512Kernels<Color, Vnni, true, Store>();
+			static constexpr CpuKernels::RowKernels Dithered = MakeAvx512Kernels<DitheredColor<Color>, Vnni, false, Store>();
+		};
+	};
+}
@@ -0,0 +1,15 @@
+// CpuKernelsAvx512Vnni.cpp: The AVX-512 VNNI kernel table, the AVX-512BW kernels with byte dot products
+// (vpdpbusd). Built with AVX-512 VNNI code generation; only call through Avx512VnniKernels.
+
+#include "CpuKernelsAvx512.h"
+
+namespace CpuKernels
+{
+	KernelTable const Avx512VnniKernels =
+	{
+		"avx512vnni",
+		KernelRegistry<Avx512Families<true>::Family>::Entries,
+		KernelRegistry<Avx512Families<true>::Family>::EntryCount,
+		{ TensorRowFloat32Avx512<false>, TensorRowFloat32Avx512<true>, TensorRowFloat16Avx512<false>, TensorRowFloat16Avx512<true> },
+	};
+}
@@ -0,0 +1,137 @@
+// CpuKernelsScalar.cpp: Portable reference kernels. Every SIMD kernel must match these byte for byte.
+
+#include "CpuKernels.h"
+#include "CpuKernelRegistry.h"
+
+namespace
+{
+	template<typename Color, bool Fast>
+	void LumaRowScalar(uint8_t const* src, uint32_t srcWidth, uint8_t* dstY, uint32_t dstWidth)
+	{
+		Rgb2YuvMath::LumaSpan<Color, Fast>(src, srcWidth, dstY, 0, dstWidth);
+	}
+
+	template<typename Color, bool Fast, bool Planar, bool Alpha>
+	void RowPairScalar(uint8_t const* src0, uint8_t const* src1, uint32_t srcWidth, CpuKernels::RowPairTarget const& dst, uint32_t dstWidth)
+	{
+		Rgb2YuvMath::RowPairSpan<Color, Fast, Planar, Alpha>(src0, src1, srcWidth, dst, 0, dstWidth);
+	}
+
+	template<typename Color, bool Fast, bool Uyvy>
+	void PackedRowScalar(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t dstWidth)
+	{
+		Rgb2YuvMath::PackedRowSpan<Color, Fast, Uyvy>(src, srcWidth, dst, 0, dstWidth);
+	}
+
+	template<typename Color, bool Fast, bool Planar, bool FullChroma>
+	void RowScalar(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t dstWidth)
+	{
+		Rgb2YuvMath::RowSpan<Color, Fast, Planar, FullChroma>(src, srcWidth, dst, 0, dstWidth);
+	}
+
+	template<typename Element, bool Doubled>
+	void TensorRowScalar(uint8_t const* codes, void const* table, void* dst, uint32_t count)
+	{
+		Rgb2YuvMath::TensorSpan<Element, Doubled>(codes, table, dst, 0, count);
+	}
+
+	template<typename Color, bool Fast>
+	void AyuvRowScalar(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t dstWidth)
+	{
+		Rgb2YuvMath::AyuvRowSpan<Color, Fast>(src, srcWidth, dst, 0, dstWidth);
+	}
+
+	template<typename Color, bool Fast>
+	void GreyRowScalar(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t dstWidth)
+	{
+		Rgb2YuvMath::GreyRowSpan<Color, Fast>(src, srcWidth, dst, 0, dstWidth);
+	}
+
+	template<bool SwapRB>
+	void YCoCgLumaRowScalar(uint8_t const* src, uint32_t srcWidth, uint8_t* dstY, uint32_t dstWidth)
+	{
+		Rgb2YuvMath::YCoCgLumaSpan<SwapRB>(src, srcWidth, dstY, 0, dstWidth);
+	}
+
+	template<bool SwapRB>
+	void YCoCgRowScalar(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t dstWidth)
+	{
+		Rgb2YuvMath::YCoCgRowSpan<SwapRB>(src, srcWidth, dst, 0, dstWidth);
+	}
+
+	template<bool SwapRB>
+	void YCoCgRowPairScalar(uint8_t const* src0, uint8_t const* src1, uint32_t srcWidth, CpuKernels::RowPairTarget const& dst, uint32_t dstWidth)
+	{
+		Rgb2YuvMath::YCoCgRowPairSpan<SwapRB>(src0, src1, srcWidth, dst, 0, dstWidth);
+	}
+
+	template<bool SwapRB, bool Subsampled>
+	void YCoCgInverseRowScalar(CpuKernels::InverseRowSource const& src, uint8_t* dst, uint32_t width)
+	{
+		Rgb2YuvMath::YCoCgInverseSpan<SwapRB, Subsampled>(src, dst, 0, width);
+	}
+
+	// Plain C++ has no non-temporal stores; the streaming entries are the ordinary kernels. 16-bit stores
+	// have no fast tier, and YCoCg-R has no tiers at all.
+	template<typename Color, bool Fast, Rgb2YuvMath::KernelStore Store>
+	constexpr CpuKernels::RowKernels MakeScalarKernels()
+	{
+		constexpr bool planar = Rgb2YuvMath::IsPlanarStore(Store);
+		if constexpr (Store == Rgb2YuvMath::KernelStore::YCoCg444)
+		{
+			constexpr bool swap = Color::SwapRB;
+			return { YCoCgLumaRowScalar<swap>, nullptr, nullptr, YCoCgRowScalar<swap>, YCoCgRowScalar<swap>, YCoCgInverseRowScalar<swap, false> };
+		}
+		else if constexpr (Store == Rgb2YuvMath::KernelStore::YCoCg420)
+		{
+			constexpr bool swap = Color::SwapRB;
+			return { YCoCgLumaRowScalar<swap>, YCoCgRowPairScalar<swap>, YCoCgRowPairScalar<swap>, nullptr, nullptr, YCoCgInverseRowScalar<swap, true> };
+		}
+		else if constexpr (Rgb2YuvMath::IsWideStore(Store))
+		{
+			return { LumaRowScalar<Color, false>, RowPairScalar<Color, false, planar, false>, RowPairScalar<Color, false, planar, false>, nullptr, nullptr, nullptr };
+		}
+		else if constexpr (Store == Rgb2YuvMath::KernelStore::Ayuv)
+		{
+			return { LumaRowScalar<Color, Fast>, nullptr, nullptr, AyuvRowScalar<Color, Fast>, AyuvRowScalar<Color, Fast>, nullptr };
+		}
+		else if constexpr (Store == Rgb2YuvMath::KernelStore::Grey)
+		{
+			return { LumaRowScalar<Color, Fast>, nullptr, nullptr, GreyRowScalar<Color, Fast>, GreyRowScalar<Color, Fast>, nullptr };
+		}
+		else if constexpr (Rgb2YuvMath::IsPackedStore(Store))
+		{
+			constexpr bool uyvy = Store == Rgb2YuvMath::KernelStore::Uyvy;
+			return { LumaRowScalar<Color, Fast>, nullptr, nullptr, PackedRowScalar<Color, Fast, uyvy>, PackedRowScalar<Color, Fast, uyvy>, nullptr };
+		}
+		else if constexpr (Rgb2YuvMath::IsRowStore(Store))
+		{
+			constexpr bool full = Rgb2YuvMath::IsFullChromaStore(Store);
+			return { LumaRowScalar<Color, Fast>, nullptr, nullptr, RowScalar<Color, Fast, planar, full>, RowScalar<Color, Fast, planar, full>, nullptr };
+		}
+		else
+		{
+			constexpr bool alpha = Store == Rgb2YuvMath::KernelStore::InterleavedAlpha;
+			return { LumaRowScalar<Color, Fast>, RowPairScalar<Color, Fast, planar, alpha>, RowPairScalar<Color, Fast, planar, alpha>, nullptr, nullptr, nullptr };
+		}
+	}
+
+	template<typename Color, Rgb2YuvMath::KernelStore Store>
+	struct ScalarFamily
+	{
+		static constexpr CpuKernels::RowKernels BitExact = MakeScalarKernels<Color, false, Store>();
+		static constexpr CpuKernels::RowKernels Fast = MakeScalarKernels<Color, true, Store>();
+		static constexpr CpuKernels::RowKernels Dithered = MakeScalarKernels<Rgb2YuvMath::DitheredColor<Color>, false, Store>();
+	};
+}
+
+namespace CpuKernels
+{
+	KernelTable const ScalarKernels =
+	{
+		"scalar",
+		Rgb2YuvMath::KernelRegistry<ScalarFamily>::Entries,
+		Rgb2YuvMath::KernelRegistry<ScalarFamily>::EntryCount,
+		{ TensorRowScalar<float, false>, TensorRowScalar<float, true>, TensorRowScalar<uint16_t, false>, TensorRowScalar<uint16_t, true> },
+	};
+}
@@ -0,0 +1,875 @@
+// CpuKernelsSse41.cpp: SSSE3/SSE4.1 row kernels, 16 pixels per iteration, for hosts without AVX2.
+// Built with SSE4.1 code generation; only call through Sse41Kernels.
+
+#include "CpuKernels.h"
+#include "CpuKernelRegistry.h"
+
+#include <smmintrin.h>
+
+using namespace Rgb2YuvMath;
+
+namespace
+{
+	__m128i WordPair(int16_t low, int16_t high)
+	{
+		return _mm_set1_epi32(static_cast<int32_t>((static_cast<uint32_t>(static_cast<uint16_t>(high)) << 16) | static_cast<uint16_t>(low)));
+	}
+
+	__m128i WordQuad(int16_t b, int16_t g, int16_t r)
+	{
+		return _mm_setr_epi16(b, g, r, 0, b, g, r, 0);
+	}
+
+	// Same as the AVX2 version: float estimate, then an exact remainder correction (pmulld is SSE4.1).
+	__m128i RoundedDivide(__m128i n, __m128i rounding, int32_t denominator)
+	{
+		__m128i d = _mm_set1_epi32(denominator);
+		n = _mm_add_epi32(n, rounding);
+
+		__m128i q = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(n), _mm_set1_ps(1.0f / denominator)));
+		__m128i r = _mm_sub_epi32(n, _mm_mullo_epi32(q, d));
+
+		q = _mm_add_epi32(q, _mm_cmplt_epi32(r, _mm_setzero_si128()));
+		q = _mm_sub_epi32(q, _mm_cmpgt_epi32(r, _mm_sub_epi32(d, _mm_set1_epi32(1))));
+		return q;
+	}
+
+	// Saturates 8 int32 results to 16-bit samples of Color, shifted into place.
+	template<typename Color>
+	__m128i PackToWords(__m128i q0, __m128i q1)
+	{
+		__m128i words = _mm_packus_epi32(q0, q1);
+		if (Color::SampleBits < 16)
+			words = _mm_min_epu16(words, _mm_set1_epi16(static_cast<int16_t>(MaxSample<Color>())));
+		return _mm_slli_epi16(words, Color::SampleShift);
+	}
+
+	// Luma roundings of 4 pixels from image position (x, y) on. The dither pattern repeats every 4 pixels,
+	// so they hold for every later group of 4 in the row, and without dithering they're all the same.
+	template<typename Color>
+	__m128i LumaRounding(uint32_t x, uint32_t y)
+	{
+		return _mm_setr_epi32(LumaRoundingAt<Color>(x, y), LumaRoundingAt<Color>(x + 1, y), LumaRoundingAt<Color>(x + 2, y), LumaRoundingAt<Color>(x + 3, y));
+	}
+
+	// The same for 4 chroma samples from (x, y) of the chroma plane on.
+	template<typename Color>
+	__m128i ChromaRounding(uint32_t x, uint32_t y)
+	{
+		return _mm_setr_epi32(ChromaRoundingAt<Color>(x, y), ChromaRoundingAt<Color>(x + 1, y), ChromaRoundingAt<Color>(x + 2, y), ChromaRoundingAt<Color>(x + 3, y));
+	}
+
+	__m128i Load(uint8_t const* src)
+	{
+		return _mm_loadu_si128(reinterpret_cast<__m128i const*>(src));
+	}
+
+	// OutputY for 4 pixels; one int32 per lane.
+	template<typename Color>
+	__m128i Luma4(__m128i pixels, __m128i rounding)
+	{
+		__m128i byteMask = _mm_set1_epi32(0x00FF00FF);
+
+		__m128i br = _mm_and_si128(pixels, byteMask);
+		__m128i ga = _mm_and_si128(_mm_srli_epi32(pixels, 8), byteMask);
+
+		__m128i high = _mm_add_epi32(
+			_mm_madd_epi16(br, WordPair(HighPart(Color::YB), HighPart(Color::YR))),
+			_mm_madd_epi16(ga, WordPair(HighPart(Color::YG), 0)));
+		__m128i low = _mm_add_epi32(
+			_mm_madd_epi16(br, WordPair(LowPart(Color::YB), LowPart(Color::YR))),
+			_mm_madd_epi16(ga, WordPair(LowPart(Color::YG), 0)));
+
+		__m128i n = _mm_add_epi32(_mm_slli_epi32(high, SplitShift), low);
+		return RoundedDivide(_mm_slli_epi32(n, Color::LumaNumeratorShift), rounding, Color::LumaDivisor);
+	}
+
+	// Fast tier: pmaddubsw on [R, G, B, G] byte pairs, then pmaddwd to add the two halves.
+	template<typename Color>
+	__m128i LumaFast4(__m128i pixels)
+	{
+		__m128i rgbg = _mm_shuffle_epi8(
+			pixels,
+			_mm_setr_epi8(2, 1, 0, 1, 6, 5, 4, 5, 10, 9, 8, 9, 14, 13, 12, 13));
+		__m128i coefficients = _mm_set1_epi32(
+			Color::FastYR | (Color::FastYGWithR << 8) | (Color::FastYB << 16) | (Color::FastYGWithB << 24));
+
+		__m128i n = _mm_madd_epi16(_mm_maddubs_epi16(rgbg, coefficients), _mm_set1_epi16(1));
+		return _mm_srai_epi32(_mm_add_epi32(n, _mm_set1_epi32(Color::FastLumaRounding)), FastShift);
+	}
+
+	// Sums each horizontal pixel pair of two rows: 4 pixels per row in, [B, G, R, A] words for 2 quads out.
+	__m128i QuadSums(__m128i row0, __m128i row1)
+	{
+		__m128i pairBytes = _mm_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15);
+		__m128i ones = _mm_set1_epi8(1);
+
+		return _mm_add_epi16(
+			_mm_maddubs_epi16(_mm_shuffle_epi8(row0, pairBytes), ones),
+			_mm_maddubs_epi16(_mm_shuffle_epi8(row1, pairBytes), ones));
+	}
+
+	// One chroma component for 4 quads, in order.
+	template<typename Color>
+	__m128i ChromaComponent4(__m128i sumsA, __m128i sumsB, int32_t cb, int32_t cg, int32_t cr, __m128i rounding)
+	{
+		__m128i highCoefficients = WordQuad(HighPart(cb), HighPart(cg), HighPart(cr));
+		__m128i lowCoefficients = WordQuad(LowPart(cb), LowPart(cg), LowPart(cr));
+
+		__m128i high = _mm_hadd_epi32(_mm_madd_epi16(sumsA, highCoefficients), _mm_madd_epi16(sumsB, highCoefficients));
+		__m128i low = _mm_hadd_epi32(_mm_madd_epi16(sumsA, lowCoefficients), _mm_madd_epi16(sumsB, lowCoefficients));
+
+		__m128i n = _mm_add_epi32(_mm_slli_epi32(high, SplitShift), low);
+		return RoundedDivide(_mm_slli_epi32(n, Color::ChromaNumeratorShift), rounding, Color::ChromaDivisor);
+	}
+
+	// Fast tier: rounds the quad average to 8 bits, then a single madd with the Q8 coefficients.
+	__m128i ChromaComponentFast4(__m128i averagesA, __m128i averagesB, int16_t cb, int16_t cg, int16_t cr, int32_t rounding)
+	{
+		__m128i coefficients = WordQuad(cb, cg, cr);
+		__m128i n = _mm_hadd_epi32(_mm_madd_epi16(averagesA, coefficients), _mm_madd_epi16(averagesB, coefficients));
+		return _mm_srai_epi32(_mm_add_epi32(n, _mm_set1_epi32(rounding)), FastShift);
+	}
+
+	__m128i QuadAverages(__m128i sums)
+	{
+		return _mm_srli_epi16(_mm_add_epi16(sums, _mm_set1_epi16(2)), 2);
+	}
+
+	// U and V as int32 for 4 quads, from their [B, G, R, A] sums, 2 quads in each vector.
+	template<typename Color>
+	void ExactChroma4(__m128i sumsA, __m128i sumsB, __m128i rounding, __m128i* u, __m128i* v)
+	{
+		*u = ChromaComponent4<Color>(sumsA, sumsB, Color::UB, Color::UG, Color::UR, rounding);
+		*v = ChromaComponent4<Color>(sumsA, sumsB, Color::VB, Color::VG, Color::VR, rounding);
+	}
+
+	// Interleaved U/V as int16 for 4 quads, from their [B, G, R, A] sums, 2 quads in each vector. The fast
+	// tier ignores rounding.
+	template<typename Color, bool Fast>
+	__m128i QuadChroma4(__m128i sumsA, __m128i sumsB, __m128i rounding)
+	{
+		__m128i u;
+		__m128i v;
+		if (Fast)
+		{
+			__m128i averagesA = QuadAverages(sumsA);
+			__m128i averagesB = QuadAverages(sumsB);
+			u = ChromaComponentFast4(averagesA, averagesB, Color::FastUB, Color::FastUG, Color::FastUR, Color::FastChromaRounding);
+			v = ChromaComponentFast4(averagesA, averagesB, Color::FastVB, Color::FastVG, Color::FastVR, Color::FastChromaRounding);
+		}
+		else
+		{
+			ExactChroma4<Color>(sumsA, sumsB, rounding, &u, &v);
+		}
+
+		return _mm_packs_epi32(_mm_unpacklo_epi32(u, v), _mm_unpackhi_epi32(u, v));
+	}
+
+	// OutputUV for 8 pixels of two rows: interleaved U/V for 4 quads as int16.
+	template<typename Color, bool Fast>
+	__m128i Chroma4(__m128i const* row0, __m128i const* row1, __m128i rounding)
+	{
+		return QuadChroma4<Color, Fast>(QuadSums(row0[0], row1[0]), QuadSums(row0[1], row1[1]), rounding);
+	}
+
+	// 4:4:4 chroma of 4 pixels, each taken as a quad of four copies of itself (see RowSpan): interleaved
+	// U/V as int16, in pixel order.
+	template<typename Color, bool Fast>
+	__m128i PixelChroma4(__m128i pixels, __m128i rounding)
+	{
+		__m128i zero = _mm_setzero_si128();
+		return QuadChroma4<Color, Fast>(_mm_slli_epi16(_mm_unpacklo_epi8(pixels, zero), 2), _mm_slli_epi16(_mm_unpackhi_epi8(pixels, zero), 2), rounding);
+	}
+
+	template<typename Color, bool Fast>
+	__m128i LumaAny4(__m128i pixels, __m128i rounding)
+	{
+		return Fast ? LumaFast4<Color>(pixels) : Luma4<Color>(pixels, rounding);
+	}
+
+	// 16 luma bytes from 16 pixels.
+	template<typename Color, bool Fast>
+	__m128i Luma16(__m128i const* pixels, __m128i rounding)
+	{
+		return _mm_packus_epi16(
+			_mm_packs_epi32(LumaAny4<Color, Fast>(pixels[0], rounding), LumaAny4<Color, Fast>(pixels[1], rounding)),
+			_mm_packs_epi32(LumaAny4<Color, Fast>(pixels[2], rounding), LumaAny4<Color, Fast>(pixels[3], rounding)));
+	}
+
+	// 16 alpha bytes from 16 pixels.
+	__m128i Alpha16(__m128i const* pixels)
+	{
+		return _mm_packus_epi16(
+			_mm_packs_epi32(_mm_srli_epi32(pixels[0], 24), _mm_srli_epi32(pixels[1], 24)),
+			_mm_packs_epi32(_mm_srli_epi32(pixels[2], 24), _mm_srli_epi32(pixels[3], 24)));
+	}
+
+	template<bool Stream>
+	void Store(uint8_t* dst, __m128i bytes)
+	{
+		if (Stream)
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst), bytes);
+		else
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), bytes);
+	}
+
+	// The low 8 bytes.
+	template<bool Stream>
+	void StoreHalf(uint8_t* dst, __m128i bytes)
+	{
+		if (Stream)
+		{
+#if defined(_M_X64) || defined(__x86_64__)
+			_mm_stream_si64(reinterpret_cast<long long*>(dst), _mm_cvtsi128_si64(bytes));
+#else
+			_mm_stream_si32(reinterpret_cast<int*>(dst), _mm_cvtsi128_si32(bytes));
+			_mm_stream_si32(reinterpret_cast<int*>(dst + 4), _mm_cvtsi128_si32(_mm_srli_si128(bytes, 4)));
+#endif
+		}
+		else
+		{
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst), bytes);
+		}
+	}
+
+	// [U0 V0 U1 V1 ...] bytes split into [U0 U1 ... V0 V1 ...].
+	__m128i SplitChroma(__m128i uv)
+	{
+		return _mm_shuffle_epi8(uv, _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15));
+	}
+
+	// Chroma bytes [U0 V0 U1 V1 ...] of 8 pairs, as they are or split into 8 bytes each of U and V. x is
+	// the offset of the pairs in an interleaved chroma row; planar rows are half as wide.
+	template<bool Planar, bool Stream, typename Target>
+	void StoreChroma(Target const& dst, uint32_t x, __m128i uv)
+	{
+		if (Planar)
+		{
+			__m128i split = SplitChroma(uv);
+			StoreHalf<Stream>(dst.U + x / 2, split);
+			StoreHalf<Stream>(dst.V + x / 2, _mm_unpackhi_epi64(split, split));
+		}
+		else
+		{
+			Store<Stream>(dst.UV + x, uv);
+		}
+	}
+
+	void Load16(uint8_t const* src, __m128i* pixels)
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			pixels[i] = Load(src + i * 16);
+		}
+	}
+
+	template<typename Color, bool Fast>
+	void LumaRowSse41(uint8_t const* src, uint32_t srcWidth, uint8_t* dstY, uint32_t dstWidth)
+	{
+		__m128i rounding = LumaRounding<Color>(0, 0);
+		uint32_t x = 0;
+		for (; x + 16 <= srcWidth; x += 16)
+		{
+			__m128i pixels[4];
+			Load16(src + x * 4, pixels);
+			if constexpr (Color::SampleBits > 8)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dstY + x * 2), PackToWords<Color>(Luma4<Color>(pixels[0], rounding), Luma4<Color>(pixels[1], rounding)));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dstY + x * 2 + 16), PackToWords<Color>(Luma4<Color>(pixels[2], rounding), Luma4<Color>(pixels[3], rounding)));
+			}
+			else
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dstY + x), Luma16<Color, Fast>(pixels, rounding));
+			}
+		}
+
+		LumaSpan<Color, Fast>(src, srcWidth, dstY, x, dstWidth);
+	}
+
+	// One I400 row: LumaRowSse41 with the luma dithered by image position, and streaming like the Row
+	// kernels. Nothing but the pixels is loaded and nothing but luma stored.
+	template<typename Color, bool Fast, bool Stream>
+	void GreyRowSse41(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t dstWidth)
+	{
+		uint32_t x = 0;
+		if (Stream)
+		{
+			if (!GetPackedStreamingHead(dst.Y, 16, dstWidth, &x, 1))
+			{
+				GreyRowSse41<Color, Fast, false>(src, srcWidth, dst, dstWidth);
+				return;
+			}
+
+			GreyRowSpan<Color, Fast>(src, srcWidth, dst, 0, x);
+		}
+
+		__m128i rounding = LumaRounding<Color>(dst.Left + x, dst.Top);
+		for (; x + 16 <= srcWidth; x += 16)
+		{
+			if (Stream)
+				_mm_prefetch(reinterpret_cast<char const*>(src + x * 4 + PrefetchDistance), _MM_HINT_T0);
+
+			__m128i pixels[4];
+			Load16(src + x * 4, pixels);
+			Store<Stream>(dst.Y + x, Luma16<Color, Fast>(pixels, rounding));
+		}
+
+		GreyRowSpan<Color, Fast>(src, srcWidth, dst, x, dstWidth);
+
+		if (Stream)
+			_mm_sfence();
+	}
+
+	// Every source pixel is loaded once and feeds its luma value, its chroma quad and, with Alpha, the alpha
+	// rows.
+	template<typename Color, bool Fast, bool Planar, bool Alpha, bool Stream>
+	void RowPairSse41(uint8_t const* src0, uint8_t const* src1, uint32_t srcWidth, CpuKernels::RowPairTarget const& dst, uint32_t dstWidth)
+	{
+		uint32_t x = 0;
+		if (Stream)
+		{
+			if (!GetStreamingHead(dst, Planar, Alpha, 16, dstWidth, &x))
+			{
+				RowPairSse41<Color, Fast, Planar, Alpha, false>(src0, src1, srcWidth, dst, dstWidth);
+				return;
+			}
+
+			RowPairSpan<Color, Fast, Planar, Alpha>(src0, src1, srcWidth, dst, 0, x);
+		}
+
+		__m128i luma0 = LumaRounding<Color>(dst.Left + x, dst.Top);
+		__m128i luma1 = LumaRounding<Color>(dst.Left + x, dst.Top + 1);
+		__m128i chroma = ChromaRounding<Color>((dst.Left + x) / 2, dst.Top / 2);
+		for (; x + 16 <= srcWidth; x += 16)
+		{
+			if (Stream)
+			{
+				_mm_prefetch(reinterpret_cast<char const*>(src0 + x * 4 + PrefetchDistance), _MM_HINT_T0);
+				_mm_prefetch(reinterpret_cast<char const*>(src1 + x * 4 + PrefetchDistance), _MM_HINT_T0);
+			}
+
+			__m128i row0[4];
+			__m128i row1[4];
+			Load16(src0 + x * 4, row0);
+			Load16(src1 + x * 4, row1);
+
+			Store<Stream>(dst.Y0 + x, Luma16<Color, Fast>(row0, luma0));
+			Store<Stream>(dst.Y1 + x, Luma16<Color, Fast>(row1, luma1));
+			StoreChroma<Planar, Stream>(dst, x, _mm_packus_epi16(Chroma4<Color, Fast>(row0, row1, chroma), Chroma4<Color, Fast>(row0 + 2, row1 + 2, chroma)));
+
+			if (Alpha)
+			{
+				Store<Stream>(dst.A0 + x, Alpha16(row0));
+				Store<Stream>(dst.A1 + x, Alpha16(row1));
+			}
+		}
+
+		RowPairSpan<Color, Fast, Planar, Alpha>(src0, src1, srcWidth, dst, x, dstWidth);
+
+		// Non-temporal stores are weakly ordered; fence them before the caller signals completion.
+		if (Stream)
+			_mm_sfence();
+	}
+
+	// RowPairSse41 for 16-bit samples, always exact: luma and chroma stay int32 until PackToWords, so every
+	// vector of pixels fills twice the bytes.
+	template<typename Color, bool Planar, bool Stream>
+	void RowPairWideSse41(uint8_t const* src0, uint8_t const* src1, uint32_t srcWidth, CpuKernels::RowPairTarget const& dst, uint32_t dstWidth)
+	{
+		uint32_t x = 0;
+		if (Stream)
+		{
+			if (!GetStreamingHead(dst, Planar, false, 16, dstWidth, &x, 2))
+			{
+				RowPairWideSse41<Color, Planar, false>(src0, src1, srcWidth, dst, dstWidth);
+				return;
+			}
+
+			RowPairSpan<Color, false, Planar, false>(src0, src1, srcWidth, dst, 0, x);
+		}
+
+		__m128i luma0 = LumaRounding<Color>(dst.Left + x, dst.Top);
+		__m128i luma1 = LumaRounding<Color>(dst.Left + x, dst.Top + 1);
+		__m128i chroma = ChromaRounding<Color>((dst.Left + x) / 2, dst.Top / 2);
+		for (; x + 16 <= srcWidth; x += 16)
+		{
+			if (Stream)
+			{
+				_mm_prefetch(reinterpret_cast<char const*>(src0 + x * 4 + PrefetchDistance), _MM_HINT_T0);
+				_mm_prefetch(reinterpret_cast<char const*>(src1 + x * 4 + PrefetchDistance), _MM_HINT_T0);
+			}
+
+			__m128i row0[4];
+			__m128i row1[4];
+			Load16(src0 + x * 4, row0);
+			Load16(src1 + x * 4, row1);
+
+			Store<Stream>(dst.Y0 + x * 2, PackToWords<Color>(Luma4<Color>(row0[0], luma0), Luma4<Color>(row0[1], luma0)));
+			Store<Stream>(dst.Y0 + x * 2 + 16, PackToWords<Color>(Luma4<Color>(row0[2], luma0), Luma4<Color>(row0[3], luma0)));
+			Store<Stream>(dst.Y1 + x * 2, PackToWords<Color>(Luma4<Color>(row1[0], luma1), Luma4<Color>(row1[1], luma1)));
+			Store<Stream>(dst.Y1 + x * 2 + 16, PackToWords<Color>(Luma4<Color>(row1[2], luma1), Luma4<Color>(row1[3], luma1)));
+
+			// Quads 0-3 and 4-7.
+			__m128i uA;
+			__m128i vA;
+			__m128i uB;
+			__m128i vB;
+			ExactChroma4<Color>(QuadSums(row0[0], row1[0]), QuadSums(row0[1], row1[1]), chroma, &uA, &vA);
+			ExactChroma4<Color>(QuadSums(row0[2], row1[2]), QuadSums(row0[3], row1[3]), chroma, &uB, &vB);
+			if (Planar)
+			{
+				Store<Stream>(dst.U + x, PackToWords<Color>(uA, uB));
+				Store<Stream>(dst.V + x, PackToWords<Color>(vA, vB));
+			}
+			else
+			{
+				Store<Stream>(dst.UV + x * 2, PackToWords<Color>(_mm_unpacklo_epi32(uA, vA), _mm_unpackhi_epi32(uA, vA)));
+				Store<Stream>(dst.UV + x * 2 + 16, PackToWords<Color>(_mm_unpacklo_epi32(uB, vB), _mm_unpackhi_epi32(uB, vB)));
+			}
+		}
+
+		RowPairSpan<Color, false, Planar, false>(src0, src1, srcWidth, dst, x, dstWidth);
+
+		if (Stream)
+			_mm_sfence();
+	}
+
+	// One packed 4:2:2 row. The chroma of a pixel pair is Chroma4 with the row passed as both rows (see
+	// PackedRowSpan), and interleaving it bytewise with the luma gives YUY2 or UYVY order directly.
+	template<typename Color, bool Fast, bool Uyvy, bool Stream>
+	void PackedRowSse41(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t dstWidth)
+	{
+		uint32_t x = 0;
+		if (Stream)
+		{
+			if (!GetPackedStreamingHead(dst.Y, 16, dstWidth, &x))
+			{
+				PackedRowSse41<Color, Fast, Uyvy, false>(src, srcWidth, dst, dstWidth);
+				return;
+			}
+
+			PackedRowSpan<Color, Fast, Uyvy>(src, srcWidth, dst, 0, x);
+		}
+
+		__m128i lumaRounding = LumaRounding<Color>(dst.Left + x, dst.Top);
+		__m128i chromaRounding = ChromaRounding<Color>((dst.Left + x) / 2, dst.Top);
+		for (; x + 16 <= srcWidth; x += 16)
+		{
+			if (Stream)
+				_mm_prefetch(reinterpret_cast<char const*>(src + x * 4 + PrefetchDistance), _MM_HINT_T0);
+
+			__m128i pixels[4];
+			Load16(src + x * 4, pixels);
+
+			__m128i luma = Luma16<Color, Fast>(pixels, lumaRounding);
+			__m128i chroma = _mm_packus_epi16(Chroma4<Color, Fast>(pixels, pixels, chromaRounding), Chroma4<Color, Fast>(pixels + 2, pixels + 2, chromaRounding));
+			Store<Stream>(dst.Y + x * 2, Uyvy ? _mm_unpacklo_epi8(chroma, luma) : _mm_unpacklo_epi8(luma, chroma));
+			Store<Stream>(dst.Y + x * 2 + 16, Uyvy ? _mm_unpackhi_epi8(chroma, luma) : _mm_unpackhi_epi8(luma, chroma));
+		}
+
+		PackedRowSpan<Color, Fast, Uyvy>(src, srcWidth, dst, x, dstWidth);
+
+		if (Stream)
+			_mm_sfence();
+	}
+
+	// One row of 4:2:2 or 4:4:4 (FullChroma) luma and chroma; see RowSpan.
+	template<typename Color, bool Fast, bool Planar, bool FullChroma, bool Stream>
+	void RowSse41(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t dstWidth)
+	{
+		uint32_t x = 0;
+		if (Stream)
+		{
+			if (!GetRowStreamingHead(dst, Planar, FullChroma, 16, dstWidth, &x))
+			{
+				RowSse41<Color, Fast, Planar, FullChroma, false>(src, srcWidth, dst, dstWidth);
+				return;
+			}
+
+			RowSpan<Color, Fast, Planar, FullChroma>(src, srcWidth, dst, 0, x);
+		}
+
+		__m128i lumaRounding = LumaRounding<Color>(dst.Left + x, dst.Top);
+		__m128i chromaRounding = ChromaRounding<Color>(FullChroma ? dst.Left + x : (dst.Left + x) / 2, dst.Top);
+		for (; x + 16 <= srcWidth; x += 16)
+		{
+			if (Stream)
+				_mm_prefetch(reinterpret_cast<char const*>(src + x * 4 + PrefetchDistance), _MM_HINT_T0);
+
+			__m128i pixels[4];
+			Load16(src + x * 4, pixels);
+
+			Store<Stream>(dst.Y + x, Luma16<Color, Fast>(pixels, lumaRounding));
+
+			if (FullChroma)
+			{
+				// 16 pairs, 8 per vector; as an interleaved row they start at 2 * x.
+				__m128i a = _mm_packus_epi16(PixelChroma4<Color, Fast>(pixels[0], chromaRounding), PixelChroma4<Color, Fast>(pixels[1], chromaRounding));
+				__m128i b = _mm_packus_epi16(PixelChroma4<Color, Fast>(pixels[2], chromaRounding), PixelChroma4<Color, Fast>(pixels[3], chromaRounding));
+				if (Planar)
+				{
+					a = SplitChroma(a);
+					b = SplitChroma(b);
+					Store<Stream>(dst.U + x, _mm_unpacklo_epi64(a, b));
+					Store<Stream>(dst.V + x, _mm_unpackhi_epi64(a, b));
+				}
+				else
+				{
+					Store<Stream>(dst.UV + x * 2, a);
+					Store<Stream>(dst.UV + x * 2 + 16, b);
+				}
+			}
+			else
+			{
+				StoreChroma<Planar, Stream>(dst, x, _mm_packus_epi16(Chroma4<Color, Fast>(pixels, pixels, chromaRounding), Chroma4<Color, Fast>(pixels + 2, pixels + 2, chromaRounding)));
+			}
+		}
+
+		RowSpan<Color, Fast, Planar, FullChroma>(src, srcWidth, dst, x, dstWidth);
+
+		if (Stream)
+			_mm_sfence();
+	}
+
+	// One AYUV row; see AyuvRowSpan. The 4:4:4 chroma of RowSse41 comes out as [V U] byte pairs, and
+	// interleaving them wordwise with [Y A] pairs gives the pixels.
+	template<typename Color, bool Fast, bool Stream>
+	void AyuvRowSse41(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t dstWidth)
+	{
+		uint32_t x = 0;
+		if (Stream)
+		{
+			if (!GetPackedStreamingHead(dst.Y, 16, dstWidth, &x, 4))
+			{
+				AyuvRowSse41<Color, Fast, false>(src, srcWidth, dst, dstWidth);
+				return;
+			}
+
+			AyuvRowSpan<Color, Fast>(src, srcWidth, dst, 0, x);
+		}
+
+		__m128i lumaRounding = LumaRounding<Color>(dst.Left + x, dst.Top);
+		__m128i chromaRounding = ChromaRounding<Color>(dst.Left + x, dst.Top);
+		for (; x + 16 <= srcWidth; x += 16)
+		{
+			if (Stream)
+				_mm_prefetch(reinterpret_cast<char const*>(src + x * 4 + PrefetchDistance), _MM_HINT_T0);
+
+			__m128i pixels[4];
+			Load16(src + x * 4, pixels);
+
+			__m128i luma = Luma16<Color, Fast>(pixels, lumaRounding);
+			__m128i alpha = Alpha16(pixels);
+			__m128i lowLumaAlpha = _mm_unpacklo_epi8(luma, alpha);
+			__m128i highLumaAlpha = _mm_unpackhi_epi8(luma, alpha);
+			__m128i a = _mm_packus_epi16(PixelChroma4<Color, Fast>(pixels[0], chromaRounding), PixelChroma4<Color, Fast>(pixels[1], chromaRounding));
+			__m128i b = _mm_packus_epi16(PixelChroma4<Color, Fast>(pixels[2], chromaRounding), PixelChroma4<Color, Fast>(pixels[3], chromaRounding));
+
+			uint8_t* out = dst.Y + x * 4;
+			Store<Stream>(out, _mm_unpacklo_epi16(a, lowLumaAlpha));
+			Store<Stream>(out + 16, _mm_unpackhi_epi16(a, lowLumaAlpha));
+			Store<Stream>(out + 32, _mm_unpacklo_epi16(b, highLumaAlpha));
+			Store<Stream>(out + 48, _mm_unpackhi_epi16(b, highLumaAlpha));
+		}
+
+		AyuvRowSpan<Color, Fast>(src, srcWidth, dst, x, dstWidth);
+
+		if (Stream)
+			_mm_sfence();
+	}
+
+	// YCoCg-R of 4 pixels, one int32 per lane; see YCoCg.
+	template<bool SwapRB>
+	void YCoCg4(__m128i pixels, __m128i* y, __m128i* co, __m128i* cg)
+	{
+		__m128i mask = _mm_set1_epi32(0xFF);
+		__m128i low = _mm_and_si128(pixels, mask);
+		__m128i g = _mm_and_si128(_mm_srli_epi32(pixels, 8), mask);
+		__m128i high = _mm_and_si128(_mm_srli_epi32(pixels, 16), mask);
+		__m128i r = SwapRB ? low : high;
+		__m128i b = SwapRB ? high : low;
+
+		*co = _mm_sub_epi32(r, b);
+		__m128i t = _mm_add_epi32(b, _mm_srai_epi32(*co, 1));
+		*cg = _mm_sub_epi32(g, t);
+		*y = _mm_add_epi32(t, _mm_srai_epi32(*cg, 1));
+	}
+
+	template<bool SwapRB>
+	void YCoCgLumaRowSse41(uint8_t const* src, uint32_t srcWidth, uint8_t* dstY, uint32_t dstWidth)
+	{
+		uint32_t x = 0;
+		for (; x + 8 <= srcWidth; x += 8)
+		{
+			__m128i y[2];
+			__m128i co[2];
+			__m128i cg[2];
+			YCoCg4<SwapRB>(Load(src + x * 4), &y[0], &co[0], &cg[0]);
+			YCoCg4<SwapRB>(Load(src + x * 4 + 16), &y[1], &co[1], &cg[1]);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dstY + x * 2), _mm_packs_epi32(y[0], y[1]));
+		}
+
+		YCoCgLumaSpan<SwapRB>(src, srcWidth, dstY, x, dstWidth);
+	}
+
+	// One YCoCg-R 4:4:4 row; see YCoCgRowSpan. 8 pixels fill 16 bytes of each plane.
+	template<bool SwapRB, bool Stream>
+	void YCoCgRowSse41(uint8_t const* src, uint32_t srcWidth, CpuKernels::RowTarget const& dst, uint32_t dstWidth)
+	{
+		uint32_t x = 0;
+		if (Stream)
+		{
+			uint8_t* luma[] = { dst.Y };
+			uint8_t* chroma[] = { dst.U, dst.V };
+			if (!GetYCoCgStreamingHead(luma, 1, chroma, 2, false, 16, dstWidth, &x))
+			{
+				YCoCgRowSse41<SwapRB, false>(src, srcWidth, dst, dstWidth);
+				return;
+			}
+
+			YCoCgRowSpan<SwapRB>(src, srcWidth, dst, 0, x);
+		}
+
+		for (; x + 8 <= srcWidth; x += 8)
+		{
+			if (Stream)
+				_mm_prefetch(reinterpret_cast<char const*>(src + x * 4 + PrefetchDistance), _MM_HINT_T0);
+
+			__m128i y[2];
+			__m128i co[2];
+			__m128i cg[2];
+			YCoCg4<SwapRB>(Load(src + x * 4), &y[0], &co[0], &cg[0]);
+			YCoCg4<SwapRB>(Load(src + x * 4 + 16), &y[1], &co[1], &cg[1]);
+			Store<Stream>(dst.Y + x * 2, _mm_packs_epi32(y[0], y[1]));
+			Store<Stream>(dst.U + x * 2, _mm_packs_epi32(co[0], co[1]));
+			Store<Stream>(dst.V + x * 2, _mm_packs_epi32(cg[0], cg[1]));
+		}
+
+		YCoCgRowSpan<SwapRB>(src, srcWidth, dst, x, dstWidth);
+
+		if (Stream)
+			_mm_sfence();
+	}
+
+	// Rounded averages of the 2x2 blocks of 8 pixels, as int32: sums0 and sums1 hold the vertical sums of
+	// pixels [0, 4) and [4, 8), and hadd adds the horizontal neighbours in order.
+	__m128i YCoCgQuadAverages(__m128i sums0, __m128i sums1)
+	{
+		return _mm_srai_epi32(_mm_add_epi32(_mm_hadd_epi32(sums0, sums1), _mm_set1_epi32(2)), 2);
+	}
+
+	// One YCoCg-R 4:2:0 row pair; see YCoCgRowPairSpan. 16 pixels fill 32 bytes of each luma row and 16 of
+	// each chroma row.
+	template<bool SwapRB, bool Stream>
+	void YCoCgRowPairSse41(uint8_t const* src0, uint8_t const* src1, uint32_t srcWidth, CpuKernels::RowPairTarget const& dst, uint32_t dstWidth)
+	{
+		uint32_t x = 0;
+		if (Stream)
+		{
+			uint8_t* luma[] = { dst.Y0, dst.Y1 };
+			uint8_t* chroma[] = { dst.U, dst.V };
+			if (!GetYCoCgStreamingHead(luma, 2, chroma, 2, true, 16, dstWidth, &x))
+			{
+				YCoCgRowPairSse41<SwapRB, false>(src0, src1, srcWidth, dst, dstWidth);
+				return;
+			}
+
+			YCoCgRowPairSpan<SwapRB>(src0, src1, srcWidth, dst, 0, x);
+		}
+
+		for (; x + 16 <= srcWidth; x += 16)
+		{
+			if (Stream)
+			{
+				_mm_prefetch(reinterpret_cast<char const*>(src0 + x * 4 + PrefetchDistance), _MM_HINT_T0);
+				_mm_prefetch(reinterpret_cast<char const*>(src1 + x * 4 + PrefetchDistance), _MM_HINT_T0);
+			}
+
+			__m128i y[2][4];
+			__m128i coSums[4];
+			__m128i cgSums[4];
+			for (int i = 0; i < 4; ++i)
+			{
+				__m128i co[2];
+				__m128i cg[2];
+				YCoCg4<SwapRB>(Load(src0 + x * 4 + i * 16), &y[0][i], &co[0], &cg[0]);
+				YCoCg4<SwapRB>(Load(src1 + x * 4 + i * 16), &y[1][i], &co[1], &cg[1]);
+				coSums[i] = _mm_add_epi32(co[0], co[1]);
+				cgSums[i] = _mm_add_epi32(cg[0], cg[1]);
+			}
+
+			Store<Stream>(dst.Y0 + x * 2, _mm_packs_epi32(y[0][0], y[0][1]));
+			Store<Stream>(dst.Y0 + x * 2 + 16, _mm_packs_epi32(y[0][2], y[0][3]));
+			Store<Stream>(dst.Y1 + x * 2, _mm_packs_epi32(y[1][0], y[1][1]));
+			Store<Stream>(dst.Y1 + x * 2 + 16, _mm_packs_epi32(y[1][2], y[1][3]));
+			Store<Stream>(dst.U + x, _mm_packs_epi32(YCoCgQuadAverages(coSums[0], coSums[1]), YCoCgQuadAverages(coSums[2], coSums[3])));
+			Store<Stream>(dst.V + x, _mm_packs_epi32(YCoCgQuadAverages(cgSums[0], cgSums[1]), YCoCgQuadAverages(cgSums[2], cgSums[3])));
+		}
+
+		YCoCgRowPairSpan<SwapRB>(src0, src1, srcWidth, dst, x, dstWidth);
+
+		if (Stream)
+			_mm_sfence();
+	}
+
+	// 8 pixels back from YCoCg-R words, in 16-bit lanes like YCoCgInverseSpan. packus does the clamping.
+	template<bool SwapRB>
+	void YCoCgInverse8(__m128i y, __m128i co, __m128i cg, uint8_t* dst)
+	{
+		__m128i t = _mm_sub_epi16(y, _mm_srai_epi16(cg, 1));
+		__m128i g = _mm_add_epi16(cg, t);
+		__m128i b = _mm_sub_epi16(t, _mm_srai_epi16(co, 1));
+		__m128i r = _mm_add_epi16(b, co);
+
+		// [byte 0 x8, byte 2 x8] and [G x8, A x8], interleaved into pixels.
+		__m128i outer = _mm_packus_epi16(SwapRB ? r : b, SwapRB ? b : r);
+		__m128i inner = _mm_packus_epi16(g, _mm_set1_epi16(255));
+		__m128i low = _mm_unpacklo_epi8(outer, inner);
+		__m128i high = _mm_unpackhi_epi8(outer, inner);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi16(low, high));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), _mm_unpackhi_epi16(low, high));
+	}
+
+	// One row back from YCoCg-R; see YCoCgInverseSpan. Subsampled chroma words are doubled up to one per
+	// pixel.
+	template<bool SwapRB, bool Subsampled>
+	void YCoCgInverseRowSse41(CpuKernels::InverseRowSource const& src, uint8_t* dst, uint32_t width)
+	{
+		uint32_t x = 0;
+		for (; x + 8 <= width; x += 8)
+		{
+			__m128i co;
+			__m128i cg;
+			if (Subsampled)
+			{
+				co = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(src.U + x));
+				cg = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(src.V + x));
+				co = _mm_unpacklo_epi16(co, co);
+				cg = _mm_unpacklo_epi16(cg, cg);
+			}
+			else
+			{
+				co = Load(src.U + x * 2);
+				cg = Load(src.V + x * 2);
+			}
+
+			YCoCgInverse8<SwapRB>(Load(src.Y + x * 2), co, cg, dst + x * 4);
+		}
+
+		YCoCgInverseSpan<SwapRB, Subsampled>(src, dst, x, width);
+	}
+
+	// Tensor rows, 4 floats per iteration. There are no gathers, so the lookups are scalar, but they're
+	// assembled in a register and stored 16 bytes at a time.
+	template<bool Doubled>
+	void TensorRowFloat32Sse41(uint8_t const* codes, void const* table, void* dst, uint32_t count)
+	{
+		float const* elements = static_cast<float const*>(table);
+		float* row = static_cast<float*>(dst);
+		uint32_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			uint8_t const* c = codes + (Doubled ? i / 2 : i);
+			if (Doubled)
+			{
+				__m128 pair = _mm_setr_ps(elements[c[0]], elements[c[1]], 0.0f, 0.0f);
+				_mm_storeu_ps(row + i, _mm_unpacklo_ps(pair, pair));
+			}
+			else
+			{
+				_mm_storeu_ps(row + i, _mm_setr_ps(elements[c[0]], elements[c[1]], elements[c[2]], elements[c[3]]));
+			}
+		}
+
+		TensorSpan<float, Doubled>(codes, table, dst, i, count);
+	}
+
+	// The same for binary16 elements, 8 per iteration.
+	template<bool Doubled>
+	void TensorRowFloat16Sse41(uint8_t const* codes, void const* table, void* dst, uint32_t count)
+	{
+		uint16_t const* elements = static_cast<uint16_t const*>(table);
+		uint16_t* row = static_cast<uint16_t*>(dst);
+		uint32_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			uint8_t const* c = codes + (Doubled ? i / 2 : i);
+			if (Doubled)
+			{
+				__m128i quad = _mm_setr_epi16(elements[c[0]], elements[c[1]], elements[c[2]], elements[c[3]], 0, 0, 0, 0);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(row + i), _mm_unpacklo_epi16(quad, quad));
+			}
+			else
+			{
+				__m128i eight = _mm_setr_epi16(elements[c[0]], elements[c[1]], elements[c[2]], elements[c[3]],
+					elements[c[4]], elements[c[5]], elements[c[6]], elements[c[7]]);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(row + i), eight);
+			}
+		}
+
+		TensorSpan<uint16_t, Doubled>(codes, table, dst, i, count);
+	}
+
+	template<typename Color, bool Fast, KernelStore Store>
+	constexpr CpuKernels::RowKernels MakeSse41Kernels()
+	{
+		constexpr bool planar = IsPlanarStore(Store);
+		if constexpr (Store == KernelStore::YCoCg444)
+		{
+			constexpr bool swap = Color::SwapRB;
+			return { YCoCgLumaRowSse41<swap>, nullptr, nullptr, YCoCgRowSse41<swap, false>, YCoCgRowSse41<swap, true>, YCoCgInverseRowSse41<swap, false> };
+		}
+		else if constexpr (Store == KernelStore::YCoCg420)
+		{
+			constexpr bool swap = Color::SwapRB;
+			return { YCoCgLumaRowSse41<swap>, YCoCgRowPairSse41<swap, false>, YCoCgRowPairSse41<swap, true>, nullptr, nullptr, YCoCgInverseRowSse41<swap, true> };
+		}
+		else if constexpr (IsWideStore(Store))
+		{
+			return { LumaRowSse41<Color, false>, RowPairWideSse41<Color, planar, false>, RowPairWideSse41<Color, planar, true>, nullptr, nullptr, nullptr };
+		}
+		else if constexpr (Store == KernelStore::Ayuv)
+		{
+			return { LumaRowSse41<Color, Fast>, nullptr, nullptr, AyuvRowSse41<Color, Fast, false>, AyuvRowSse41<Color, Fast, true>, nullptr };
+		}
+		else if constexpr (Store == KernelStore::Grey)
+		{
+			return { LumaRowSse41<Color, Fast>, nullptr, nullptr, GreyRowSse41<Color, Fast, false>, GreyRowSse41<Color, Fast, true>, nullptr };
+		}
+		else if constexpr (IsPackedStore(Store))
+		{
+			constexpr bool uyvy = Store == KernelStore::Uyvy;
+			return { LumaRowSse41<Color, Fast>, nullptr, nullptr, PackedRowSse41<Color, Fast, uyvy, false>, PackedRowSse41<Color, Fast, uyvy, true>, nullptr };
+		}
+		else if constexpr (IsRowStore(Store))
+		{
+			constexpr bool full = IsFullChromaStore(Store);
+			return { LumaRowSse41<Color, Fast>, nullptr, nullptr, RowSse41<Color, Fast, planar, full, false>, RowSse41<Color, Fast, planar, full, true>, nullptr };
+		}
+		else
+		{
+			constexpr bool alpha = Store == KernelStore::InterleavedAlpha;
+			return { LumaRowSse41<Color, Fast>, RowPairSse41<Color, Fast, planar, alpha, false>, RowPairSse41<Color, Fast, planar, alpha, true>, nullptr, nullptr, nullptr };
+		}
+	}
+
+	template<typename Color, KernelStore Store>
+	struct Sse41Family
+	{
+		static constexpr CpuKernels::RowKernels BitExact = MakeSse41Kernels<Color, false, Store>();
+		static constexpr CpuKernels::RowKernels Fast = MakeSse41Kernels<Color, true, Store>();
+		static constexpr CpuKernels::RowKernels Dithered = MakeSse41Kernels<DitheredColor<Color>, false, Store>();
+	};
+}
+
+namespace CpuKernels
+{
+	KernelTable const Sse41Kernels =
+	{
+		"sse41",
+		KernelRegistry<Sse41Family>::Entries,
+		KernelRegistry<Sse41Family>::EntryCount,
+		{ TensorRowFloat32Sse41<false>, TensorRowFloat32Sse41<true>, TensorRowFloat16Sse41<false>, TensorRowFloat16Sse41<true> },
+	};
+}
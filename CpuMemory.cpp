@@ -0,0 +1,215 @@
+// CpuMemory.cpp: Page-aligned, optionally huge-page, plane allocations.
+
+#include "CpuMemory.h"
+
+#include <new>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// Huge page size on x86 and most 64-bit Arm hosts. Mappings meant for huge pages are rounded up to it.
+	size_t const HugePageSize = size_t(2) << 20;
+
+	// Stride for prefaulting: the smallest page size, since huge page requests can silently end up on
+	// small pages.
+	size_t const SmallPageSize = 4096;
+
+	size_t RoundUp(size_t size, size_t granularity)
+	{
+		return (size + granularity - 1) / granularity * granularity;
+	}
+
+#if defined(_WIN32)
+	void* MapPages(size_t size, CpuPageMode* pageMode, size_t* mappedSize)
+	{
+		if (*pageMode == CpuPageMode::ExplicitHuge)
+		{
+			size_t largePage = GetLargePageMinimum();
+			if (largePage != 0)
+			{
+				*mappedSize = RoundUp(size, largePage);
+				void* data = VirtualAlloc(nullptr, *mappedSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+				if (data)
+					return data;
+			}
+		}
+
+		// Windows has no transparent huge pages for ordinary allocations.
+		*pageMode = CpuPageMode::Default;
+		*mappedSize = size;
+		return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	}
+
+	void UnmapPages(void* data, size_t)
+	{
+		VirtualFree(data, 0, MEM_RELEASE);
+	}
+#else
+	void* MapPages(size_t size, CpuPageMode* pageMode, size_t* mappedSize)
+	{
+#if defined(MAP_HUGETLB)
+		if (*pageMode == CpuPageMode::ExplicitHuge)
+		{
+			*mappedSize = RoundUp(size, HugePageSize);
+			void* data = mmap(nullptr, *mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (data != MAP_FAILED)
+				return data;
+
+			// No reserved huge pages; transparent ones need no setup.
+			*pageMode = CpuPageMode::TransparentHuge;
+		}
+#endif
+
+#if defined(MADV_HUGEPAGE)
+		if (*pageMode != CpuPageMode::Default)
+		{
+			// Huge pages only back aligned 2 MiB ranges, so map enough to align the start and trim the rest.
+			size_t alignedSize = RoundUp(size, HugePageSize);
+			size_t oversize = alignedSize + HugePageSize;
+			void* mapping = mmap(nullptr, oversize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (mapping == MAP_FAILED)
+				return nullptr;
+
+			uintptr_t begin = reinterpret_cast<uintptr_t>(mapping);
+			uintptr_t alignedBegin = RoundUp(begin, HugePageSize);
+			if (alignedBegin != begin)
+				munmap(mapping, alignedBegin - begin);
+			if (alignedBegin + alignedSize != begin + oversize)
+				munmap(reinterpret_cast<void*>(alignedBegin + alignedSize), begin + oversize - (alignedBegin + alignedSize));
+
+			void* data = reinterpret_cast<void*>(alignedBegin);
+			if (madvise(data, alignedSize, MADV_HUGEPAGE) != 0)
+				*pageMode = CpuPageMode::Default;
+
+			*mappedSize = alignedSize;
+			return data;
+		}
+#endif
+
+		*pageMode = CpuPageMode::Default;
+		*mappedSize = RoundUp(size, SmallPageSize);
+		void* data = mmap(nullptr, *mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		return data != MAP_FAILED ? data : nullptr;
+	}
+
+	void UnmapPages(void* data, size_t mappedSize)
+	{
+		munmap(data, mappedSize);
+	}
+#endif
+
+	// Has the OS back [data, data + size) with writable pages, without touching them; false where it can't.
+	bool PopulatePages(uint8_t* data, size_t size)
+	{
+#if defined(MADV_POPULATE_WRITE)
+		return madvise(data, size, MADV_POPULATE_WRITE) == 0;
+#else
+		(void)data;
+		(void)size;
+		return false;
+#endif
+	}
+}
+
+CpuPlaneMemory::CpuPlaneMemory()
+	: m_data(nullptr)
+	, m_size(0)
+	, m_mappedSize(0)
+	, m_pageMode(CpuPageMode::Default)
+{
+}
+
+CpuPlaneMemory::CpuPlaneMemory(size_t size, CpuPageMode pageMode)
+	: CpuPlaneMemory()
+{
+	if (size == 0)
+		return;
+
+	m_pageMode = pageMode;
+	m_data = static_cast<uint8_t*>(MapPages(size, &m_pageMode, &m_mappedSize));
+	if (!m_data)
+		throw std::bad_alloc();
+
+	m_size = size;
+}
+
+CpuPlaneMemory::~CpuPlaneMemory()
+{
+	Release();
+}
+
+CpuPlaneMemory::CpuPlaneMemory(CpuPlaneMemory&& other)
+	: CpuPlaneMemory()
+{
+	*this = static_cast<CpuPlaneMemory&&>(other);
+}
+
+CpuPlaneMemory& CpuPlaneMemory::operator=(CpuPlaneMemory&& other)
+{
+	if (this != &other)
+	{
+		Release();
+		m_data = other.m_data;
+		m_size = other.m_size;
+		m_mappedSize = other.m_mappedSize;
+		m_pageMode = other.m_pageMode;
+
+		other.m_data = nullptr;
+		other.m_size = 0;
+		other.m_mappedSize = 0;
+	}
+	return *this;
+}
+
+void CpuPlaneMemory::Release()
+{
+	if (m_data)
+		UnmapPages(m_data, m_mappedSize);
+
+	m_data = nullptr;
+	m_size = 0;
+	m_mappedSize = 0;
+}
+
+void CpuPlaneMemory::Prefault(CpuThreadPool* threadPool)
+{
+	size_t pageCount = (m_mappedSize + SmallPageSize - 1) / SmallPageSize;
+	if (pageCount == 0)
+		return;
+
+	// Writing is what makes the OS back a page; a read would map the shared zero page, and the write after it
+	// would fault a second time to copy it. Without MADV_POPULATE_WRITE (Linux 5.14), each page gets a zero,
+	// which is what fresh pages hold anyway.
+	auto touchPages = [this](size_t beginPage, size_t endPage)
+	{
+		size_t begin = beginPage * SmallPageSize;
+		size_t end = endPage * SmallPageSize < m_mappedSize ? endPage * SmallPageSize : m_mappedSize;
+		if (PopulatePages(m_data + begin, end - begin))
+			return;
+
+		for (size_t page = beginPage; page < endPage; ++page)
+		{
+			volatile uint8_t* byte = m_data + page * SmallPageSize;
+			*byte = 0;
+		}
+	};
+
+	if (!threadPool || threadPool->GetThreadCount() == 1)
+	{
+		touchPages(0, pageCount);
+		return;
+	}
+
+	uint32_t threadCount = threadPool->GetThreadCount();
+	threadPool->Run(threadCount, [&](uint32_t thread)
+	{
+		touchPages(pageCount * thread / threadCount, pageCount * (thread + 1) / threadCount);
+	});
+}
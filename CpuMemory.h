@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "CpuThreadPool.h"
+
+// Memory for image planes, where page faults and TLB misses would otherwise show up in the first frames of
+// a large conversion.
+
+enum class CpuPageMode
+{
+	// Ordinary pages.
+	Default,
+
+	// Asks the OS to back the memory with huge pages when it can (madvise(MADV_HUGEPAGE) on Linux). Needs no
+	// setup; the kernel may still use small pages if it has no huge ones to spare.
+	TransparentHuge,
+
+	// Reserved huge pages (MAP_HUGETLB on Linux, MEM_LARGE_PAGES on Windows). Needs pages reserved by the
+	// administrator, or the lock-pages privilege on Windows; falls back to TransparentHuge otherwise.
+	ExplicitHuge,
+};
+
+// Rows of the buffers made for the converter start on this boundary: a cache line, and a full AVX-512
+// vector.
+size_t const CpuRowAlignment = 64;
+
+inline size_t GetAlignedRowPitch(size_t rowBytes)
+{
+	return (rowBytes + CpuRowAlignment - 1) / CpuRowAlignment * CpuRowAlignment;
+}
+
+// One page-aligned allocation. The contents start out zero, but no page is backed by memory until it's
+// first written; Prefault does that up front. Move-only.
+class CpuPlaneMemory
+{
+	uint8_t* m_data;
+	size_t m_size;
+	size_t m_mappedSize;
+	CpuPageMode m_pageMode;
+
+	void Release();
+
+public:
+	CpuPlaneMemory();
+
+	// Throws std::bad_alloc if the memory can't be had with any page size.
+	CpuPlaneMemory(size_t size, CpuPageMode pageMode);
+	~CpuPlaneMemory();
+
+	CpuPlaneMemory(CpuPlaneMemory&& other);
+	CpuPlaneMemory& operator=(CpuPlaneMemory&& other);
+	CpuPlaneMemory(CpuPlaneMemory const&) = delete;
+	CpuPlaneMemory& operator=(CpuPlaneMemory const&) = delete;
+
+	uint8_t* Data() const { return m_data; }
+	size_t Size() const { return m_size; }
+
+	// What was actually obtained, which is less than requested after a fallback.
+	CpuPageMode GetPageMode() const { return m_pageMode; }
+
+	// Touches every page so the OS backs all of them now, spread over the threads of threadPool if given.
+	// Call it on fresh memory, before writing anything: where the OS can't populate pages on request, the
+	// first byte of each page is set to zero. Do this before timing-critical work, not during it.
+	void Prefault(CpuThreadPool* threadPool = nullptr);
+};
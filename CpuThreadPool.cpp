@@ -0,0 +1,192 @@
+// CpuThreadPool.cpp: Persistent workers behind CpuConverter.
+
+#include "CpuThreadPool.h"
+
+CpuThreadPool::CpuThreadPool(uint32_t threadCount)
+	: m_generation(0)
+	, m_busyWorkers(0)
+	, m_stopping(false)
+	, m_task(nullptr)
+	, m_taskCount(0)
+	, m_stealing(false)
+	, m_nextTask(0)
+{
+	if (threadCount == 0)
+	{
+		threadCount = std::thread::hardware_concurrency();
+		if (threadCount == 0)
+			threadCount = 1;
+	}
+
+	m_ranges.reset(new TaskRange[threadCount]);
+
+	// The calling thread is the last worker.
+	m_workers.reserve(threadCount - 1);
+	for (uint32_t i = 0; i + 1 < threadCount; ++i)
+	{
+		m_workers.emplace_back(&CpuThreadPool::WorkerMain, this, i);
+	}
+}
+
+CpuThreadPool::~CpuThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+bool CpuThreadPool::PopTask(uint32_t workerIndex, uint32_t* task)
+{
+	TaskRange& range = m_ranges[workerIndex];
+	std::lock_guard<std::mutex> lock(range.Lock);
+	if (range.Begin == range.End)
+		return false;
+
+	*task = range.Begin++;
+	return true;
+}
+
+// Moves the back half of the first non-empty share found into this worker's own, empty, share.
+bool CpuThreadPool::StealTasks(uint32_t workerIndex)
+{
+	uint32_t threadCount = GetThreadCount();
+	for (uint32_t i = 1; i < threadCount; ++i)
+	{
+		TaskRange& victim = m_ranges[(workerIndex + i) % threadCount];
+
+		uint32_t begin;
+		uint32_t end;
+		{
+			std::lock_guard<std::mutex> lock(victim.Lock);
+			if (victim.Begin == victim.End)
+				continue;
+
+			end = victim.End;
+			begin = victim.Begin + (victim.End - victim.Begin) / 2;
+			victim.End = begin;
+		}
+
+		TaskRange& own = m_ranges[workerIndex];
+		std::lock_guard<std::mutex> lock(own.Lock);
+		own.Begin = begin;
+		own.End = end;
+		return true;
+	}
+
+	// Nothing is left to claim anywhere; tasks still running belong to their thieves or owners.
+	return false;
+}
+
+void CpuThreadPool::RunOwnAndStolenTasks(uint32_t workerIndex)
+{
+	for (;;)
+	{
+		uint32_t task;
+		while (PopTask(workerIndex, &task))
+		{
+			(*m_task)(task);
+		}
+
+		if (!StealTasks(workerIndex))
+			return;
+	}
+}
+
+void CpuThreadPool::RunTasks(uint32_t workerIndex)
+{
+	if (m_stealing)
+	{
+		RunOwnAndStolenTasks(workerIndex);
+		return;
+	}
+
+	for (uint32_t i = m_nextTask.fetch_add(1); i < m_taskCount; i = m_nextTask.fetch_add(1))
+	{
+		(*m_task)(i);
+	}
+}
+
+void CpuThreadPool::WorkerMain(uint32_t workerIndex)
+{
+	uint64_t seenGeneration = 0;
+
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [&] { return m_stopping || m_generation != seenGeneration; });
+			if (m_stopping)
+				return;
+			seenGeneration = m_generation;
+		}
+
+		RunTasks(workerIndex);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (--m_busyWorkers == 0)
+				m_done.notify_one();
+		}
+	}
+}
+
+void CpuThreadPool::Submit(uint32_t taskCount, std::function<void(uint32_t)> const& task, bool stealing)
+{
+	std::lock_guard<std::mutex> runLock(m_runMutex);
+
+	// Not worth waking anyone.
+	if (m_workers.empty() || taskCount <= 1)
+	{
+		for (uint32_t i = 0; i < taskCount; ++i)
+		{
+			task(i);
+		}
+		return;
+	}
+
+	uint32_t threadCount = GetThreadCount();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_task = &task;
+		m_taskCount = taskCount;
+		m_stealing = stealing;
+		m_nextTask.store(0);
+
+		if (stealing)
+		{
+			// No worker is running yet, so the shares can be written without their locks.
+			for (uint32_t i = 0; i < threadCount; ++i)
+			{
+				m_ranges[i].Begin = static_cast<uint32_t>(uint64_t(taskCount) * i / threadCount);
+				m_ranges[i].End = static_cast<uint32_t>(uint64_t(taskCount) * (i + 1) / threadCount);
+			}
+		}
+
+		m_busyWorkers = static_cast<uint32_t>(m_workers.size());
+		++m_generation;
+	}
+	m_wake.notify_all();
+
+	RunTasks(threadCount - 1);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [&] { return m_busyWorkers == 0; });
+	m_task = nullptr;
+}
+
+void CpuThreadPool::Run(uint32_t taskCount, std::function<void(uint32_t)> const& task)
+{
+	Submit(taskCount, task, false);
+}
+
+void CpuThreadPool::RunStealing(uint32_t taskCount, std::function<void(uint32_t)> const& task)
+{
+	Submit(taskCount, task, true);
+}
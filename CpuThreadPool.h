@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker threads for CpuConverter. Threads are created once with the pool, never per frame.
+// Run is a blocking submit with the same shape as QueueWrapper::CloseCommandListExecuteAndWaitUntilDone:
+// it hands out the work, joins in on the calling thread, and returns once everything has finished.
+class CpuThreadPool
+{
+	// A worker's share of a RunStealing call: tasks [Begin, End). The owner takes from the front,
+	// thieves take the back half. Padded so workers don't share cache lines.
+	struct alignas(64) TaskRange
+	{
+		std::mutex Lock;
+		uint32_t Begin;
+		uint32_t End;
+	};
+
+	std::vector<std::thread> m_workers;
+	std::unique_ptr<TaskRange[]> m_ranges;
+
+	std::mutex m_runMutex;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	uint64_t m_generation;
+	uint32_t m_busyWorkers;
+	bool m_stopping;
+
+	std::function<void(uint32_t)> const* m_task;
+	uint32_t m_taskCount;
+	bool m_stealing;
+	std::atomic<uint32_t> m_nextTask;
+
+	void WorkerMain(uint32_t workerIndex);
+	void RunTasks(uint32_t workerIndex);
+	void RunOwnAndStolenTasks(uint32_t workerIndex);
+	bool PopTask(uint32_t workerIndex, uint32_t* task);
+	bool StealTasks(uint32_t workerIndex);
+	void Submit(uint32_t taskCount, std::function<void(uint32_t)> const& task, bool stealing);
+
+public:
+	// threadCount includes the calling thread; 0 means one per hardware thread.
+	explicit CpuThreadPool(uint32_t threadCount = 0);
+	~CpuThreadPool();
+
+	CpuThreadPool(CpuThreadPool const&) = delete;
+	CpuThreadPool& operator=(CpuThreadPool const&) = delete;
+
+	uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_workers.size()) + 1; }
+
+	// Calls task(i) for every i in [0, taskCount) and waits for all of them. Tasks must not throw.
+	// Concurrent calls are serialized.
+	void Run(uint32_t taskCount, std::function<void(uint32_t)> const& task);
+
+	// Same contract as Run, for many small tasks. Each thread starts on a contiguous share of the task
+	// indices, so neighbouring tasks stay on one core, and a thread that runs dry steals half of the
+	// remaining share of another. Threads slowed down by other processes end up doing less of the work.
+	void RunStealing(uint32_t taskCount, std::function<void(uint32_t)> const& task);
+};
@@ -0,0 +1,336 @@
+// CpuTuning.cpp: Autotuner sweep and the tuning profile file.
+
+#include "CpuTuning.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace
+{
+	// Each measurement converts for at least this long, and at least MinMeasuredFrames frames.
+	double const MinMeasuredSeconds = 0.2;
+	int const MinMeasuredFrames = 3;
+
+	// A setting that costs more (another thread) has to beat the cheaper one by this much.
+	double const CostlierSettingMargin = 1.03;
+
+	uint32_t const c_tileWidths[] = { 512, 1024, 2048, 4096 };
+	uint32_t const c_tileHeights[] = { 4, 8, 16, 32, 64 };
+
+	char const* GetSchedulingName(CpuScheduling scheduling)
+	{
+		return scheduling == CpuScheduling::WorkStealing ? "steal" : "bands";
+	}
+
+	char const* GetStoreModeName(CpuStoreMode storeMode)
+	{
+		return storeMode == CpuStoreMode::Streaming ? "streaming" : "cached";
+	}
+
+	// Best frame time out of several, as megapixels per second. The best frame is the one least disturbed
+	// by whatever else the host is doing, which makes repeated sweeps agree with each other.
+	double MeasureTuning(CpuTuning const& tuning, CpuRgbImage const& frame, CpuYuvImage const& yuv, CpuConversionFormat const& format, CpuAccuracy accuracy, std::ostream* log)
+	{
+		CpuConverter converter(GetCpuKernels(tuning.Level), tuning.ThreadCount);
+		converter.SetFormat(format);
+		converter.SetScheduling(tuning.Scheduling, tuning.TileWidth, tuning.TileHeight);
+		converter.SetStoreMode(tuning.StoreMode);
+
+		// Warm up caches and page in the target.
+		converter.ConvertRgbToYuv(frame, yuv, accuracy);
+
+		double best = 0;
+		double total = 0;
+		for (int frames = 0; frames < MinMeasuredFrames || total < MinMeasuredSeconds; ++frames)
+		{
+			auto start = std::chrono::steady_clock::now();
+			converter.ConvertRgbToYuv(frame, yuv, accuracy);
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			total += seconds;
+			if (frames == 0 || seconds < best)
+				best = seconds;
+		}
+
+		double throughput = double(frame.Width) * frame.Height / 1e6 / best;
+		if (log)
+		{
+			char line[160];
+			std::snprintf(line, sizeof(line), "  %s, %u threads, %s %ux%u, %s stores: %.1f MP/s\n",
+				converter.GetKernelName(), converter.GetThreadCount(), GetSchedulingName(tuning.Scheduling),
+				tuning.TileWidth, tuning.TileHeight, GetStoreModeName(tuning.StoreMode), throughput);
+			*log << line;
+		}
+		return throughput;
+	}
+
+	uint32_t RoundUpToEven(uint32_t i)
+	{
+		return (i % 2 != 0) ? i + 1 : i;
+	}
+
+	bool ParseScheduling(std::string const& name, CpuScheduling* scheduling)
+	{
+		if (name == "steal")
+			*scheduling = CpuScheduling::WorkStealing;
+		else if (name == "bands")
+			*scheduling = CpuScheduling::StaticBands;
+		else
+			return false;
+		return true;
+	}
+
+	bool ParseStoreMode(std::string const& name, CpuStoreMode* storeMode)
+	{
+		if (name == "cached")
+			*storeMode = CpuStoreMode::Cached;
+		else if (name == "streaming")
+			*storeMode = CpuStoreMode::Streaming;
+		else
+			return false;
+		return true;
+	}
+
+	bool ParseSize(std::string const& text, uint32_t* width, uint32_t* height)
+	{
+		char rest = 0;
+		return std::sscanf(text.c_str(), "%ux%u%c", width, height, &rest) == 2 && *width != 0 && *height != 0;
+	}
+
+	// Parses one result line; returns false if anything is missing or malformed.
+	bool ParseResult(std::string const& line, CpuTuningResult* result)
+	{
+		std::istringstream words(line);
+		std::string size;
+		if (!(words >> size) || !ParseSize(size, &result->Width, &result->Height))
+			return false;
+
+		bool haveLevel = false;
+		bool haveThreads = false;
+		bool haveScheduling = false;
+		bool haveTile = false;
+		bool haveStoreMode = false;
+		result->Throughput = 0;
+
+		std::string word;
+		while (words >> word)
+		{
+			size_t equals = word.find('=');
+			if (equals == std::string::npos)
+				return false;
+
+			std::string key = word.substr(0, equals);
+			std::string value = word.substr(equals + 1);
+			if (key == "kernel")
+				haveLevel = ParseCpuKernelLevel(value.c_str(), &result->Tuning.Level);
+			else if (key == "threads")
+				haveThreads = std::sscanf(value.c_str(), "%u", &result->Tuning.ThreadCount) == 1 && result->Tuning.ThreadCount != 0;
+			else if (key == "schedule")
+				haveScheduling = ParseScheduling(value, &result->Tuning.Scheduling);
+			else if (key == "tile")
+				haveTile = ParseSize(value, &result->Tuning.TileWidth, &result->Tuning.TileHeight) &&
+					result->Tuning.TileWidth % 2 == 0 && result->Tuning.TileHeight % 2 == 0;
+			else if (key == "stores")
+				haveStoreMode = ParseStoreMode(value, &result->Tuning.StoreMode);
+			else if (key == "throughput")
+				result->Throughput = std::strtod(value.c_str(), nullptr);
+			else
+				return false;
+		}
+
+		return haveLevel && haveThreads && haveScheduling && haveTile && haveStoreMode;
+	}
+}
+
+CpuTuningResult AutotuneCpuConverter(CpuRgbImage const& frame, CpuConversionFormat const& format, CpuAccuracy accuracy,
+	std::vector<CpuKernelLevel> const& levels, uint32_t maxThreadCount, std::ostream* log)
+{
+	if (levels.empty())
+		throw std::invalid_argument("Nothing to tune: no kernel levels given.");
+
+	if (maxThreadCount == 0)
+	{
+		maxThreadCount = std::thread::hardware_concurrency();
+		if (maxThreadCount == 0)
+			maxThreadCount = 1;
+	}
+
+	CpuYuvBuffer yuv = CreateCompatibleYuvBuffer(frame, format.Output);
+
+	CpuTuningResult result;
+	result.Width = frame.Width;
+	result.Height = frame.Height;
+	result.Tuning = { levels[0], maxThreadCount, CpuScheduling::WorkStealing, CpuConverter::DefaultTileWidth, CpuConverter::DefaultTileHeight, CpuStoreMode::Cached };
+	result.Throughput = 0;
+
+	// Keeps candidate if it's faster than the best so far, by margin if it costs more.
+	auto tryTuning = [&](CpuTuning const& candidate, double margin)
+	{
+		double throughput = MeasureTuning(candidate, frame, yuv.Image, format, accuracy, log);
+		if (throughput > result.Throughput * margin)
+		{
+			result.Tuning = candidate;
+			result.Throughput = throughput;
+		}
+	};
+
+	// Kernel level, on every thread with the default schedule. Levels built without kernels for this format
+	// (see RGB2YUV_ALL_KERNEL_COLORS) are skipped.
+	CpuConversionFormat kernelFormat = format;
+	kernelFormat.Output = GetLinearYuvLayout(format.Output);
+	if (log)
+		*log << "Kernel level:\n";
+	for (CpuKernelLevel level : levels)
+	{
+		if (!GetCpuKernels(level).Find(kernelFormat))
+			continue;
+
+		CpuTuning candidate = result.Tuning;
+		candidate.Level = level;
+		tryTuning(candidate, 1.0);
+	}
+
+	// Thread count, from one up: more threads only win if they're clearly faster, since memory-bound
+	// frames often stop scaling before the cores run out.
+	if (log)
+		*log << "Thread count:\n";
+	{
+		CpuTuning best = result.Tuning;
+		result.Throughput = 0;
+		for (uint32_t threads = 1; ; threads = threads * 2 < maxThreadCount ? threads * 2 : maxThreadCount)
+		{
+			CpuTuning candidate = best;
+			candidate.ThreadCount = threads;
+			tryTuning(candidate, CostlierSettingMargin);
+
+			if (threads == maxThreadCount)
+				break;
+		}
+	}
+
+	// Scheduling: fixed bands, or stealing tiles of each size. Tiles as wide as the frame are bands of
+	// row pairs that threads can still steal.
+	if (log)
+		*log << "Scheduling:\n";
+	{
+		CpuTuning base = result.Tuning;
+
+		CpuTuning bands = base;
+		bands.Scheduling = CpuScheduling::StaticBands;
+		tryTuning(bands, 1.0);
+
+		uint32_t paddedWidth = RoundUpToEven(frame.Width);
+		std::vector<uint32_t> tileWidths;
+		for (uint32_t tileWidth : c_tileWidths)
+		{
+			if (tileWidth < paddedWidth)
+				tileWidths.push_back(tileWidth);
+		}
+		tileWidths.push_back(paddedWidth);
+
+		for (uint32_t tileWidth : tileWidths)
+		{
+			for (uint32_t tileHeight : c_tileHeights)
+			{
+				CpuTuning candidate = base;
+				candidate.Scheduling = CpuScheduling::WorkStealing;
+				candidate.TileWidth = tileWidth;
+				candidate.TileHeight = tileHeight;
+
+				// The starting point was measured already.
+				if (tileWidth != base.TileWidth || tileHeight != base.TileHeight || base.Scheduling != CpuScheduling::WorkStealing)
+					tryTuning(candidate, 1.0);
+			}
+		}
+	}
+
+	if (log)
+		*log << "Store mode:\n";
+	{
+		CpuTuning candidate = result.Tuning;
+		candidate.StoreMode = CpuStoreMode::Streaming;
+		tryTuning(candidate, 1.0);
+	}
+
+	return result;
+}
+
+void CpuTuningProfile::Load(char const* fileName)
+{
+	std::ifstream file(fileName);
+	if (!file)
+		throw std::runtime_error(std::string("Couldn't open tuning profile ") + fileName);
+
+	std::vector<CpuTuningResult> results;
+	std::string line;
+	for (int lineNumber = 1; std::getline(file, line); ++lineNumber)
+	{
+		size_t first = line.find_first_not_of(" \t\r");
+		if (first == std::string::npos || line[first] == '#')
+			continue;
+
+		CpuTuningResult result;
+		if (!ParseResult(line, &result))
+			throw std::runtime_error(std::string("Malformed tuning profile line ") + std::to_string(lineNumber) + " in " + fileName);
+
+		results.push_back(result);
+	}
+
+	m_results.swap(results);
+}
+
+void CpuTuningProfile::Save(char const* fileName) const
+{
+	std::ofstream file(fileName);
+	file << "# Rgb2YuvCpu tuning profile, one line per frame size. Written by Rgb2YuvCpu --tune.\n";
+	for (CpuTuningResult const& result : m_results)
+	{
+		char line[200];
+		std::snprintf(line, sizeof(line), "%ux%u kernel=%s threads=%u schedule=%s tile=%ux%u stores=%s throughput=%.1f\n",
+			result.Width, result.Height, GetCpuKernels(result.Tuning.Level).Name, result.Tuning.ThreadCount,
+			GetSchedulingName(result.Tuning.Scheduling), result.Tuning.TileWidth, result.Tuning.TileHeight,
+			GetStoreModeName(result.Tuning.StoreMode), result.Throughput);
+		file << line;
+	}
+
+	if (!file.flush())
+		throw std::runtime_error(std::string("Couldn't write tuning profile ") + fileName);
+}
+
+void CpuTuningProfile::Add(CpuTuningResult const& result)
+{
+	for (CpuTuningResult& existing : m_results)
+	{
+		if (existing.Width == result.Width && existing.Height == result.Height)
+		{
+			existing = result;
+			return;
+		}
+	}
+	m_results.push_back(result);
+}
+
+CpuTuningResult const* CpuTuningProfile::Find(uint32_t width, uint32_t height) const
+{
+	CpuTuningResult const* closest = nullptr;
+	uint64_t closestDistance = 0;
+	uint64_t pixels = uint64_t(width) * height;
+
+	for (CpuTuningResult const& result : m_results)
+	{
+		uint64_t resultPixels = uint64_t(result.Width) * result.Height;
+		uint64_t distance = resultPixels > pixels ? resultPixels - pixels : pixels - resultPixels;
+		if (!closest || distance < closestDistance)
+		{
+			closest = &result;
+			closestDistance = distance;
+		}
+	}
+	return closest;
+}
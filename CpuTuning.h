@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "CpuConverter.h"
+
+// Per-machine tuning of the CPU path, the counterpart of picking numthreads and the dispatch size for a
+// GPU. None of these settings changes the output; they only decide how fast it's produced, and the best
+// choice differs between hosts and frame sizes.
+
+struct CpuTuning
+{
+	CpuKernelLevel Level;
+	uint32_t ThreadCount;
+	CpuScheduling Scheduling;
+	uint32_t TileWidth;
+	uint32_t TileHeight;
+	CpuStoreMode StoreMode;
+};
+
+// The best tuning found for one frame size, and what it measured in megapixels per second.
+struct CpuTuningResult
+{
+	uint32_t Width;
+	uint32_t Height;
+	CpuTuning Tuning;
+	double Throughput;
+};
+
+// Converts frame over and over with different settings and returns the fastest. The sweep goes one
+// setting at a time: kernel level (out of levels), then thread count (doubling up to maxThreadCount,
+// 0 meaning one per hardware thread), then scheduling and tile size, then store mode. Takes a few
+// seconds; one line per measurement goes to log if it isn't null.
+CpuTuningResult AutotuneCpuConverter(CpuRgbImage const& frame, CpuConversionFormat const& format, CpuAccuracy accuracy,
+	std::vector<CpuKernelLevel> const& levels, uint32_t maxThreadCount, std::ostream* log = nullptr);
+
+// Tuning results of one machine, one per frame size, kept as a text file with a line per result:
+//   1920x1080 kernel=avx2 threads=8 schedule=steal tile=2048x16 stores=cached throughput=1234.5
+class CpuTuningProfile
+{
+	std::vector<CpuTuningResult> m_results;
+
+public:
+	// Replaces the current results. Throws std::runtime_error if the file can't be opened or a line
+	// doesn't parse.
+	void Load(char const* fileName);
+
+	// Throws std::runtime_error if the file can't be written.
+	void Save(char const* fileName) const;
+
+	// Replaces the result for the same frame size, if there is one.
+	void Add(CpuTuningResult const& result);
+
+	// The result for the frame size closest in pixel count to width x height; null if there are none.
+	CpuTuningResult const* Find(uint32_t width, uint32_t height) const;
+
+	std::vector<CpuTuningResult> const& GetResults() const { return m_results; }
+};
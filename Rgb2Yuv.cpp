@@ -125,7 +125,9 @@ public:
 		{
 			UINT ImageWidth;
 			UINT ImageHeight;
-			std::vector<UINT> Buffer;
+			// CopyPixels overwrites every pixel, so the buffer is left uninitialized rather than zeroed first.
+			std::unique_ptr<UINT[]> Buffer;
+			size_t BufferSize;
 		};
 		LoadedImageData imageData{};
 
@@ -152,12 +154,13 @@ public:
 
 		DX::ThrowIfFailed(spConverter->GetSize(&imageData.ImageWidth, &imageData.ImageHeight));
 
-		imageData.Buffer.resize(imageData.ImageWidth * imageData.ImageHeight);
+		imageData.BufferSize = size_t(imageData.ImageWidth) * imageData.ImageHeight;
+		imageData.Buffer.reset(new UINT[imageData.BufferSize]);
 		DX::ThrowIfFailed(spConverter->CopyPixels(
 			NULL,
 			imageData.ImageWidth * sizeof(UINT),
-			static_cast<UINT>(imageData.Buffer.size()) * sizeof(UINT),
-			reinterpret_cast<BYTE*>(imageData.Buffer.data())));
+			static_cast<UINT>(imageData.BufferSize * sizeof(UINT)),
+			reinterpret_cast<BYTE*>(imageData.Buffer.get())));
 
 		D3D12_RESOURCE_DESC resourceDesc{};
 		resourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
@@ -195,7 +198,7 @@ public:
 			IID_PPV_ARGS(&upload)));
 
 		D3D12_SUBRESOURCE_DATA initialData{};
-		initialData.pData = imageData.Buffer.data();
+		initialData.pData = imageData.Buffer.get();
 		initialData.RowPitch = imageData.ImageWidth * 4;
 		initialData.SlicePitch = imageData.ImageWidth * imageData.ImageHeight * 4;
 		UpdateSubresources(graphicsCommandList, result.Get(), upload.Get(), 0, 0, 1, &initialData);
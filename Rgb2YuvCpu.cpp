@@ -0,0 +1,877 @@
+// Rgb2YuvCpu.cpp : CPU-only front end for headless hosts. Program execution begins and ends there.
+//
+
+#include "CpuTuning.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// Everything the command line can set about a conversion.
+	struct ConversionOptions
+	{
+		CpuKernels::KernelTable const* Kernels;
+		CpuAccuracy Accuracy;
+		uint32_t ThreadCount;
+		CpuScheduling Scheduling;
+		uint32_t TileWidth;
+		uint32_t TileHeight;
+		CpuStoreMode StoreMode;
+		CpuConversionFormat Format;
+		CpuYuvTiling Tiling;
+		bool InPlace;
+		bool Footprint;
+		CpuPageMode PageMode;
+		bool ToTensor;
+		CpuYuvTensor Tensor;
+	};
+
+	// Environment variable naming a tuning profile to load at startup, like --profile.
+	char const* const c_profileVariable = "RGB2YUV_CPU_PROFILE";
+
+	void PrintUsage()
+	{
+		std::cout << "Usage: Rgb2YuvCpu [options] [sourceImage.bgra] [width] [height] [destImage.yuv]\n";
+		std::cout << "       Rgb2YuvCpu [options] --bench [width]x[height] [frameCount]\n";
+		std::cout << "       Rgb2YuvCpu [options] --tune [width]x[height] [profileFile]\n";
+		std::cout << "Source images are raw B8G8R8A8 (or R8G8B8A8) rows with no padding. Output is tightly packed, in the\n";
+		std::cout << "layout chosen with --layout.\n";
+		std::cout << "Options:\n";
+		std::cout << "  --kernel=[scalar|sse41|avx2|avx512|avx512vnni]\n";
+		std::cout << "      Forces a kernel level instead of the best one CPUID reports.\n";
+		std::cout << "      " RGB2YUV_CPU_LEVEL_VARIABLE " does the same from the environment.\n";
+		std::cout << "  --accuracy=[exact|fast|dithered]\n";
+		std::cout << "      exact (default) matches the shader math bit for bit; fast is at most 1 LSB off; dithered\n";
+		std::cout << "      rounds 8-bit samples with an ordered dither, also at most 1 LSB off, to avoid banding.\n";
+		std::cout << "  --threads=[count]\n";
+		std::cout << "      Threads per conversion, including the calling one. Default is one per hardware thread.\n";
+		std::cout << "  --schedule=[steal|bands]\n";
+		std::cout << "      steal (default) spreads small tiles over the threads with work stealing; bands gives\n";
+		std::cout << "      each thread one fixed band of rows.\n";
+		std::cout << "  --tile=[width]x[height]\n";
+		std::cout << "      Tile size for --schedule=steal, both even. Default is 2048x16.\n";
+		std::cout << "  --input=[bgra|rgba]\n";
+		std::cout << "      Source pixel layout. bgra (default) is what the shader reads.\n";
+		std::cout << "  --matrix=[bt601|bt709]\n";
+		std::cout << "  --range=[shader|limited|full]\n";
+		std::cout << "      shader (default) is the shader's limited-range scale without the +16/+128 offsets.\n";
+		std::cout << "  --layout=[nv12|nv21|i420|yv12|yuy2|uyvy|nv16|i422|nv24|i444|p010|p016|i010|av12|ayuv|nv12tiled|\n";
+		std::cout << "            ycocgr444|ycocgr420|i400]\n";
+		std::cout << "      Target layout: 4:2:0 with interleaved UV or VU, or separate U and V planes; packed\n";
+		std::cout << "      4:2:2; 4:2:2 and 4:4:4 with interleaved UV or separate planes; 4:2:0 with 16-bit\n";
+		std::cout << "      little-endian samples, 10 or 16 bits interleaved, or 10 bits planar; or with the source\n";
+		std::cout << "      alpha, as NV12 plus an alpha plane or packed 4:4:4 VUYA; or NV12 in tiles; or the lossless\n";
+		std::cout << "      YCoCg-R transform in 16-bit planes, 4:4:4 or 4:2:0, ignoring --matrix and --range; or luma\n";
+		std::cout << "      alone, a grey plane with no chroma computed at all. nv12 is the default.\n";
+		std::cout << "  --tiling=[width]x[height]\n";
+		std::cout << "      Tile size of nv12tiled, in bytes and rows, both even. Default is 64x32. Tiled output files\n";
+		std::cout << "      hold the planes' rows of tiles, in order.\n";
+		std::cout << "  --stores=[cached|streaming]\n";
+		std::cout << "      streaming writes the target with non-temporal stores and prefetches the source, for\n";
+		std::cout << "      frames much larger than the cache. cached is the default.\n";
+		std::cout << "  --in-place\n";
+		std::cout << "      Converts a source file in its own buffer instead of allocating a separate target.\n";
+		std::cout << "  --footprint\n";
+		std::cout << "      Writes the target as a D3D12 upload buffer: rows padded to 256 bytes and planes at 512-byte\n";
+		std::cout << "      offsets, where GetCopyableFootprints puts them, so it can be copied to the GPU in one go.\n";
+		std::cout << "  --tensor=[float32|float16]\n";
+		std::cout << "      Writes normalized I420 as a float NCHW tensor for inference instead, in one pass: the Y, U and\n";
+		std::cout << "      V planes of each image, each code c of channel i as (c / 255 - mean[i]) / std[i]. --layout\n";
+		std::cout << "      doesn't apply. --bench compares it with converting to I420 and copying that into the tensor.\n";
+		std::cout << "  --upsample-chroma\n";
+		std::cout << "      Repeats each tensor chroma sample over its 2x2 block, so all three planes are full size.\n";
+		std::cout << "  --tensor-mean=[y],[u],[v]\n";
+		std::cout << "  --tensor-std=[y],[u],[v]\n";
+		std::cout << "      Normalization of each tensor channel. Default is a mean of 0 and a std of 1.\n";
+		std::cout << "  --batch=[count]\n";
+		std::cout << "      Images per tensor for --bench, all copies of the synthetic frame. Default is 1.\n";
+		std::cout << "  --pages=[default|thp|huge]\n";
+		std::cout << "      Puts the source and target on transparent or reserved huge pages, to cut page faults and\n";
+		std::cout << "      TLB misses on large frames. Pages are faulted in before converting either way.\n";
+		std::cout << "  --profile=[profileFile]\n";
+		std::cout << "      Loads the kernel, threads, schedule, tile size and stores tuned for the closest frame size.\n";
+		std::cout << "      Options on the command line still win. " << c_profileVariable << " does the same from the\n";
+		std::cout << "      environment.\n";
+		std::cout << "--tune sweeps kernel levels, thread counts, schedules and store modes on a synthetic frame and\n";
+		std::cout << "adds the fastest to profileFile (default Rgb2YuvCpu.profile). --kernel and --threads limit the sweep.\n";
+	}
+
+	char const* GetPageModeName(CpuPageMode pageMode)
+	{
+		switch (pageMode)
+		{
+		case CpuPageMode::TransparentHuge: return "transparent huge";
+		case CpuPageMode::ExplicitHuge: return "reserved huge";
+		default: return "default";
+		}
+	}
+
+	// Deterministic noisy gradient, so benchmark numbers don't depend on a particular input file.
+	CpuRgbPlane CreateSyntheticImage(uint32_t width, uint32_t height, CpuPageMode pageMode)
+	{
+		CpuRgbPlane pixels = CreateRgbPlane(width, height, pageMode);
+
+		uint32_t seed = 0x12345678;
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			uint8_t* row = pixels.Memory.Data() + y * pixels.Image.RowPitch;
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				row[x * 4 + 0] = static_cast<uint8_t>((x * 255) / width ^ (seed >> 27));
+				row[x * 4 + 1] = static_cast<uint8_t>((y * 255) / height ^ (seed >> 19));
+				row[x * 4 + 2] = static_cast<uint8_t>(seed >> 24);
+				row[x * 4 + 3] = 255;
+			}
+		}
+
+		return pixels;
+	}
+
+	char const* GetSchedulingName(CpuScheduling scheduling)
+	{
+		return scheduling == CpuScheduling::WorkStealing ? "steal" : "bands";
+	}
+
+	char const* GetAccuracyName(CpuAccuracy accuracy)
+	{
+		switch (accuracy)
+		{
+		case CpuAccuracy::Fast: return "fast";
+		case CpuAccuracy::Dithered: return "dithered";
+		default: return "exact";
+		}
+	}
+
+	// Returns throughput in megapixels per second. If tiled isn't null, every frame also gets copied into
+	// its tiles, as a separate pass.
+	double MeasureThroughput(CpuConverter const& converter, CpuRgbImage const& rgb, CpuYuvImage const& yuv, CpuAccuracy accuracy, int frameCount,
+		CpuYuvImage const* tiled = nullptr)
+	{
+		// Warm up caches and page in the target.
+		converter.ConvertRgbToYuv(rgb, yuv, accuracy);
+		if (tiled)
+			converter.CopyToTiles(yuv, *tiled);
+
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < frameCount; ++i)
+		{
+			converter.ConvertRgbToYuv(rgb, yuv, accuracy);
+			if (tiled)
+				converter.CopyToTiles(yuv, *tiled);
+		}
+		auto end = std::chrono::steady_clock::now();
+
+		double seconds = std::chrono::duration<double>(end - start).count();
+		double megapixels = double(rgb.Width) * rgb.Height * frameCount / 1e6;
+
+		std::printf("%s (%s, %u threads, %s, %s stores%s): %ux%u, %d frames, %.3f ms/frame, %.1f MP/s\n",
+			converter.GetKernelName(), GetAccuracyName(accuracy), converter.GetThreadCount(),
+			GetSchedulingName(converter.GetScheduling()), converter.GetStoreMode() == CpuStoreMode::Streaming ? "streaming" : "cached",
+			tiled ? ", then retiled" : "", rgb.Width, rgb.Height, frameCount, seconds * 1000.0 / frameCount, megapixels / seconds);
+
+		return megapixels / seconds;
+	}
+
+	// The same for converting yuv back into rgb, for reversible layouts.
+	double MeasureInverseThroughput(CpuConverter const& converter, CpuYuvImage const& yuv, CpuRgbTarget const& rgb, int frameCount)
+	{
+		converter.ConvertYuvToRgb(yuv, rgb);
+
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < frameCount; ++i)
+		{
+			converter.ConvertYuvToRgb(yuv, rgb);
+		}
+		auto end = std::chrono::steady_clock::now();
+
+		double seconds = std::chrono::duration<double>(end - start).count();
+		double megapixels = double(rgb.Width) * rgb.Height * frameCount / 1e6;
+
+		std::printf("%s inverse (%u threads): %ux%u, %d frames, %.3f ms/frame, %.1f MP/s\n",
+			converter.GetKernelName(), converter.GetThreadCount(), rgb.Width, rgb.Height, frameCount, seconds * 1000.0 / frameCount, megapixels / seconds);
+
+		return megapixels / seconds;
+	}
+
+	// Returns the seconds it takes to convert one batch of images into tensor. If i420 isn't null, each image
+	// gets converted into it and then copied into the tensor, as a separate pass.
+	double TimeTensorBatch(CpuConverter const& converter, std::vector<CpuRgbImage> const& images, CpuYuvTensor const& tensor,
+		CpuAccuracy accuracy, CpuYuvImage const* i420 = nullptr)
+	{
+		auto start = std::chrono::steady_clock::now();
+		if (!i420)
+		{
+			converter.ConvertRgbToTensor(images.data(), tensor, accuracy);
+		}
+		else
+		{
+			for (uint32_t n = 0; n < tensor.BatchSize; ++n)
+			{
+				converter.ConvertRgbToYuv(images[n], *i420, accuracy);
+				converter.CopyToTensor(*i420, tensor, n);
+			}
+		}
+		auto end = std::chrono::steady_clock::now();
+
+		return std::chrono::duration<double>(end - start).count();
+	}
+
+	// Prints and returns the throughput in megapixels per second of the fastest of frameCount batches.
+	double PrintTensorThroughput(CpuConverter const& converter, CpuYuvTensor const& tensor, CpuAccuracy accuracy, int frameCount,
+		double seconds, bool throughI420)
+	{
+		double megapixels = double(tensor.Width) * tensor.Height * tensor.BatchSize / 1e6;
+
+		std::printf("%s tensor (%s, %u threads, %s, batch of %u%s): %ux%u, best of %d batches, %.3f ms/batch, %.1f MP/s\n",
+			converter.GetKernelName(), GetAccuracyName(accuracy), converter.GetThreadCount(),
+			tensor.Type == CpuTensorType::Float16 ? "float16" : "float32", tensor.BatchSize, throughI420 ? ", through I420" : "",
+			tensor.Width, tensor.Height, frameCount, seconds * 1000.0, megapixels / seconds);
+
+		return megapixels / seconds;
+	}
+
+	// The tensor target against what it saves: converting each image to I420, then copying that out.
+	int RunTensorBenchmark(uint32_t width, uint32_t height, int frameCount, ConversionOptions const& options)
+	{
+		CpuConverter converter(*options.Kernels, options.ThreadCount);
+		converter.SetScheduling(options.Scheduling, options.TileWidth, options.TileHeight);
+		converter.SetStoreMode(options.StoreMode);
+		CpuConversionFormat format = options.Format;
+		format.Output = CpuYuvLayout::I420;
+		converter.SetFormat(format);
+
+		CpuRgbPlane pixels = CreateSyntheticImage(width, height, options.PageMode);
+		std::vector<CpuRgbImage> images(options.Tensor.BatchSize, pixels.Image);
+
+		CpuYuvTensor tensor = options.Tensor;
+		tensor.Width = width;
+		tensor.Height = height;
+		CpuPlaneMemory tensorMemory(GetYuvTensorSize(tensor), options.PageMode);
+		converter.Prefault(tensorMemory);
+		tensor.Data = tensorMemory.Data();
+
+		CpuYuvPlanes i420 = CreateCompatibleYuvPlanes(pixels.Image, options.PageMode, CpuYuvLayout::I420);
+		converter.Prefault(i420.Memory);
+
+		// Warm up caches. The two paths then take turns batch by batch and each keeps its fastest batch, so a
+		// change in the host's speed during the run doesn't favor either.
+		TimeTensorBatch(converter, images, tensor, options.Accuracy, &i420.Image);
+		TimeTensorBatch(converter, images, tensor, options.Accuracy);
+		double twoPassSeconds = std::numeric_limits<double>::infinity();
+		double fusedSeconds = std::numeric_limits<double>::infinity();
+		for (int i = 0; i < frameCount; ++i)
+		{
+			twoPassSeconds = std::min(twoPassSeconds, TimeTensorBatch(converter, images, tensor, options.Accuracy, &i420.Image));
+			fusedSeconds = std::min(fusedSeconds, TimeTensorBatch(converter, images, tensor, options.Accuracy));
+		}
+
+		double twoPass = PrintTensorThroughput(converter, tensor, options.Accuracy, frameCount, twoPassSeconds, true);
+		double fused = PrintTensorThroughput(converter, tensor, options.Accuracy, frameCount, fusedSeconds, false);
+		std::printf("%s tensor speedup over converting and copying: %.2fx\n", options.Kernels->Name, fused / twoPass);
+		return 0;
+	}
+
+	int RunBenchmark(uint32_t width, uint32_t height, int frameCount, ConversionOptions const& options)
+	{
+		if (options.ToTensor)
+			return RunTensorBenchmark(width, height, frameCount, options);
+
+		CpuKernels::KernelTable const& kernels = *options.Kernels;
+		CpuAccuracy accuracy = options.Accuracy;
+
+		CpuConverter converter(kernels, options.ThreadCount);
+		converter.SetScheduling(options.Scheduling, options.TileWidth, options.TileHeight);
+		converter.SetStoreMode(options.StoreMode);
+		converter.SetFormat(options.Format);
+
+		CpuRgbPlane pixels = CreateSyntheticImage(width, height, options.PageMode);
+		CpuRgbImage const& rgb = pixels.Image;
+		CpuYuvPlanes yuv = CreateCompatibleYuvPlanes(rgb, options.PageMode, options.Format.Output, options.Tiling);
+		converter.Prefault(yuv.Memory);
+		std::printf("Planes on %s pages\n", GetPageModeName(yuv.Memory.GetPageMode()));
+
+		// Everything gets measured against the scalar, bit-exact, single-threaded baseline.
+		CpuConverter scalarConverter(CpuKernels::ScalarKernels, 1);
+		scalarConverter.SetFormat(options.Format);
+		double baseline = MeasureThroughput(scalarConverter, rgb, yuv.Image, CpuAccuracy::BitExact, frameCount);
+
+		double throughput = MeasureThroughput(converter, rgb, yuv.Image, accuracy, frameCount);
+		std::printf("%s speedup over scalar: %.2fx\n", kernels.Name, throughput / baseline);
+
+		// A tiled target against what it saves: converting to linear rows, then retiling them.
+		if (IsTiledYuvLayout(options.Format.Output))
+		{
+			CpuConversionFormat linearFormat = options.Format;
+			linearFormat.Output = GetLinearYuvLayout(options.Format.Output);
+
+			CpuConverter linearConverter(kernels, options.ThreadCount);
+			linearConverter.SetScheduling(options.Scheduling, options.TileWidth, options.TileHeight);
+			linearConverter.SetStoreMode(options.StoreMode);
+			linearConverter.SetFormat(linearFormat);
+
+			CpuYuvPlanes linear = CreateCompatibleYuvPlanes(rgb, options.PageMode, linearFormat.Output);
+			linearConverter.Prefault(linear.Memory);
+
+			double retiled = MeasureThroughput(linearConverter, rgb, linear.Image, accuracy, frameCount, &yuv.Image);
+			std::printf("%s tiled speedup over converting and retiling: %.2fx\n", kernels.Name, throughput / retiled);
+		}
+
+		// A reversible target converted back, into a frame of its own.
+		if (IsReversibleYuvLayout(options.Format.Output))
+		{
+			CpuPlaneMemory decoded(size_t(width) * height * 4, options.PageMode);
+			converter.Prefault(decoded);
+			MeasureInverseThroughput(converter, yuv.Image, CpuRgbTarget{ decoded.Data(), width, height, size_t(width) * 4 }, frameCount);
+		}
+
+		// Scaling curve for the selected kernel, doubling up to the full thread count.
+		uint32_t maxThreads = converter.GetThreadCount();
+		if (maxThreads > 1)
+		{
+			std::vector<uint32_t> curve;
+			for (uint32_t threads = 1; threads < maxThreads; threads *= 2)
+			{
+				curve.push_back(threads);
+			}
+			curve.push_back(maxThreads);
+
+			double singleThreaded = 0;
+			for (uint32_t threads : curve)
+			{
+				CpuConverter scaledConverter(kernels, threads);
+				scaledConverter.SetScheduling(options.Scheduling, options.TileWidth, options.TileHeight);
+				scaledConverter.SetStoreMode(options.StoreMode);
+				scaledConverter.SetFormat(options.Format);
+
+				double scaled = MeasureThroughput(scaledConverter, rgb, yuv.Image, accuracy, frameCount);
+				if (threads == 1)
+					singleThreaded = scaled;
+
+				std::printf("  %u threads: %.2fx over 1 thread, %.0f%% efficiency\n",
+					threads, scaled / singleThreaded, 100.0 * scaled / (singleThreaded * threads));
+			}
+		}
+
+		return 0;
+	}
+
+	void WritePlane(std::ostream& dest, uint8_t const* plane, size_t rowPitch, size_t rowSize, uint32_t rowCount)
+	{
+		for (uint32_t y = 0; y < rowCount; ++y)
+		{
+			dest.write(reinterpret_cast<char const*>(plane + y * rowPitch), rowSize);
+		}
+	}
+
+	// Writes the rows of tiles covering rowSize bytes of rowCount rows: whole tiles, without the ones a
+	// wider row pitch adds.
+	void WriteTiledPlane(std::ostream& dest, uint8_t const* plane, size_t rowPitch, size_t rowSize, uint32_t rowCount, CpuYuvTiling const& tiling)
+	{
+		size_t tileRowSize = (rowSize + tiling.Width - 1) / tiling.Width * tiling.Width * tiling.Height;
+		for (uint32_t y = 0; y < rowCount; y += tiling.Height)
+		{
+			dest.write(reinterpret_cast<char const*>(plane + y * rowPitch), tileRowSize);
+		}
+	}
+
+	// Writes the planes of the layout tightly packed and in its usual order, whatever the row pitches of
+	// the image. Tiled planes are written as rows of tiles.
+	bool WriteYuvImage(std::ostream& dest, CpuYuvImage const& yuv, CpuYuvLayout layout)
+	{
+		if (IsTiledYuvLayout(layout))
+		{
+			WriteTiledPlane(dest, yuv.Y, yuv.YRowPitch, yuv.Width, yuv.Height, yuv.Tiling);
+			WriteTiledPlane(dest, yuv.UV, yuv.UVRowPitch, yuv.Width, yuv.Height / 2, yuv.Tiling);
+			return static_cast<bool>(dest.flush());
+		}
+
+		uint32_t sampleSize = GetYuvSampleSize(layout);
+		WritePlane(dest, yuv.Y, yuv.YRowPitch, IsPackedYuvLayout(layout) ? yuv.Width * GetPackedPixelSize(layout) : yuv.Width * sampleSize, yuv.Height);
+		if (!HasChromaPlanes(layout))
+			return static_cast<bool>(dest.flush());
+
+		uint32_t chromaWidth = (HasHorizontalChromaSubsampling(layout) ? yuv.Width / 2 : yuv.Width) * sampleSize;
+		uint32_t chromaHeight = HasVerticalChromaSubsampling(layout) ? yuv.Height / 2 : yuv.Height;
+		if (layout == CpuYuvLayout::Yv12)
+		{
+			WritePlane(dest, yuv.V, yuv.VRowPitch, chromaWidth, chromaHeight);
+			WritePlane(dest, yuv.U, yuv.URowPitch, chromaWidth, chromaHeight);
+		}
+		else if (IsPlanarYuvLayout(layout))
+		{
+			WritePlane(dest, yuv.U, yuv.URowPitch, chromaWidth, chromaHeight);
+			WritePlane(dest, yuv.V, yuv.VRowPitch, chromaWidth, chromaHeight);
+		}
+		else
+		{
+			WritePlane(dest, yuv.UV, yuv.UVRowPitch, chromaWidth * 2, chromaHeight);
+		}
+
+		if (HasAlphaPlane(layout))
+			WritePlane(dest, yuv.A, yuv.ARowPitch, yuv.Width, yuv.Height);
+		return static_cast<bool>(dest.flush());
+	}
+
+	int ConvertFile(char const* sourceFileName, uint32_t width, uint32_t height, char const* destFileName, ConversionOptions const& options)
+	{
+		CpuConverter converter(*options.Kernels, options.ThreadCount);
+		converter.SetScheduling(options.Scheduling, options.TileWidth, options.TileHeight);
+		converter.SetStoreMode(options.StoreMode);
+		converter.SetFormat(options.Format);
+
+		size_t rowPitch = GetAlignedRowPitch(size_t(width) * 4);
+		size_t sourceSize = rowPitch * height;
+		size_t yuvSize = GetCompatibleYuvSize(width, height, options.Format.Output, options.Tiling);
+
+		// In place, the one buffer has to hold the YUV image too, which is only larger for tiny odd sizes.
+		CpuPlaneMemory pixels(options.InPlace && yuvSize > sourceSize ? yuvSize : sourceSize, options.PageMode);
+		converter.Prefault(pixels);
+
+		std::ifstream source(sourceFileName, std::ios::binary);
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			if (!source.read(reinterpret_cast<char*>(pixels.Data() + y * rowPitch), size_t(width) * 4))
+			{
+				std::cerr << "Couldn't read " << size_t(width) * height * 4 << " bytes from " << sourceFileName << "\n";
+				return -1;
+			}
+		}
+
+		CpuRgbImage rgb{ pixels.Data(), width, height, rowPitch };
+
+		std::ofstream dest(destFileName, std::ios::binary);
+		bool written;
+		if (options.ToTensor)
+		{
+			CpuYuvTensor tensor = options.Tensor;
+			tensor.BatchSize = 1;
+			tensor.Width = width;
+			tensor.Height = height;
+			CpuPlaneMemory tensorMemory(GetYuvTensorSize(tensor), options.PageMode);
+			converter.Prefault(tensorMemory);
+			tensor.Data = tensorMemory.Data();
+			converter.ConvertRgbToTensor(&rgb, tensor, options.Accuracy);
+			written = static_cast<bool>(dest.write(reinterpret_cast<char const*>(tensorMemory.Data()), GetYuvTensorSize(tensor)).flush());
+		}
+		else if (options.InPlace)
+		{
+			written = WriteYuvImage(dest, converter.ConvertRgbToYuvInPlace(pixels.Data(), pixels.Size(), rgb, options.Accuracy), options.Format.Output);
+		}
+		else if (options.Footprint)
+		{
+			// The converter writes the padded rows in place, so the buffer goes out as it is.
+			CpuYuvFootprint footprint = GetCompatibleYuvFootprint(width, height, options.Format.Output);
+			CpuPlaneMemory upload(static_cast<size_t>(footprint.TotalSize), options.PageMode);
+			converter.Prefault(upload);
+			converter.ConvertRgbToYuv(rgb, PlaceYuvFootprint(upload.Data(), footprint), options.Accuracy);
+			written = static_cast<bool>(dest.write(reinterpret_cast<char const*>(upload.Data()), upload.Size()).flush());
+		}
+		else
+		{
+			CpuYuvPlanes yuv = CreateCompatibleYuvPlanes(rgb, options.PageMode, options.Format.Output, options.Tiling);
+			converter.Prefault(yuv.Memory);
+			converter.ConvertRgbToYuv(rgb, yuv.Image, options.Accuracy);
+			written = WriteYuvImage(dest, yuv.Image, options.Format.Output);
+		}
+
+		if (!written)
+		{
+			std::cerr << "Couldn't write " << destFileName << "\n";
+			return -1;
+		}
+
+		return 0;
+	}
+
+	// Sweeps the settings for one frame size and adds the winner to the profile file.
+	int RunTuning(uint32_t width, uint32_t height, char const* profileFileName, char const* requestedLevel, ConversionOptions const& options)
+	{
+		// A forced level is the only one worth tuning; otherwise every level this CPU runs.
+		std::vector<CpuKernelLevel> levels;
+		if ((requestedLevel && *requestedLevel) || std::getenv(RGB2YUV_CPU_LEVEL_VARIABLE))
+		{
+			CpuKernelLevel level;
+			ParseCpuKernelLevel(options.Kernels->Name, &level);
+			levels.push_back(level);
+		}
+		else
+		{
+			for (CpuKernelLevel level = CpuKernelLevel::Scalar; level <= DetectCpuKernelLevel(); level = CpuKernelLevel(int(level) + 1))
+			{
+				levels.push_back(level);
+			}
+		}
+
+		CpuTuningProfile profile;
+		std::ifstream existing(profileFileName);
+		if (existing)
+			profile.Load(profileFileName);
+
+		CpuRgbPlane pixels = CreateSyntheticImage(width, height, options.PageMode);
+		CpuRgbImage const& rgb = pixels.Image;
+
+		std::cout << "Tuning " << width << "x" << height << " (" << GetAccuracyName(options.Accuracy) << ")\n";
+		CpuTuningResult result = AutotuneCpuConverter(rgb, options.Format, options.Accuracy, levels, options.ThreadCount, &std::cout);
+
+		std::printf("Best: %s, %u threads, %s %ux%u, %s stores: %.1f MP/s\n",
+			GetCpuKernels(result.Tuning.Level).Name, result.Tuning.ThreadCount, GetSchedulingName(result.Tuning.Scheduling),
+			result.Tuning.TileWidth, result.Tuning.TileHeight, result.Tuning.StoreMode == CpuStoreMode::Streaming ? "streaming" : "cached",
+			result.Throughput);
+
+		profile.Add(result);
+		profile.Save(profileFileName);
+		std::cout << "Saved to " << profileFileName << "\n";
+		return 0;
+	}
+
+	// Takes the profile's settings for the frame size closest to width x height. Options given on the command
+	// line get parsed afterwards and override these; so does a level forced through the environment.
+	void ApplyTuningProfile(char const* profileFileName, uint32_t width, uint32_t height, ConversionOptions* options, char const** requestedLevel)
+	{
+		CpuTuningProfile profile;
+		profile.Load(profileFileName);
+
+		CpuTuningResult const* result = profile.Find(width, height);
+		if (!result)
+			return;
+
+		if (!IsCpuKernelLevelSupported(result->Tuning.Level))
+		{
+			std::cout << "Ignoring " << profileFileName << ": it was tuned for " << GetCpuKernels(result->Tuning.Level).Name << " kernels, which this CPU doesn't support\n";
+			return;
+		}
+
+		std::cout << "Using the tuning for " << result->Width << "x" << result->Height << " from " << profileFileName << "\n";
+		if (!std::getenv(RGB2YUV_CPU_LEVEL_VARIABLE))
+			*requestedLevel = GetCpuKernels(result->Tuning.Level).Name;
+		options->ThreadCount = result->Tuning.ThreadCount;
+		options->Scheduling = result->Tuning.Scheduling;
+		options->TileWidth = result->Tuning.TileWidth;
+		options->TileHeight = result->Tuning.TileHeight;
+		options->StoreMode = result->Tuning.StoreMode;
+	}
+
+	bool ParseSize(char const* text, uint32_t* width, uint32_t* height)
+	{
+		return std::sscanf(text, "%ux%u", width, height) == 2 && *width != 0 && *height != 0;
+	}
+
+	// Parses three comma-separated values, one per tensor channel. Leaves channels alone if text is malformed.
+	bool ParseChannels(char const* text, float* channels)
+	{
+		float parsed[3];
+		char rest = 0;
+		if (std::sscanf(text, "%f,%f,%f%c", &parsed[0], &parsed[1], &parsed[2], &rest) != 3)
+			return false;
+
+		std::copy(parsed, parsed + 3, channels);
+		return true;
+	}
+
+	// Returns false if arg isn't an option.
+	bool ParseOption(char const* arg, ConversionOptions* options, char const** requestedLevel)
+	{
+		if (std::strncmp(arg, "--kernel=", 9) == 0)
+		{
+			*requestedLevel = arg + 9;
+		}
+		else if (std::strcmp(arg, "--accuracy=exact") == 0)
+		{
+			options->Accuracy = CpuAccuracy::BitExact;
+		}
+		else if (std::strcmp(arg, "--accuracy=fast") == 0)
+		{
+			options->Accuracy = CpuAccuracy::Fast;
+		}
+		else if (std::strcmp(arg, "--accuracy=dithered") == 0)
+		{
+			options->Accuracy = CpuAccuracy::Dithered;
+		}
+		else if (std::strncmp(arg, "--threads=", 10) == 0)
+		{
+			options->ThreadCount = static_cast<uint32_t>(std::strtoul(arg + 10, nullptr, 10));
+		}
+		else if (std::strcmp(arg, "--schedule=steal") == 0)
+		{
+			options->Scheduling = CpuScheduling::WorkStealing;
+		}
+		else if (std::strcmp(arg, "--schedule=bands") == 0)
+		{
+			options->Scheduling = CpuScheduling::StaticBands;
+		}
+		else if (std::strncmp(arg, "--tile=", 7) == 0)
+		{
+			// Odd or zero sizes get rejected by SetScheduling.
+			if (!ParseSize(arg + 7, &options->TileWidth, &options->TileHeight))
+				options->TileWidth = 0;
+		}
+		else if (std::strcmp(arg, "--input=bgra") == 0)
+		{
+			options->Format.Input = CpuPixelFormat::Bgra8;
+		}
+		else if (std::strcmp(arg, "--input=rgba") == 0)
+		{
+			options->Format.Input = CpuPixelFormat::Rgba8;
+		}
+		else if (std::strcmp(arg, "--matrix=bt601") == 0)
+		{
+			options->Format.Matrix = CpuColorMatrix::Bt601;
+		}
+		else if (std::strcmp(arg, "--matrix=bt709") == 0)
+		{
+			options->Format.Matrix = CpuColorMatrix::Bt709;
+		}
+		else if (std::strcmp(arg, "--range=shader") == 0)
+		{
+			options->Format.Range = CpuColorRange::Shader;
+		}
+		else if (std::strcmp(arg, "--range=limited") == 0)
+		{
+			options->Format.Range = CpuColorRange::Limited;
+		}
+		else if (std::strcmp(arg, "--range=full") == 0)
+		{
+			options->Format.Range = CpuColorRange::Full;
+		}
+		else if (std::strcmp(arg, "--layout=nv12") == 0)
+		{
+			options->Format.Output = CpuYuvLayout::Nv12;
+		}
+		else if (std::strcmp(arg, "--layout=nv21") == 0)
+		{
+			options->Format.Output = CpuYuvLayout::Nv21;
+		}
+		else if (std::strcmp(arg, "--layout=i420") == 0)
+		{
+			options->Format.Output = CpuYuvLayout::I420;
+		}
+		else if (std::strcmp(arg, "--layout=yv12") == 0)
+		{
+			options->Format.Output = CpuYuvLayout::Yv12;
+		}
+		else if (std::strcmp(arg, "--layout=yuy2") == 0)
+		{
+			options->Format.Output = CpuYuvLayout::Yuy2;
+		}
+		else if (std::strcmp(arg, "--layout=uyvy") == 0)
+		{
+			options->Format.Output = CpuYuvLayout::Uyvy;
+		}
+		else if (std::strcmp(arg, "--layout=nv16") == 0)
+		{
+			options->Format.Output = CpuYuvLayout::Nv16;
+		}
+		else if (std::strcmp(arg, "--layout=i422") == 0)
+		{
+			options->Format.Output = CpuYuvLayout::I422;
+		}
+		else if (std::strcmp(arg, "--layout=nv24") == 0)
+		{
+			options->Format.Output = CpuYuvLayout::Nv24;
+		}
+		else if (std::strcmp(arg, "--layout=i444") == 0)
+		{
+			options->Format.Output = CpuYuvLayout::I444;
+		}
+		else if (std::strcmp(arg, "--layout=p010") == 0)
+		{
+			options->Format.Output = CpuYuvLayout::P010;
+		}
+		else if (std::strcmp(arg, "--layout=p016") == 0)
+		{
+			options->Format.Output = CpuYuvLayout::P016;
+		}
+		else if (std::strcmp(arg, "--layout=i010") == 0)
+		{
+			options->Format.Output = CpuYuvLayout::I010;
+		}
+		else if (std::strcmp(arg, "--layout=av12") == 0)
+		{
+			options->Format.Output = CpuYuvLayout::Av12;
+		}
+		else if (std::strcmp(arg, "--layout=ayuv") == 0)
+		{
+			options->Format.Output = CpuYuvLayout::Ayuv;
+		}
+		else if (std::strcmp(arg, "--layout=nv12tiled") == 0)
+		{
+			options->Format.Output = CpuYuvLayout::Nv12Tiled;
+		}
+		else if (std::strcmp(arg, "--layout=ycocgr444") == 0)
+		{
+			options->Format.Output = CpuYuvLayout::YCoCgR444;
+		}
+		else if (std::strcmp(arg, "--layout=ycocgr420") == 0)
+		{
+			options->Format.Output = CpuYuvLayout::YCoCgR420;
+		}
+		else if (std::strcmp(arg, "--layout=i400") == 0)
+		{
+			options->Format.Output = CpuYuvLayout::I400;
+		}
+		else if (std::strncmp(arg, "--tiling=", 9) == 0)
+		{
+			// Odd or zero sizes get rejected with the target.
+			if (!ParseSize(arg + 9, &options->Tiling.Width, &options->Tiling.Height))
+				options->Tiling.Width = 0;
+		}
+		else if (std::strcmp(arg, "--stores=cached") == 0)
+		{
+			options->StoreMode = CpuStoreMode::Cached;
+		}
+		else if (std::strcmp(arg, "--stores=streaming") == 0)
+		{
+			options->StoreMode = CpuStoreMode::Streaming;
+		}
+		else if (std::strcmp(arg, "--in-place") == 0)
+		{
+			options->InPlace = true;
+		}
+		else if (std::strcmp(arg, "--footprint") == 0)
+		{
+			options->Footprint = true;
+		}
+		else if (std::strcmp(arg, "--tensor=float32") == 0)
+		{
+			options->ToTensor = true;
+			options->Tensor.Type = CpuTensorType::Float32;
+		}
+		else if (std::strcmp(arg, "--tensor=float16") == 0)
+		{
+			options->ToTensor = true;
+			options->Tensor.Type = CpuTensorType::Float16;
+		}
+		else if (std::strcmp(arg, "--upsample-chroma") == 0)
+		{
+			options->Tensor.UpsampleChroma = true;
+		}
+		else if (std::strncmp(arg, "--tensor-mean=", 14) == 0)
+		{
+			// Malformed values become a NaN mean, which gets rejected with the tensor.
+			if (!ParseChannels(arg + 14, options->Tensor.Mean))
+				std::fill(options->Tensor.Mean, options->Tensor.Mean + 3, std::numeric_limits<float>::quiet_NaN());
+		}
+		else if (std::strncmp(arg, "--tensor-std=", 13) == 0)
+		{
+			// Malformed values become a zero std, which gets rejected with the tensor like a zero given.
+			if (!ParseChannels(arg + 13, options->Tensor.Std))
+				std::fill(options->Tensor.Std, options->Tensor.Std + 3, 0.0f);
+		}
+		else if (std::strncmp(arg, "--batch=", 8) == 0)
+		{
+			// Zero gets rejected with the tensor.
+			options->Tensor.BatchSize = static_cast<uint32_t>(std::strtoul(arg + 8, nullptr, 10));
+		}
+		else if (std::strcmp(arg, "--pages=default") == 0)
+		{
+			options->PageMode = CpuPageMode::Default;
+		}
+		else if (std::strcmp(arg, "--pages=thp") == 0)
+		{
+			options->PageMode = CpuPageMode::TransparentHuge;
+		}
+		else if (std::strcmp(arg, "--pages=huge") == 0)
+		{
+			options->PageMode = CpuPageMode::ExplicitHuge;
+		}
+		else
+		{
+			return false;
+		}
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	char const* requestedLevel = nullptr;
+	ConversionOptions options{ nullptr, CpuAccuracy::BitExact, 0, CpuScheduling::WorkStealing, CpuConverter::DefaultTileWidth, CpuConverter::DefaultTileHeight, CpuStoreMode::Cached, CpuConversionFormat(), CpuYuvTiling{ 64, 32 }, false, false, CpuPageMode::Default, false, CpuYuvTensor() };
+	options.Tensor.BatchSize = 1;
+	char const* profileFileName = std::getenv(c_profileVariable);
+
+	// Options may appear anywhere; everything else is positional. They're applied once the frame size is
+	// known, on top of the tuning profile.
+	std::vector<char const*> optionArgs;
+	std::vector<char const*> args;
+	for (int i = 1; i < argc; ++i)
+	{
+		ConversionOptions scratchOptions = options;
+		char const* scratchLevel = nullptr;
+		if (std::strncmp(argv[i], "--profile=", 10) == 0)
+			profileFileName = argv[i] + 10;
+		else if (ParseOption(argv[i], &scratchOptions, &scratchLevel))
+			optionArgs.push_back(argv[i]);
+		else
+			args.push_back(argv[i]);
+	}
+
+	try
+	{
+		bool bench = args.size() >= 2 && std::strcmp(args[0], "--bench") == 0;
+		bool tune = args.size() >= 2 && std::strcmp(args[0], "--tune") == 0;
+		bool convert = !bench && !tune && args.size() == 4;
+
+		uint32_t width = 0;
+		uint32_t height = 0;
+		if (bench || tune)
+		{
+			if (!ParseSize(args[1], &width, &height))
+			{
+				PrintUsage();
+				return -1;
+			}
+		}
+		else if (convert)
+		{
+			width = static_cast<uint32_t>(std::strtoul(args[1], nullptr, 10));
+			height = static_cast<uint32_t>(std::strtoul(args[2], nullptr, 10));
+		}
+		else
+		{
+			PrintUsage();
+			return -1;
+		}
+
+		// Tuning starts from scratch rather than from an earlier result.
+		if (!tune && profileFileName && *profileFileName)
+			ApplyTuningProfile(profileFileName, width, height, &options, &requestedLevel);
+
+		for (char const* arg : optionArgs)
+		{
+			ParseOption(arg, &options, &requestedLevel);
+		}
+
+		options.Kernels = &SelectCpuKernels(requestedLevel);
+		std::cout << "Using " << options.Kernels->Name << " kernels (best available: " << GetCpuKernels(DetectCpuKernelLevel()).Name << ")\n";
+
+		if (tune)
+		{
+			char const* tuneFileName = args.size() >= 3 ? args[2] : (profileFileName && *profileFileName ? profileFileName : "Rgb2YuvCpu.profile");
+			return RunTuning(width, height, tuneFileName, requestedLevel, options);
+		}
+
+		if (bench)
+		{
+			int frameCount = args.size() >= 3 ? std::atoi(args[2]) : 20;
+			return RunBenchmark(width, height, frameCount > 0 ? frameCount : 1, options);
+		}
+
+		return ConvertFile(args[0], width, height, args[3], options);
+	}
+	catch (std::exception const& e)
+	{
+		std::cerr << e.what() << "\n";
+		return -1;
+	}
+}
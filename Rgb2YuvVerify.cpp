@@ -0,0 +1,1500 @@
+// Rgb2YuvVerify.cpp : Exhaustive accuracy check of the CPU kernels. Program execution begins and ends there.
+//
+// Runs all 2^24 RGB values through every kernel level this host supports, for every distinct arithmetic
+// and every accuracy tier, and compares the result with a double-precision evaluation of the
+// OutputY/OutputUV formulas, scaled to the sample size of the layout. Each color fills a uniform 2x2
+// block, so chroma sees the color itself. Layouts that only place the same samples differently (NV21,
+// I420, YV12 and AV12 next to NV12, for example) or drop some of them (I400) aren't swept again; noise images converted to them are
+// compared sample by sample with the same images converted to the swept layout. Tiled targets run the kernels of their linear layout; they're
+// checked against its output copied into tiles, which covers the tile addressing. YCoCg-R targets aren't
+// OutputY/OutputUV; they're checked against the lifting steps and converted back. Tensors are checked
+// against I420 written out by CopyToTensor, and that against the I420 codes normalized here. Noise images
+// of every linear layout are converted with both schedules, both store modes and misaligned targets, and
+// checked byte for byte against the scalar kernels in static bands.
+
+#include "CpuConverter.h"
+#include "CpuFeatures.h"
+#include "CpuThreadPool.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// One task per red value; each task walks green, and a row pair covers every blue value.
+	uint32_t const ColorsPerRow = 256;
+	uint32_t const PixelsPerRow = ColorsPerRow * 2;
+
+	// Histogram buckets for signed errors -3 and below, -2, ..., +2, +3 and above.
+	int const HistogramRadius = 3;
+	int const HistogramSize = HistogramRadius * 2 + 1;
+
+	enum Component
+	{
+		ComponentY,
+		ComponentU,
+		ComponentV,
+		ComponentCount,
+	};
+
+	char const* const c_componentNames[] = { "Y", "U", "V" };
+
+	struct ComponentStats
+	{
+		uint64_t Histogram[HistogramSize];
+		uint64_t AbsoluteErrorSum;
+		uint64_t SampleCount;
+		int MaxError;
+	};
+
+	// Results of one kernel level and tier for one format.
+	struct KernelStats
+	{
+		ComponentStats Components[ComponentCount];
+
+		// Samples where LumaRow, the second row of a pair, the odd pixel of a pair, or the streaming kernel
+		// disagree with the first row of RowPair (Row for layouts without vertical subsampling). The entry
+		// points must all produce the same output. Dithered output depends on the position, so only the
+		// entry points that write the same positions are compared.
+		uint64_t Inconsistencies;
+
+		// Alpha samples that don't match the source alpha, for layouts that carry it. Every tier copies it
+		// unchanged.
+		uint64_t AlphaErrors;
+	};
+
+	// How often the formulas themselves leave the sample range and get clamped, per component.
+	struct ClipStats
+	{
+		uint64_t Low[ComponentCount];
+		uint64_t High[ComponentCount];
+	};
+
+	// The formulas in double precision, with the coefficients quoted to six decimals as RgbToYuvCS.hlsl
+	// does. Coefficients are kept in millionths: every product and sum is then an exact integer in a
+	// double, and a result that lies exactly halfway between two codes is recognized as such.
+	struct ReferenceFormulas
+	{
+		double Y[3];		// R, G, B
+		double U[3];
+		double V[3];
+		double LumaOffset;
+		double ChromaOffset;
+	};
+
+	double Millionths(double c)
+	{
+		return std::round(c * 1e6);
+	}
+
+	ReferenceFormulas GetReferenceFormulas(CpuConversionFormat const& format)
+	{
+		double kr = format.Matrix == CpuColorMatrix::Bt709 ? 0.2126 : 0.299;
+		double kb = format.Matrix == CpuColorMatrix::Bt709 ? 0.0722 : 0.114;
+		double kg = 1.0 - kr - kb;
+
+		double lumaScale = format.Range == CpuColorRange::Full ? 1.0 : 219.0 / 255.0;
+		double chromaScale = format.Range == CpuColorRange::Full ? 1.0 : 224.0 / 255.0;
+
+		ReferenceFormulas formulas;
+		formulas.Y[0] = Millionths(kr * lumaScale);
+		formulas.Y[1] = Millionths(kg * lumaScale);
+		formulas.Y[2] = Millionths(kb * lumaScale);
+
+		formulas.U[0] = Millionths(-0.5 * kr / (1.0 - kb) * chromaScale);
+		formulas.U[1] = Millionths(-0.5 * kg / (1.0 - kb) * chromaScale);
+		formulas.U[2] = Millionths(0.5 * chromaScale);
+
+		formulas.V[0] = Millionths(0.5 * chromaScale);
+		formulas.V[1] = Millionths(-0.5 * kg / (1.0 - kr) * chromaScale);
+		formulas.V[2] = Millionths(-0.5 * kb / (1.0 - kr) * chromaScale);
+
+		formulas.LumaOffset = format.Range == CpuColorRange::Limited ? 16.0 : 0.0;
+		formulas.ChromaOffset = format.Range == CpuColorRange::Shader ? 0.0 : 128.0;
+		return formulas;
+	}
+
+	// What an R8_UNORM store does with the float results for one red and green value and every blue value:
+	// round to nearest, clamp to [0, 255]. Layouts with more bits scale the results first, which keeps the
+	// products exact, like R16_UNORM would from the unscaled ones. Written without branches or library
+	// calls so it vectorizes.
+	void Quantize(double const* coefficients, double offset, int bits, int red, int green, uint16_t* dst, uint32_t stride, uint64_t* low, uint64_t* high)
+	{
+		double scale = double(1 << (bits - 8));
+		int32_t maxSample = (1 << bits) - 1;
+
+		// Nothing gets below -1024 steps of 8 bits, so truncating after this bias is floor().
+		double const bias = 1024.0 * scale;
+
+		double redGreen = coefficients[0] * red + coefficients[1] * green;
+		uint32_t lowCount = 0;
+		uint32_t highCount = 0;
+		for (uint32_t blue = 0; blue < ColorsPerRow; ++blue)
+		{
+			double value = (redGreen + coefficients[2] * int(blue)) * scale / 1e6 + offset * scale + 0.5;
+			int32_t rounded = static_cast<int32_t>(value + bias) - static_cast<int32_t>(bias);
+			lowCount += rounded < 0;
+			highCount += rounded > maxSample;
+			rounded = rounded < 0 ? 0 : rounded;
+			rounded = rounded > maxSample ? maxSample : rounded;
+			dst[blue * stride] = static_cast<uint16_t>(rounded);
+		}
+
+		*low += lowCount;
+		*high += highCount;
+	}
+
+	void AddErrors(uint16_t const* actual, uint32_t actualStride, uint16_t const* expected, uint32_t expectedStride, ComponentStats* stats)
+	{
+		// The common case is a handful of 1 LSB errors, which this loop counts without a histogram lookup.
+		uint32_t below = 0;
+		uint32_t above = 0;
+		uint32_t absoluteSum = 0;
+		int maxError = 0;
+		for (uint32_t i = 0; i < ColorsPerRow; ++i)
+		{
+			int error = int(actual[i * actualStride]) - int(expected[i * expectedStride]);
+			int absoluteError = error < 0 ? -error : error;
+			below += error == -1;
+			above += error == 1;
+			absoluteSum += absoluteError;
+			maxError = absoluteError > maxError ? absoluteError : maxError;
+		}
+
+		if (maxError > 1)
+		{
+			for (uint32_t i = 0; i < ColorsPerRow; ++i)
+			{
+				int error = int(actual[i * actualStride]) - int(expected[i * expectedStride]);
+				if (error < -HistogramRadius)
+					error = -HistogramRadius;
+				if (error > HistogramRadius)
+					error = HistogramRadius;
+				++stats->Histogram[error + HistogramRadius];
+			}
+		}
+		else
+		{
+			stats->Histogram[HistogramRadius - 1] += below;
+			stats->Histogram[HistogramRadius] += ColorsPerRow - below - above;
+			stats->Histogram[HistogramRadius + 1] += above;
+		}
+
+		stats->AbsoluteErrorSum += absoluteSum;
+		stats->SampleCount += ColorsPerRow;
+		stats->MaxError = maxError > stats->MaxError ? maxError : stats->MaxError;
+	}
+
+	uint64_t CountDifferences(uint16_t const* a, uint16_t const* b, uint32_t count, uint32_t stride = 1)
+	{
+		uint64_t differences = 0;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			differences += a[i * stride] != b[i * stride];
+		}
+		return differences;
+	}
+
+	// Sample index of a target row: a byte, or a little-endian word with the layout's shift undone.
+	uint16_t ReadSample(CpuYuvLayout layout, uint8_t const* row, uint32_t index)
+	{
+		if (GetYuvSampleSize(layout) == 1)
+			return row[index];
+		return static_cast<uint16_t>((row[index * 2] | row[index * 2 + 1] << 8) >> GetYuvSampleShift(layout));
+	}
+
+	void ReadSamples(CpuYuvLayout layout, uint8_t const* row, uint32_t count, uint16_t* samples)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			samples[i] = ReadSample(layout, row, i);
+		}
+	}
+
+	// Alpha samples, stride bytes apart, that differ from the alpha of the source pixels.
+	uint64_t CountAlphaDifferences(uint8_t const* alpha, uint32_t stride, uint8_t const* src)
+	{
+		uint64_t differences = 0;
+		for (uint32_t i = 0; i < PixelsPerRow; ++i)
+		{
+			differences += alpha[i * stride] != src[i * 4 + 3];
+		}
+		return differences;
+	}
+
+	// Runs a RowPair entry point over one source row used as both rows of the pair, at target row top, and
+	// returns its chroma as [U0 V0 U1 V1 ...] whatever the layout, so every layout is checked against the
+	// same expectations. Adds the alpha samples that differ from the source to alphaDifferences.
+	void RunRowPair(CpuKernels::RowPairFn rowPair, CpuYuvLayout layout, uint32_t top, uint8_t const* src, uint16_t* y0, uint16_t* y1, uint16_t* uv, uint64_t* alphaDifferences)
+	{
+		alignas(64) uint8_t luma0[PixelsPerRow * 2];
+		alignas(64) uint8_t luma1[PixelsPerRow * 2];
+		alignas(64) uint8_t chroma[PixelsPerRow * 2];
+		alignas(64) uint8_t alpha0[PixelsPerRow];
+		alignas(64) uint8_t alpha1[PixelsPerRow];
+		uint32_t sampleSize = GetYuvSampleSize(layout);
+		CpuKernels::RowPairTarget dst = { luma0, luma1, chroma, chroma, chroma + ColorsPerRow * sampleSize, alpha0, alpha1, 0, top };
+		rowPair(src, src, PixelsPerRow, dst, PixelsPerRow);
+
+		if (HasAlphaPlane(layout))
+			*alphaDifferences += CountAlphaDifferences(alpha0, 1, src) + CountAlphaDifferences(alpha1, 1, src);
+
+		ReadSamples(layout, luma0, PixelsPerRow, y0);
+		ReadSamples(layout, luma1, PixelsPerRow, y1);
+		for (uint32_t i = 0; i < ColorsPerRow; ++i)
+		{
+			switch (layout)
+			{
+			case CpuYuvLayout::Nv21:
+				uv[i * 2] = ReadSample(layout, chroma, i * 2 + 1);
+				uv[i * 2 + 1] = ReadSample(layout, chroma, i * 2);
+				break;
+			case CpuYuvLayout::I420:
+			case CpuYuvLayout::Yv12:
+			case CpuYuvLayout::I010:
+				uv[i * 2] = ReadSample(layout, chroma, i);
+				uv[i * 2 + 1] = ReadSample(layout, chroma, ColorsPerRow + i);
+				break;
+			default:
+				uv[i * 2] = ReadSample(layout, chroma, i * 2);
+				uv[i * 2 + 1] = ReadSample(layout, chroma, i * 2 + 1);
+				break;
+			}
+		}
+	}
+
+	// Runs a Row entry point over one source row at target row top and splits its output like RunRowPair.
+	// There is no second row; y1 gets a copy of y0. 4:4:4 layouts give the even pixel's chroma; returns how
+	// many samples of the odd pixel's chroma differ from it. I400 has no chroma, and gives zeros.
+	uint64_t RunRow(CpuKernels::RowFn row, CpuYuvLayout layout, uint32_t top, uint8_t const* src, uint16_t* y0, uint16_t* y1, uint16_t* uv, uint64_t* alphaDifferences)
+	{
+		alignas(64) uint8_t luma[PixelsPerRow * 4];
+		alignas(64) uint8_t chroma[PixelsPerRow * 2];
+		CpuKernels::RowTarget dst = { luma, chroma, chroma, chroma + PixelsPerRow, 0, top };
+		row(src, PixelsPerRow, dst, PixelsPerRow);
+
+		uint64_t differences = 0;
+		if (layout == CpuYuvLayout::Ayuv)
+		{
+			// V U Y A per pixel.
+			for (uint32_t i = 0; i < PixelsPerRow; ++i)
+			{
+				y0[i] = luma[i * 4 + 2];
+			}
+			for (uint32_t i = 0; i < ColorsPerRow; ++i)
+			{
+				uint8_t const* even = luma + i * 8;
+				uv[i * 2] = even[1];
+				uv[i * 2 + 1] = even[0];
+				differences += (even[5] != even[1]) + (even[4] != even[0]);
+			}
+			*alphaDifferences += CountAlphaDifferences(luma + 3, 4, src);
+		}
+		else if (IsLumaOnlyYuvLayout(layout))
+		{
+			ReadSamples(layout, luma, PixelsPerRow, y0);
+			std::memset(uv, 0, sizeof(uint16_t) * PixelsPerRow);
+		}
+		else if (IsPackedYuvLayout(layout))
+		{
+			// YUY2 is Y0 U Y1 V, UYVY is U Y0 V Y1; either way chroma alternates U and V.
+			uint32_t lumaOffset = layout == CpuYuvLayout::Uyvy ? 1 : 0;
+			for (uint32_t i = 0; i < PixelsPerRow; ++i)
+			{
+				y0[i] = luma[i * 2 + lumaOffset];
+				uv[i] = luma[i * 2 + 1 - lumaOffset];
+			}
+		}
+		else
+		{
+			ReadSamples(layout, luma, PixelsPerRow, y0);
+
+			bool fullChroma = !HasHorizontalChromaSubsampling(layout);
+			uint32_t sampleStep = fullChroma ? 2 : 1;
+			for (uint32_t i = 0; i < ColorsPerRow; ++i)
+			{
+				uint32_t sample = i * sampleStep;
+				if (IsPlanarYuvLayout(layout))
+				{
+					uv[i * 2] = chroma[sample];
+					uv[i * 2 + 1] = chroma[PixelsPerRow + sample];
+					if (fullChroma)
+						differences += (chroma[sample + 1] != chroma[sample]) + (chroma[PixelsPerRow + sample + 1] != chroma[PixelsPerRow + sample]);
+				}
+				else
+				{
+					uv[i * 2] = chroma[sample * 2];
+					uv[i * 2 + 1] = chroma[sample * 2 + 1];
+					if (fullChroma)
+						differences += (chroma[sample * 2 + 2] != chroma[sample * 2]) + (chroma[sample * 2 + 3] != chroma[sample * 2 + 1]);
+				}
+			}
+		}
+		std::memcpy(y1, y0, sizeof(uint16_t) * PixelsPerRow);
+		return differences;
+	}
+
+	// Runs whichever entry points the layout has. Returns the inconsistencies RunRow found.
+	uint64_t RunKernels(CpuKernels::RowKernels const& rowKernels, CpuStoreMode storeMode, CpuYuvLayout layout, uint32_t top, uint8_t const* src, uint16_t* y0, uint16_t* y1, uint16_t* uv, uint64_t* alphaDifferences)
+	{
+		if (!HasVerticalChromaSubsampling(layout))
+			return RunRow(rowKernels.GetRow(storeMode), layout, top, src, y0, y1, uv, alphaDifferences);
+
+		RunRowPair(rowKernels.GetRowPair(storeMode), layout, top, src, y0, y1, uv, alphaDifferences);
+		return 0;
+	}
+
+	// The kernels of one level and tier that are being checked.
+	struct KernelUnderTest
+	{
+		CpuKernels::KernelTable const* Table;
+		CpuAccuracy Accuracy;
+	};
+
+	// Checks every color with the given red value, for one format, against every kernel under test.
+	void VerifyRed(uint32_t red, CpuConversionFormat const& format, ReferenceFormulas formulas,
+		std::vector<KernelUnderTest> const& kernels, KernelStats* stats, ClipStats* clips)
+	{
+		// 64-byte aligned, so the streaming kernels really do stream.
+		alignas(64) uint8_t src[PixelsPerRow * 4];
+		alignas(64) uint8_t lumaRowSamples[PixelsPerRow * 2];
+		uint16_t expectedY[ColorsPerRow];
+		uint16_t expectedUV[PixelsPerRow];
+		uint16_t y0[PixelsPerRow];
+		uint16_t y1[PixelsPerRow];
+		uint16_t uv[PixelsPerRow];
+		uint16_t lumaRow[PixelsPerRow];
+		uint16_t streamedY0[PixelsPerRow];
+		uint16_t streamedY1[PixelsPerRow];
+		uint16_t streamedUV[PixelsPerRow];
+
+		bool rgba = format.Input == CpuPixelFormat::Rgba8;
+		int bits = GetYuvSampleBits(format.Output);
+
+		// Dithering rounds by position. Spreading the reds over the rows of the pattern (two rows per pair,
+		// one chroma row) covers all of it; without dithering the row makes no difference.
+		bool pairs = HasVerticalChromaSubsampling(format.Output);
+		uint32_t top = (red % 4) * (pairs ? 2 : 1);
+
+		for (uint32_t green = 0; green < 256; ++green)
+		{
+			for (uint32_t blue = 0; blue < ColorsPerRow; ++blue)
+			{
+				uint8_t pixel[4] =
+				{
+					static_cast<uint8_t>(rgba ? red : blue),
+					static_cast<uint8_t>(green),
+					static_cast<uint8_t>(rgba ? blue : red),
+					static_cast<uint8_t>(green ^ blue ^ 0x5A),		// alpha must not leak into Y, U or V
+				};
+				std::memcpy(src + blue * 8, pixel, 4);
+				std::memcpy(src + blue * 8 + 4, pixel, 4);
+			}
+
+			Quantize(formulas.Y, formulas.LumaOffset, bits, red, green, expectedY, 1, &clips->Low[ComponentY], &clips->High[ComponentY]);
+			Quantize(formulas.U, formulas.ChromaOffset, bits, red, green, expectedUV, 2, &clips->Low[ComponentU], &clips->High[ComponentU]);
+			Quantize(formulas.V, formulas.ChromaOffset, bits, red, green, expectedUV + 1, 2, &clips->Low[ComponentV], &clips->High[ComponentV]);
+
+			for (size_t k = 0; k < kernels.size(); ++k)
+			{
+				CpuKernels::RowKernels const& rowKernels = kernels[k].Table->Find(format)->Get(kernels[k].Accuracy);
+				KernelStats* kernelStats = &stats[k];
+				bool dithered = kernels[k].Accuracy == CpuAccuracy::Dithered;
+
+				// Both source rows are the same row, which makes every 2x2 block uniform.
+				uint64_t oddChroma = RunKernels(rowKernels, CpuStoreMode::Cached, format.Output, top, src, y0, y1, uv, &kernelStats->AlphaErrors);
+				if (rowKernels.RowPairStreaming != rowKernels.RowPair || rowKernels.RowStreaming != rowKernels.Row)
+				{
+					oddChroma += RunKernels(rowKernels, CpuStoreMode::Streaming, format.Output, top, src, streamedY0, streamedY1, streamedUV, &kernelStats->AlphaErrors);
+				}
+				else
+				{
+					std::memcpy(streamedY0, y0, sizeof(y0));
+					std::memcpy(streamedY1, y1, sizeof(y1));
+					std::memcpy(streamedUV, uv, sizeof(uv));
+				}
+				rowKernels.LumaRow(src, PixelsPerRow, lumaRowSamples, PixelsPerRow);
+				ReadSamples(format.Output, lumaRowSamples, PixelsPerRow, lumaRow);
+
+				AddErrors(y0, 2, expectedY, 1, &kernelStats->Components[ComponentY]);
+				if (!IsLumaOnlyYuvLayout(format.Output))
+				{
+					AddErrors(uv, 2, expectedUV, 2, &kernelStats->Components[ComponentU]);
+					AddErrors(uv + 1, 2, expectedUV + 1, 2, &kernelStats->Components[ComponentV]);
+				}
+
+				kernelStats->Inconsistencies +=
+					CountDifferences(y0, streamedY0, PixelsPerRow) +
+					CountDifferences(y1, streamedY1, PixelsPerRow) +
+					CountDifferences(uv, streamedUV, PixelsPerRow);
+
+				if (dithered)
+				{
+					// The odd pixels and the second row have thresholds of their own, so they count as
+					// samples in their own right. LumaRow dithers like row 0.
+					AddErrors(y0 + 1, 2, expectedY, 1, &kernelStats->Components[ComponentY]);
+					if (pairs)
+					{
+						AddErrors(y1, 2, expectedY, 1, &kernelStats->Components[ComponentY]);
+						AddErrors(y1 + 1, 2, expectedY, 1, &kernelStats->Components[ComponentY]);
+					}
+					if (top == 0)
+						kernelStats->Inconsistencies += CountDifferences(y0, lumaRow, PixelsPerRow);
+				}
+				else
+				{
+					kernelStats->Inconsistencies += oddChroma +
+						CountDifferences(y0, y0 + 1, ColorsPerRow, 2) +
+						CountDifferences(y0, y1, PixelsPerRow) +
+						CountDifferences(y0, lumaRow, PixelsPerRow);
+				}
+			}
+		}
+	}
+
+	char const* GetInputName(CpuPixelFormat input)
+	{
+		return input == CpuPixelFormat::Rgba8 ? "rgba" : "bgra";
+	}
+
+	char const* GetMatrixName(CpuColorMatrix matrix)
+	{
+		return matrix == CpuColorMatrix::Bt709 ? "bt709" : "bt601";
+	}
+
+	char const* GetRangeName(CpuColorRange range)
+	{
+		switch (range)
+		{
+		case CpuColorRange::Limited: return "limited";
+		case CpuColorRange::Full: return "full";
+		default: return "shader";
+		}
+	}
+
+	char const* GetLayoutName(CpuYuvLayout layout)
+	{
+		switch (layout)
+		{
+		case CpuYuvLayout::Nv21: return "nv21";
+		case CpuYuvLayout::I420: return "i420";
+		case CpuYuvLayout::Yv12: return "yv12";
+		case CpuYuvLayout::Yuy2: return "yuy2";
+		case CpuYuvLayout::Uyvy: return "uyvy";
+		case CpuYuvLayout::Nv16: return "nv16";
+		case CpuYuvLayout::I422: return "i422";
+		case CpuYuvLayout::Nv24: return "nv24";
+		case CpuYuvLayout::I444: return "i444";
+		case CpuYuvLayout::P010: return "p010";
+		case CpuYuvLayout::P016: return "p016";
+		case CpuYuvLayout::I010: return "i010";
+		case CpuYuvLayout::Av12: return "av12";
+		case CpuYuvLayout::Ayuv: return "ayuv";
+		case CpuYuvLayout::YCoCgR444: return "ycocgr444";
+		case CpuYuvLayout::YCoCgR420: return "ycocgr420";
+		case CpuYuvLayout::I400: return "i400";
+		case CpuYuvLayout::Nv12Tiled: return "nv12tiled";
+		default: return "nv12";
+		}
+	}
+
+	char const* GetAccuracyName(CpuAccuracy accuracy)
+	{
+		switch (accuracy)
+		{
+		case CpuAccuracy::Fast: return "fast";
+		case CpuAccuracy::Dithered: return "dithered";
+		default: return "exact";
+		}
+	}
+
+	// The formats to check. Each part given narrows them; parts not given match every format.
+	struct FormatFilter
+	{
+		bool HasInput = false;
+		bool HasMatrix = false;
+		bool HasRange = false;
+		bool HasLayout = false;
+		CpuConversionFormat Format;
+
+		bool MatchesLayout(CpuYuvLayout layout) const
+		{
+			return !HasLayout || Format.Output == layout;
+		}
+
+		bool Matches(CpuConversionFormat const& format) const
+		{
+			return (!HasInput || Format.Input == format.Input) && (!HasMatrix || Format.Matrix == format.Matrix) &&
+				(!HasRange || Format.Range == format.Range) && MatchesLayout(format.Output);
+		}
+	};
+
+	// Parses comma-separated input, matrix, range and layout names, in any order, as Rgb2YuvCpu spells
+	// them. Returns false on a name that isn't one.
+	bool ParseFormatFilter(char const* text, FormatFilter* filter)
+	{
+		std::string parts(text);
+		for (size_t begin = 0; begin <= parts.size(); )
+		{
+			size_t end = parts.find(',', begin);
+			if (end == std::string::npos)
+				end = parts.size();
+			std::string part = parts.substr(begin, end - begin);
+			begin = end + 1;
+
+			// The scalar table has every input, matrix, range and linear layout.
+			bool known = false;
+			if (part == GetLayoutName(CpuYuvLayout::Nv12Tiled))
+			{
+				filter->HasLayout = known = true;
+				filter->Format.Output = CpuYuvLayout::Nv12Tiled;
+			}
+			CpuKernels::KernelTable const& formats = CpuKernels::ScalarKernels;
+			for (size_t f = 0; f < formats.EntryCount && !known; ++f)
+			{
+				CpuConversionFormat const& format = formats.Entries[f].Format;
+				if (part == GetInputName(format.Input))
+				{
+					filter->HasInput = known = true;
+					filter->Format.Input = format.Input;
+				}
+				else if (part == GetMatrixName(format.Matrix))
+				{
+					filter->HasMatrix = known = true;
+					filter->Format.Matrix = format.Matrix;
+				}
+				else if (part == GetRangeName(format.Range))
+				{
+					filter->HasRange = known = true;
+					filter->Format.Range = format.Range;
+				}
+				else if (part == GetLayoutName(format.Output))
+				{
+					filter->HasLayout = known = true;
+					filter->Format.Output = format.Output;
+				}
+			}
+			if (!known)
+				return false;
+		}
+		return true;
+	}
+
+	// The documented bounds: exact is never off, fast and dithered at most 1 LSB.
+	int GetErrorBound(CpuAccuracy accuracy)
+	{
+		return accuracy == CpuAccuracy::BitExact ? 0 : 1;
+	}
+
+	void PrintHistogram(ComponentStats const& stats)
+	{
+		for (int i = 0; i < HistogramSize; ++i)
+		{
+			if (stats.Histogram[i] == 0)
+				continue;
+
+			int error = i - HistogramRadius;
+			char const* prefix = error == -HistogramRadius ? "<=" : error == HistogramRadius ? ">=" : "";
+			std::printf(" %s%+d:%llu", prefix, error, static_cast<unsigned long long>(stats.Histogram[i]));
+		}
+	}
+
+	// Returns true if the kernel stays within its bound.
+	bool PrintKernelStats(KernelUnderTest const& kernel, KernelStats const& stats)
+	{
+		int bound = GetErrorBound(kernel.Accuracy);
+		bool passed = stats.Inconsistencies == 0 && stats.AlphaErrors == 0;
+		for (int c = 0; c < ComponentCount; ++c)
+		{
+			passed = passed && stats.Components[c].MaxError <= bound;
+		}
+
+		std::printf("  %-10s %-8s %s\n", kernel.Table->Name, GetAccuracyName(kernel.Accuracy), passed ? "ok" : "FAILED");
+		for (int c = 0; c < ComponentCount; ++c)
+		{
+			// Luma-only layouts have no chroma samples to report.
+			ComponentStats const& component = stats.Components[c];
+			if (component.SampleCount == 0)
+				continue;
+
+			std::printf("    %s max %d mean %.4f, histogram", c_componentNames[c], component.MaxError,
+				double(component.AbsoluteErrorSum) / double(component.SampleCount));
+			PrintHistogram(component);
+			std::printf("\n");
+		}
+		if (stats.Inconsistencies != 0)
+			std::printf("    %llu samples differ between the entry points\n", static_cast<unsigned long long>(stats.Inconsistencies));
+		if (stats.AlphaErrors != 0)
+			std::printf("    %llu alpha samples differ from the source\n", static_cast<unsigned long long>(stats.AlphaErrors));
+
+		return passed;
+	}
+
+	// Pixels of a width x height noise image, tightly packed; the same seed gives the same image.
+	std::vector<uint8_t> MakeNoiseImage(uint32_t width, uint32_t height, uint32_t seed)
+	{
+		std::vector<uint8_t> pixels(size_t(width) * height * 4);
+		for (uint8_t& channel : pixels)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			channel = static_cast<uint8_t>(seed >> 24);
+		}
+		return pixels;
+	}
+
+	// Noise sizes of the image check: single pixels, odd sizes that leave partial row pairs, tiles and
+	// vectors at the edges, and rows long enough for every kernel's main loop.
+	uint32_t const c_imageSizes[][2] = { { 1, 1 }, { 3, 2 }, { 37, 19 }, { 258, 130 }, { 1921, 67 } };
+
+	// Converts rgb into the planes of a footprint placed offset bytes past a 64-byte boundary, and returns
+	// the footprint's bytes. Bytes between the planes keep a fill, so two results compare equal only if the
+	// conversions do.
+	std::vector<uint8_t> ConvertToFootprint(CpuConverter const& converter, CpuRgbImage const& rgb, CpuYuvFootprint const& footprint,
+		size_t offset, CpuAccuracy accuracy)
+	{
+		std::vector<uint8_t> buffer(footprint.TotalSize + 64 + offset, 0xCD);
+		uint8_t* data = buffer.data() + (64 - reinterpret_cast<uintptr_t>(buffer.data()) % 64) % 64 + offset;
+		converter.ConvertRgbToYuv(rgb, PlaceYuvFootprint(data, footprint), accuracy);
+		return std::vector<uint8_t>(data, data + footprint.TotalSize);
+	}
+
+	// Schedules of the image check: static bands, and steal tiles of the default size, of a size that
+	// doesn't line up with any SIMD block, and of a single quad.
+	struct Schedule
+	{
+		CpuScheduling Scheduling;
+		uint32_t TileWidth;
+		uint32_t TileHeight;
+	};
+
+	Schedule const c_imageSchedules[] =
+	{
+		{ CpuScheduling::StaticBands, CpuConverter::DefaultTileWidth, CpuConverter::DefaultTileHeight },
+		{ CpuScheduling::WorkStealing, CpuConverter::DefaultTileWidth, CpuConverter::DefaultTileHeight },
+		{ CpuScheduling::WorkStealing, 46, 6 },
+		{ CpuScheduling::WorkStealing, 2, 2 },
+	};
+
+	// Footprint alignments, and offsets from a 64-byte boundary, of the image check: every plane and row
+	// 64-byte aligned, or planes at odd addresses with odd pitches.
+	struct Placement
+	{
+		uint32_t Alignment;
+		size_t Offset;
+	};
+
+	Placement const c_imagePlacements[] = { { 64, 0 }, { 1, 1 } };
+
+	// Converts noise to every linear layout from both inputs, with every schedule on the verifier's threads
+	// and on three, with both store modes and every placement, and compares every byte with the scalar
+	// kernels run on one thread in static bands. The exhaustive check fills 2x2 blocks with one color; this
+	// one has every quad average four different pixels. Returns the number of conversions that differ.
+	uint32_t VerifyImageTargets(KernelUnderTest const& kernel, FormatFilter const& filter, uint32_t threadCount)
+	{
+		uint32_t failures = 0;
+		CpuConverter reference(CpuKernels::ScalarKernels, 1);
+		reference.SetScheduling(CpuScheduling::StaticBands);
+		CpuConverter converters[] = { CpuConverter(*kernel.Table, threadCount), CpuConverter(*kernel.Table, 3) };
+
+		CpuKernels::KernelTable const& formats = CpuKernels::ScalarKernels;
+		for (size_t f = 0; f < formats.EntryCount; ++f)
+		{
+			CpuConversionFormat const& format = formats.Entries[f].Format;
+			if (format.Matrix != CpuConversionFormat().Matrix || format.Range != CpuConversionFormat().Range || !kernel.Table->Find(format) || !filter.Matches(format))
+				continue;
+			reference.SetFormat(format);
+			for (CpuConverter& converter : converters)
+			{
+				converter.SetFormat(format);
+			}
+
+			for (auto const& size : c_imageSizes)
+			{
+				std::vector<uint8_t> pixels = MakeNoiseImage(size[0], size[1], size[0] * 7919 + size[1] + static_cast<uint32_t>(format.Output) * 31);
+				CpuRgbImage rgb{ pixels.data(), size[0], size[1], size_t(size[0]) * 4 };
+
+				for (Placement const& placement : c_imagePlacements)
+				{
+					CpuYuvFootprint footprint = GetCompatibleYuvFootprint(size[0], size[1], format.Output, placement.Alignment, placement.Alignment);
+					std::vector<uint8_t> expected = ConvertToFootprint(reference, rgb, footprint, placement.Offset, kernel.Accuracy);
+
+					for (CpuConverter& converter : converters)
+					{
+						for (Schedule const& schedule : c_imageSchedules)
+						{
+							converter.SetScheduling(schedule.Scheduling, schedule.TileWidth, schedule.TileHeight);
+							for (CpuStoreMode storeMode : { CpuStoreMode::Cached, CpuStoreMode::Streaming })
+							{
+								converter.SetStoreMode(storeMode);
+								if (ConvertToFootprint(converter, rgb, footprint, placement.Offset, kernel.Accuracy) != expected)
+									++failures;
+							}
+						}
+					}
+				}
+			}
+		}
+		return failures;
+	}
+
+	// The layout whose sweep covers layout: the one that shares its arithmetic and differs only in where
+	// the samples go, whether alpha is copied, or the shift of the words. Every other layout is swept
+	// itself.
+	CpuYuvLayout GetSweptLayout(CpuYuvLayout layout)
+	{
+		switch (layout)
+		{
+		case CpuYuvLayout::Nv21:
+		case CpuYuvLayout::I420:
+		case CpuYuvLayout::Yv12:
+		case CpuYuvLayout::Av12:
+		case CpuYuvLayout::I400:
+			return CpuYuvLayout::Nv12;
+		case CpuYuvLayout::Yuy2:
+		case CpuYuvLayout::Uyvy:
+		case CpuYuvLayout::I422:
+			return CpuYuvLayout::Nv16;
+		case CpuYuvLayout::I444:
+		case CpuYuvLayout::Ayuv:
+			return CpuYuvLayout::Nv24;
+		case CpuYuvLayout::I010:
+			return CpuYuvLayout::P010;
+		default:
+			return layout;
+		}
+	}
+
+	// The samples of a converted image, whatever the layout: Y and alpha per pixel, U and V per chroma
+	// sample, with the shift of word layouts undone. Layouts without chroma or alpha leave them empty.
+	struct ImageSamples
+	{
+		std::vector<uint16_t> Y;
+		std::vector<uint16_t> U;
+		std::vector<uint16_t> V;
+		std::vector<uint16_t> A;
+	};
+
+	ImageSamples ReadImageSamples(CpuYuvImage const& yuv, CpuYuvLayout layout)
+	{
+		ImageSamples samples;
+		uint32_t chromaWidth = HasHorizontalChromaSubsampling(layout) ? yuv.Width / 2 : yuv.Width;
+		uint32_t chromaHeight = HasVerticalChromaSubsampling(layout) ? yuv.Height / 2 : yuv.Height;
+		for (uint32_t y = 0; y < yuv.Height; ++y)
+		{
+			uint8_t const* row = yuv.Y + y * yuv.YRowPitch;
+			if (layout == CpuYuvLayout::Ayuv)
+			{
+				// V U Y A per pixel.
+				for (uint32_t x = 0; x < yuv.Width; ++x)
+				{
+					samples.V.push_back(row[x * 4]);
+					samples.U.push_back(row[x * 4 + 1]);
+					samples.Y.push_back(row[x * 4 + 2]);
+					samples.A.push_back(row[x * 4 + 3]);
+				}
+			}
+			else if (IsPackedYuvLayout(layout))
+			{
+				uint32_t lumaOffset = layout == CpuYuvLayout::Uyvy ? 1 : 0;
+				for (uint32_t x = 0; x < yuv.Width; ++x)
+				{
+					samples.Y.push_back(row[x * 2 + lumaOffset]);
+				}
+				for (uint32_t x = 0; x < chromaWidth; ++x)
+				{
+					samples.U.push_back(row[x * 4 + 1 - lumaOffset]);
+					samples.V.push_back(row[x * 4 + 3 - lumaOffset]);
+				}
+			}
+			else
+			{
+				for (uint32_t x = 0; x < yuv.Width; ++x)
+				{
+					samples.Y.push_back(ReadSample(layout, row, x));
+				}
+			}
+
+			if (HasAlphaPlane(layout))
+			{
+				uint8_t const* alpha = yuv.A + y * yuv.ARowPitch;
+				samples.A.insert(samples.A.end(), alpha, alpha + yuv.Width);
+			}
+		}
+
+		for (uint32_t y = 0; HasChromaPlanes(layout) && y < chromaHeight; ++y)
+		{
+			for (uint32_t x = 0; x < chromaWidth; ++x)
+			{
+				if (IsPlanarYuvLayout(layout))
+				{
+					samples.U.push_back(ReadSample(layout, yuv.U + y * yuv.URowPitch, x));
+					samples.V.push_back(ReadSample(layout, yuv.V + y * yuv.VRowPitch, x));
+				}
+				else
+				{
+					uint8_t const* row = yuv.UV + y * yuv.UVRowPitch;
+					bool swapped = layout == CpuYuvLayout::Nv21;
+					samples.U.push_back(ReadSample(layout, row, x * 2 + (swapped ? 1 : 0)));
+					samples.V.push_back(ReadSample(layout, row, x * 2 + (swapped ? 0 : 1)));
+				}
+			}
+		}
+		return samples;
+	}
+
+	// Converts noise to format with both store modes, and to the layout swept for it with the same kernels,
+	// and compares the samples; alpha must be the source's, with the padding column and row repeating the
+	// last. This is what stands in for the sweep of a layout that GetSweptLayout maps elsewhere. Returns the
+	// number of conversions that differ.
+	uint32_t VerifySweptLayout(KernelUnderTest const& kernel, CpuConversionFormat const& format, uint32_t threadCount)
+	{
+		uint32_t failures = 0;
+		CpuConversionFormat sweptFormat = format;
+		sweptFormat.Output = GetSweptLayout(format.Output);
+		CpuConverter swept(*kernel.Table, threadCount);
+		swept.SetFormat(sweptFormat);
+		CpuConverter converter(*kernel.Table, threadCount);
+		converter.SetFormat(format);
+
+		for (auto const& size : c_imageSizes)
+		{
+			std::vector<uint8_t> pixels = MakeNoiseImage(size[0], size[1], size[0] * 7919 + size[1] + static_cast<uint32_t>(format.Output) * 31);
+			CpuRgbImage rgb{ pixels.data(), size[0], size[1], size_t(size[0]) * 4 };
+
+			CpuYuvBuffer sweptImage = CreateCompatibleYuvBuffer(rgb, sweptFormat.Output);
+			swept.ConvertRgbToYuv(rgb, sweptImage.Image, kernel.Accuracy);
+			ImageSamples expected = ReadImageSamples(sweptImage.Image, sweptFormat.Output);
+
+			CpuYuvBuffer image = CreateCompatibleYuvBuffer(rgb, format.Output);
+			if (IsLumaOnlyYuvLayout(format.Output))
+			{
+				// I400 pads the width only, so the swept layout's padding row goes with its chroma.
+				expected.Y.resize(size_t(image.Image.Width) * image.Image.Height);
+				expected.U.clear();
+				expected.V.clear();
+			}
+			if (HasAlphaPlane(format.Output) || format.Output == CpuYuvLayout::Ayuv)
+			{
+				for (uint32_t y = 0; y < image.Image.Height; ++y)
+				{
+					for (uint32_t x = 0; x < image.Image.Width; ++x)
+					{
+						uint32_t sourceX = x < size[0] ? x : size[0] - 1;
+						uint32_t sourceY = y < size[1] ? y : size[1] - 1;
+						expected.A.push_back(pixels[(size_t(sourceY) * size[0] + sourceX) * 4 + 3]);
+					}
+				}
+			}
+
+			for (CpuStoreMode storeMode : { CpuStoreMode::Cached, CpuStoreMode::Streaming })
+			{
+				converter.SetStoreMode(storeMode);
+				converter.ConvertRgbToYuv(rgb, image.Image, kernel.Accuracy);
+				ImageSamples actual = ReadImageSamples(image.Image, format.Output);
+				if (actual.Y != expected.Y || actual.U != expected.U || actual.V != expected.V || actual.A != expected.A)
+					++failures;
+			}
+		}
+		return failures;
+	}
+
+	// Tile sizes and image sizes of the tiled check: common tiles, tiles larger than the image, and odd
+	// image sizes that leave partial tiles at the edges.
+	CpuYuvTiling const c_tilings[] = { { 2, 2 }, { 4, 4 }, { 16, 16 }, { 16, 32 }, { 64, 32 }, { 128, 32 }, { 96, 6 }, { 512, 256 } };
+	uint32_t const c_tiledSizes[][2] = { { 1, 1 }, { 37, 19 }, { 258, 130 }, { 1921, 67 } };
+
+	// Converts noise to NV12 tiled with the converter, with both schedules and small steal tiles that
+	// don't line up with the target's tiles, and compares every byte of the buffer with NV12 from the same
+	// kernels copied into tiles. Returns the number of conversions that differ.
+	uint32_t VerifyTiledTargets(KernelUnderTest const& kernel, uint32_t threadCount)
+	{
+		uint32_t failures = 0;
+		for (auto const& size : c_tiledSizes)
+		{
+			std::vector<uint8_t> pixels = MakeNoiseImage(size[0], size[1], size[0] * 7919 + size[1]);
+			CpuRgbImage rgb{ pixels.data(), size[0], size[1], size_t(size[0]) * 4 };
+
+			CpuConverter converter(*kernel.Table, threadCount);
+			CpuYuvBuffer linear = CreateCompatibleYuvBuffer(rgb);
+			converter.ConvertRgbToYuv(rgb, linear.Image, kernel.Accuracy);
+
+			CpuConversionFormat tiledFormat;
+			tiledFormat.Output = CpuYuvLayout::Nv12Tiled;
+			converter.SetFormat(tiledFormat);
+
+			for (CpuYuvTiling const& tiling : c_tilings)
+			{
+				CpuYuvBuffer expected = CreateCompatibleYuvBuffer(rgb, CpuYuvLayout::Nv12Tiled, tiling);
+				converter.CopyToTiles(linear.Image, expected.Image);
+
+				for (int schedule = 0; schedule < 2; ++schedule)
+				{
+					converter.SetScheduling(schedule == 0 ? CpuScheduling::StaticBands : CpuScheduling::WorkStealing, 46, 6);
+					CpuYuvBuffer tiled = CreateCompatibleYuvBuffer(rgb, CpuYuvLayout::Nv12Tiled, tiling);
+					converter.ConvertRgbToYuv(rgb, tiled.Image, kernel.Accuracy);
+					if (tiled.Storage != expected.Storage)
+						++failures;
+				}
+			}
+		}
+		return failures;
+	}
+
+	// Noise sizes of the YCoCg-R check: single pixels, odd sizes with partial 2x2 blocks at the edges, and
+	// rows long enough for every kernel's main loop.
+	uint32_t const c_ycocgSizes[][2] = { { 1, 1 }, { 3, 2 }, { 37, 19 }, { 258, 130 }, { 1921, 67 } };
+
+	int32_t ReadWord(uint8_t const* row, uint32_t index)
+	{
+		return static_cast<int16_t>(row[index * 2] | row[index * 2 + 1] << 8);
+	}
+
+	// The lifting steps of YCoCg-R, written out apart from the kernels' version.
+	void ReferenceYCoCg(uint8_t const* pixel, bool rgba, int32_t* y, int32_t* co, int32_t* cg)
+	{
+		int32_t r = pixel[rgba ? 0 : 2];
+		int32_t g = pixel[1];
+		int32_t b = pixel[rgba ? 2 : 0];
+
+		*co = r - b;
+		int32_t t = b + static_cast<int32_t>(std::floor(*co / 2.0));
+		*cg = g - t;
+		*y = t + static_cast<int32_t>(std::floor(*cg / 2.0));
+	}
+
+	// The inverse steps, clamped to bytes, with opaque alpha. Kernel output never leaves 16 bits on the way.
+	void ReferenceInverse(int32_t y, int32_t co, int32_t cg, bool rgba, uint8_t* pixel)
+	{
+		auto clamp = [](int32_t value)
+		{
+			return static_cast<uint8_t>(value < 0 ? 0 : value > 255 ? 255 : value);
+		};
+
+		int32_t t = y - static_cast<int32_t>(std::floor(cg / 2.0));
+		int32_t g = cg + t;
+		int32_t b = t - static_cast<int32_t>(std::floor(co / 2.0));
+		int32_t r = b + co;
+		pixel[rgba ? 0 : 2] = clamp(r);
+		pixel[1] = clamp(g);
+		pixel[rgba ? 2 : 0] = clamp(b);
+		pixel[3] = 255;
+	}
+
+	// Compares a YCoCg-R target with the lifting steps applied to rgb, then converts it back and compares
+	// that with the inverse steps. 4:4:4 has to give back the source colors exactly. Subsampled chroma is
+	// the rounded average of each 2x2 block, with edge pixels repeated to fill partial blocks.
+	bool CheckYCoCgTarget(CpuConverter const& converter, CpuRgbImage const& rgb, CpuYuvImage const& yuv, bool rgba, bool subsampled)
+	{
+		auto pixel = [&](uint32_t x, uint32_t y)
+		{
+			x = x < rgb.Width ? x : rgb.Width - 1;
+			y = y < rgb.Height ? y : rgb.Height - 1;
+			return rgb.Data + y * rgb.RowPitch + x * 4;
+		};
+
+		for (uint32_t y = 0; y < rgb.Height; ++y)
+		{
+			for (uint32_t x = 0; x < rgb.Width; ++x)
+			{
+				int32_t luma;
+				int32_t co;
+				int32_t cg;
+				ReferenceYCoCg(pixel(x, y), rgba, &luma, &co, &cg);
+				if (ReadWord(yuv.Y + y * yuv.YRowPitch, x) != luma)
+					return false;
+				if (!subsampled && (ReadWord(yuv.U + y * yuv.URowPitch, x) != co || ReadWord(yuv.V + y * yuv.VRowPitch, x) != cg))
+					return false;
+			}
+		}
+
+		if (subsampled)
+		{
+			for (uint32_t y = 0; y < (rgb.Height + 1) / 2; ++y)
+			{
+				for (uint32_t x = 0; x < (rgb.Width + 1) / 2; ++x)
+				{
+					int32_t coSum = 0;
+					int32_t cgSum = 0;
+					for (uint32_t i = 0; i < 4; ++i)
+					{
+						int32_t luma;
+						int32_t co;
+						int32_t cg;
+						ReferenceYCoCg(pixel(x * 2 + i % 2, y * 2 + i / 2), rgba, &luma, &co, &cg);
+						coSum += co;
+						cgSum += cg;
+					}
+					if (ReadWord(yuv.U + y * yuv.URowPitch, x) != static_cast<int32_t>(std::floor((coSum + 2) / 4.0)) ||
+						ReadWord(yuv.V + y * yuv.VRowPitch, x) != static_cast<int32_t>(std::floor((cgSum + 2) / 4.0)))
+						return false;
+				}
+			}
+		}
+
+		std::vector<uint8_t> back(size_t(rgb.Width) * rgb.Height * 4);
+		converter.ConvertYuvToRgb(yuv, CpuRgbTarget{ back.data(), rgb.Width, rgb.Height, size_t(rgb.Width) * 4 });
+		for (uint32_t y = 0; y < rgb.Height; ++y)
+		{
+			for (uint32_t x = 0; x < rgb.Width; ++x)
+			{
+				uint32_t chromaX = subsampled ? x / 2 : x;
+				uint32_t chromaY = subsampled ? y / 2 : y;
+				uint8_t expected[4];
+				ReferenceInverse(ReadWord(yuv.Y + y * yuv.YRowPitch, x), ReadWord(yuv.U + chromaY * yuv.URowPitch, chromaX),
+					ReadWord(yuv.V + chromaY * yuv.VRowPitch, chromaX), rgba, expected);
+
+				uint8_t const* actual = back.data() + (size_t(y) * rgb.Width + x) * 4;
+				if (std::memcmp(actual, expected, 4) != 0)
+					return false;
+				if (!subsampled && std::memcmp(actual, pixel(x, y), 3) != 0)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	// Converts every color to YCoCg-R 4:4:4, and noise at odd sizes to both YCoCg-R layouts, from both
+	// inputs and with both store modes, and checks each with CheckYCoCgTarget. YCoCg-R ignores the matrix
+	// and range, so the default ones stand in for all. Returns the number of conversions that differ.
+	uint32_t VerifyYCoCgTargets(KernelUnderTest const& kernel, uint32_t threadCount)
+	{
+		uint32_t failures = 0;
+		auto check = [&](std::vector<uint8_t> const& pixels, uint32_t width, uint32_t height, CpuYuvLayout layout)
+		{
+			CpuRgbImage rgb{ pixels.data(), width, height, size_t(width) * 4 };
+			CpuYuvBuffer yuv = CreateCompatibleYuvBuffer(rgb, layout);
+			for (CpuPixelFormat input : { CpuPixelFormat::Bgra8, CpuPixelFormat::Rgba8 })
+			{
+				CpuConversionFormat format;
+				format.Input = input;
+				format.Output = layout;
+
+				CpuConverter converter(*kernel.Table, threadCount);
+				converter.SetFormat(format);
+				for (CpuStoreMode storeMode : { CpuStoreMode::Cached, CpuStoreMode::Streaming })
+				{
+					converter.SetStoreMode(storeMode);
+					converter.ConvertRgbToYuv(rgb, yuv.Image, kernel.Accuracy);
+					if (!CheckYCoCgTarget(converter, rgb, yuv.Image, input == CpuPixelFormat::Rgba8, layout == CpuYuvLayout::YCoCgR420))
+						++failures;
+				}
+			}
+		};
+
+		std::vector<uint8_t> colors(size_t(1) << 26);
+		for (uint32_t color = 0; color < (1u << 24); ++color)
+		{
+			std::memcpy(&colors[size_t(color) * 4], &color, 3);
+			colors[size_t(color) * 4 + 3] = 255;
+		}
+		check(colors, 4096, 4096, CpuYuvLayout::YCoCgR444);
+
+		for (auto const& size : c_ycocgSizes)
+		{
+			std::vector<uint8_t> pixels = MakeNoiseImage(size[0], size[1], size[0] * 7919 + size[1]);
+			check(pixels, size[0], size[1], CpuYuvLayout::YCoCgR444);
+			check(pixels, size[0], size[1], CpuYuvLayout::YCoCgR420);
+		}
+		return failures;
+	}
+
+	// Noise batches of the tensor check, at odd sizes and with rows longer than a scratch chunk.
+	uint32_t const c_tensorSizes[][3] = { { 1, 1, 1 }, { 3, 2, 2 }, { 37, 19, 3 }, { 30000, 5, 1 } };
+
+	// The value of binary16 bits, decoded apart from the conversion's rounding.
+	double HalfToDouble(uint16_t bits)
+	{
+		int exponent = (bits >> 10) & 31;
+		int fraction = bits & 1023;
+		double magnitude = exponent == 0 ? std::ldexp(fraction, -24) : exponent == 31 ? HUGE_VAL : std::ldexp(fraction | 1024, exponent - 25);
+		return bits & 0x8000 ? -magnitude : magnitude;
+	}
+
+	// Whether element is the normalized code rounded to nearest: exactly the float of it, or a half within
+	// half a unit in the last place.
+	bool CheckTensorElement(uint8_t const* element, CpuYuvTensor const& tensor, int channel, uint8_t code)
+	{
+		double exact = (code / 255.0 - tensor.Mean[channel]) / tensor.Std[channel];
+		if (tensor.Type == CpuTensorType::Float32)
+		{
+			float value;
+			std::memcpy(&value, element, sizeof(value));
+			return value == static_cast<float>(exact);
+		}
+
+		uint16_t bits;
+		std::memcpy(&bits, element, sizeof(bits));
+		int exponent;
+		std::frexp(exact, &exponent);
+		double halfUlp = std::ldexp(1.0, (exponent - 1 < -14 ? -14 : exponent - 1) - 11);
+		return std::fabs(HalfToDouble(bits) - exact) <= halfUlp;
+	}
+
+	// Converts noise batches into tensors of both types, with and without upsampled chroma, and compares
+	// each with I420 conversion followed by CopyToTensor, and that with the I420 codes normalized apart from
+	// the converter. Returns the number of conversions that differ.
+	uint32_t VerifyTensorTargets(KernelUnderTest const& kernel, uint32_t threadCount)
+	{
+		uint32_t failures = 0;
+		CpuConverter converter(*kernel.Table, threadCount);
+		CpuConversionFormat format;
+		format.Output = CpuYuvLayout::I420;
+		converter.SetFormat(format);
+
+		for (auto const& size : c_tensorSizes)
+		{
+			std::vector<std::vector<uint8_t>> pixels(size[2]);
+			std::vector<CpuRgbImage> images;
+			for (std::vector<uint8_t>& image : pixels)
+			{
+				image = MakeNoiseImage(size[0], size[1], size[0] * 7919 + size[1] * 31 + static_cast<uint32_t>(images.size()));
+				images.push_back({ image.data(), size[0], size[1], size_t(size[0]) * 4 });
+			}
+
+			std::vector<CpuYuvBuffer> i420;
+			for (CpuRgbImage const& image : images)
+			{
+				i420.push_back(CreateCompatibleYuvBuffer(image, CpuYuvLayout::I420));
+				converter.ConvertRgbToYuv(image, i420.back().Image, kernel.Accuracy);
+			}
+
+			for (CpuTensorType type : { CpuTensorType::Float32, CpuTensorType::Float16 })
+			{
+				for (bool upsample : { false, true })
+				{
+					CpuYuvTensor tensor;
+					tensor.Type = type;
+					tensor.BatchSize = size[2];
+					tensor.Width = size[0];
+					tensor.Height = size[1];
+					tensor.UpsampleChroma = upsample;
+					float const mean[3] = { 0.485f, 0.456f, 0.406f };
+					float const deviation[3] = { 0.229f, 0.224f, 0.225f };
+					std::memcpy(tensor.Mean, mean, sizeof(mean));
+					std::memcpy(tensor.Std, deviation, sizeof(deviation));
+
+					std::vector<uint8_t> fused(GetYuvTensorSize(tensor));
+					std::vector<uint8_t> copied(fused.size());
+					tensor.Data = fused.data();
+					converter.ConvertRgbToTensor(images.data(), tensor, kernel.Accuracy);
+					tensor.Data = copied.data();
+					for (uint32_t n = 0; n < tensor.BatchSize; ++n)
+					{
+						converter.CopyToTensor(i420[n].Image, tensor, n);
+					}
+
+					bool matches = fused == copied;
+					size_t elementSize = type == CpuTensorType::Float16 ? 2 : 4;
+					uint32_t chromaWidth = upsample ? size[0] : (size[0] + 1) / 2;
+					uint32_t chromaHeight = upsample ? size[1] : (size[1] + 1) / 2;
+					for (uint32_t n = 0; n < tensor.BatchSize && matches; ++n)
+					{
+						CpuYuvImage const& yuv = i420[n].Image;
+						uint8_t const* element = copied.data() + GetYuvTensorImageSize(tensor) * n;
+						for (uint32_t y = 0; y < size[1]; ++y)
+						{
+							for (uint32_t x = 0; x < size[0]; ++x, element += elementSize)
+							{
+								matches = matches && CheckTensorElement(element, tensor, 0, yuv.Y[y * yuv.YRowPitch + x]);
+							}
+						}
+						for (int c = 1; c < 3; ++c)
+						{
+							uint8_t const* plane = c == 1 ? yuv.U : yuv.V;
+							size_t pitch = c == 1 ? yuv.URowPitch : yuv.VRowPitch;
+							for (uint32_t y = 0; y < chromaHeight; ++y)
+							{
+								for (uint32_t x = 0; x < chromaWidth; ++x, element += elementSize)
+								{
+									uint8_t code = upsample ? plane[y / 2 * pitch + x / 2] : plane[y * pitch + x];
+									matches = matches && CheckTensorElement(element, tensor, c, code);
+								}
+							}
+						}
+					}
+					if (!matches)
+						++failures;
+				}
+			}
+		}
+		return failures;
+	}
+
+	CpuKernelLevel const c_levels[] =
+	{
+		CpuKernelLevel::Scalar,
+		CpuKernelLevel::Sse41,
+		CpuKernelLevel::Avx2,
+		CpuKernelLevel::Avx512,
+		CpuKernelLevel::Avx512Vnni,
+	};
+
+	CpuAccuracy const c_accuracies[] =
+	{
+		CpuAccuracy::BitExact,
+		CpuAccuracy::Fast,
+		CpuAccuracy::Dithered,
+	};
+
+	void PrintUsage()
+	{
+		std::cout << "Usage: Rgb2YuvVerify [options]\n";
+		std::cout << "Checks every RGB value against the double-precision formulas, for every kernel level this CPU\n";
+		std::cout << "supports, every conversion format and every accuracy tier. Exits with 1 if any kernel is off by\n";
+		std::cout << "more than its bound (0 for exact, 1 LSB for fast and dithered).\n";
+		std::cout << "Options:\n";
+		std::cout << "  --kernel=[scalar|sse41|avx2|avx512|avx512vnni]\n";
+		std::cout << "      Checks only this level.\n";
+		std::cout << "  --accuracy=[exact|fast|dithered]\n";
+		std::cout << "      Checks only this tier.\n";
+		std::cout << "  --format=[input],[matrix],[range],[layout]\n";
+		std::cout << "      Checks only the formats with these parts, e.g. rgba,bt709 or i420; any part can be left\n";
+		std::cout << "      out, in any order. Names as in Rgb2YuvCpu. A layout swept under another one brings that\n";
+		std::cout << "      sweep along.\n";
+		std::cout << "  --threads=[count]\n";
+		std::cout << "      Threads, including the calling one. Default is one per hardware thread.\n";
+	}
+}
+
+int main(int argc, char** argv)
+{
+	char const* requestedLevel = nullptr;
+	std::vector<CpuAccuracy> accuracies(std::begin(c_accuracies), std::end(c_accuracies));
+	uint32_t threadCount = 0;
+	FormatFilter filter;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strncmp(argv[i], "--kernel=", 9) == 0)
+		{
+			requestedLevel = argv[i] + 9;
+		}
+		else if (std::strncmp(argv[i], "--accuracy=", 11) == 0)
+		{
+			accuracies.clear();
+			for (CpuAccuracy accuracy : c_accuracies)
+			{
+				if (std::strcmp(argv[i] + 11, GetAccuracyName(accuracy)) == 0)
+					accuracies.push_back(accuracy);
+			}
+			if (accuracies.empty())
+			{
+				PrintUsage();
+				return -1;
+			}
+		}
+		else if (std::strncmp(argv[i], "--format=", 9) == 0)
+		{
+			if (!ParseFormatFilter(argv[i] + 9, &filter))
+			{
+				PrintUsage();
+				return -1;
+			}
+		}
+		else if (std::strncmp(argv[i], "--threads=", 10) == 0)
+		{
+			threadCount = static_cast<uint32_t>(std::strtoul(argv[i] + 10, nullptr, 10));
+		}
+		else
+		{
+			PrintUsage();
+			return -1;
+		}
+	}
+
+	try
+	{
+		std::vector<CpuKernels::KernelTable const*> tables;
+		if (requestedLevel)
+		{
+			tables.push_back(&SelectCpuKernels(requestedLevel));
+		}
+		else
+		{
+			for (CpuKernelLevel level : c_levels)
+			{
+				if (IsCpuKernelLevelSupported(level))
+					tables.push_back(&GetCpuKernels(level));
+				else
+					std::printf("Skipping %s kernels: not supported by this CPU\n", GetCpuKernels(level).Name);
+			}
+		}
+
+		CpuThreadPool threadPool(threadCount);
+		std::printf("Checking 2^24 colors on %u threads\n", threadPool.GetThreadCount());
+
+		auto start = std::chrono::steady_clock::now();
+		bool passed = true;
+
+		// The scalar table has every format; other levels may not.
+		CpuKernels::KernelTable const& formats = CpuKernels::ScalarKernels;
+		for (size_t f = 0; f < formats.EntryCount; ++f)
+		{
+			CpuConversionFormat const& format = formats.Entries[f].Format;
+			if (IsReversibleYuvLayout(format.Output) || GetSweptLayout(format.Output) != format.Output)
+				continue;
+
+			// The formats this sweep stands in for, checked against it below with noise.
+			std::vector<CpuConversionFormat> sharing;
+			for (size_t s = 0; s < formats.EntryCount; ++s)
+			{
+				CpuConversionFormat const& other = formats.Entries[s].Format;
+				CpuConversionFormat swept = other;
+				swept.Output = GetSweptLayout(other.Output);
+				if (other.Output != format.Output && swept == format && filter.Matches(other))
+					sharing.push_back(other);
+			}
+			if (!filter.Matches(format) && sharing.empty())
+				continue;
+
+			std::vector<KernelUnderTest> kernels;
+			for (CpuKernels::KernelTable const* table : tables)
+			{
+				if (!table->Find(format))
+					continue;
+				for (CpuAccuracy accuracy : accuracies)
+				{
+					kernels.push_back({ table, accuracy });
+				}
+			}
+			if (kernels.empty())
+				continue;
+
+			// Every task gets its own slots, merged once all of them are done.
+			std::vector<KernelStats> taskStats(256 * kernels.size(), KernelStats());
+			std::vector<ClipStats> taskClips(256, ClipStats());
+			ReferenceFormulas formulas = GetReferenceFormulas(format);
+
+			threadPool.RunStealing(256, [&](uint32_t red)
+			{
+				VerifyRed(red, format, formulas, kernels, &taskStats[red * kernels.size()], &taskClips[red]);
+			});
+
+			ClipStats clips = ClipStats();
+			for (ClipStats const& taskClip : taskClips)
+			{
+				for (int c = 0; c < ComponentCount; ++c)
+				{
+					clips.Low[c] += taskClip.Low[c];
+					clips.High[c] += taskClip.High[c];
+				}
+			}
+
+			std::printf("%s %s %s %s: clipped", GetInputName(format.Input), GetMatrixName(format.Matrix), GetRangeName(format.Range), GetLayoutName(format.Output));
+			int componentCount = IsLumaOnlyYuvLayout(format.Output) ? 1 : ComponentCount;
+			for (int c = 0; c < componentCount; ++c)
+			{
+				std::printf(" %s %llu low %llu high%s", c_componentNames[c], static_cast<unsigned long long>(clips.Low[c]),
+					static_cast<unsigned long long>(clips.High[c]), c + 1 < componentCount ? "," : "\n");
+			}
+
+			for (size_t k = 0; k < kernels.size(); ++k)
+			{
+				KernelStats merged = KernelStats();
+				for (uint32_t red = 0; red < 256; ++red)
+				{
+					KernelStats const& stats = taskStats[red * kernels.size() + k];
+					for (int c = 0; c < ComponentCount; ++c)
+					{
+						for (int i = 0; i < HistogramSize; ++i)
+						{
+							merged.Components[c].Histogram[i] += stats.Components[c].Histogram[i];
+						}
+						merged.Components[c].AbsoluteErrorSum += stats.Components[c].AbsoluteErrorSum;
+						merged.Components[c].SampleCount += stats.Components[c].SampleCount;
+						if (stats.Components[c].MaxError > merged.Components[c].MaxError)
+							merged.Components[c].MaxError = stats.Components[c].MaxError;
+					}
+					merged.Inconsistencies += stats.Inconsistencies;
+					merged.AlphaErrors += stats.AlphaErrors;
+				}
+
+				passed = PrintKernelStats(kernels[k], merged) && passed;
+			}
+
+			if (sharing.empty())
+				continue;
+
+			std::printf("%s %s %s", GetInputName(format.Input), GetMatrixName(format.Matrix), GetRangeName(format.Range));
+			for (CpuConversionFormat const& other : sharing)
+			{
+				std::printf(" %s", GetLayoutName(other.Output));
+			}
+			std::printf(": noise against %s\n", GetLayoutName(format.Output));
+			for (KernelUnderTest const& kernel : kernels)
+			{
+				uint32_t failures = 0;
+				for (CpuConversionFormat const& other : sharing)
+				{
+					if (kernel.Table->Find(other))
+						failures += VerifySweptLayout(kernel, other, threadPool.GetThreadCount());
+				}
+				std::printf("  %-10s %-8s %s\n", kernel.Table->Name, GetAccuracyName(kernel.Accuracy), failures == 0 ? "ok" : "FAILED");
+				if (failures != 0)
+					std::printf("    %u conversions differ\n", failures);
+				passed = passed && failures == 0;
+			}
+		}
+
+		// The checks after the sweep, each over every level and tier.
+		uint32_t const threads = threadPool.GetThreadCount();
+		auto runCheck = [&](char const* title, auto verify)
+		{
+			std::printf("%s\n", title);
+			for (CpuKernels::KernelTable const* table : tables)
+			{
+				for (CpuAccuracy accuracy : accuracies)
+				{
+					uint32_t failures = verify(KernelUnderTest{ table, accuracy });
+					std::printf("  %-10s %-8s %s\n", table->Name, GetAccuracyName(accuracy), failures == 0 ? "ok" : "FAILED");
+					if (failures != 0)
+						std::printf("    %u conversions differ\n", failures);
+					passed = passed && failures == 0;
+				}
+			}
+		};
+
+		runCheck("noise: every schedule, store mode and placement against the scalar kernels in bands",
+			[&](KernelUnderTest const& kernel) { return VerifyImageTargets(kernel, filter, threads); });
+
+		CpuConversionFormat tiledFormat;
+		tiledFormat.Output = CpuYuvLayout::Nv12Tiled;
+		if (filter.Matches(tiledFormat))
+		{
+			runCheck("nv12tiled: against NV12 copied into tiles",
+				[&](KernelUnderTest const& kernel) { return VerifyTiledTargets(kernel, threads); });
+		}
+
+		// The matrix and range don't apply to YCoCg-R, and the check covers both inputs.
+		if (filter.MatchesLayout(CpuYuvLayout::YCoCgR444) || filter.MatchesLayout(CpuYuvLayout::YCoCgR420))
+		{
+			runCheck("ycocgr444 ycocgr420: against the lifting steps, and back",
+				[&](KernelUnderTest const& kernel) { return VerifyYCoCgTargets(kernel, threads); });
+		}
+
+		CpuConversionFormat tensorFormat;
+		tensorFormat.Output = CpuYuvLayout::I420;
+		if (filter.Matches(tensorFormat))
+		{
+			runCheck("tensor: fused against I420 and CopyToTensor, and the normalized codes",
+				[&](KernelUnderTest const& kernel) { return VerifyTensorTargets(kernel, threads); });
+		}
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::printf("%s in %.1f s\n", passed ? "All kernels within their bounds" : "Some kernels exceed their bounds", seconds);
+		return passed ? 0 : 1;
+	}
+	catch (std::exception const& e)
+	{
+		std::cerr << e.what() << "\n";
+		return -1;
+	}
+}
@@ -18,6 +18,7 @@
 #include <wrl/client.h>
 #include <comdef.h>
 
+#include <memory>
 #include <string>
 #include <vector>
 #include <iostream>